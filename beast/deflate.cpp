@@ -0,0 +1,33 @@
+#include "deflate.hpp"
+
+#include <boost/beast/zlib/deflate_stream.hpp>
+#include <stdexcept>
+
+namespace zlib = boost::beast::zlib;
+
+std::string
+deflate_message(std::string_view message) {
+    std::string out;
+    deflate_message(message, out);
+    return out;
+}
+
+void
+deflate_message(std::string_view message, std::string& out) {
+    // The window and the hash chains take a few hundred kilobytes,
+    // each thread keeps them for the messages to come
+    thread_local zlib::deflate_stream ds;
+    ds.reset(6, 15, 8, zlib::Strategy::normal);
+
+    out.resize(ds.upper_bound(message.size()));
+    zlib::z_params zs;
+    zs.next_in = message.data();
+    zs.avail_in = message.size();
+    zs.next_out = &out[0];
+    zs.avail_out = out.size();
+    boost::system::error_code ec;
+    ds.write(zs, zlib::Flush::finish, ec);
+    if (ec && ec != zlib::error::end_of_stream)
+        throw std::runtime_error("Compression failed: " + ec.message());
+    out.resize(zs.total_out);
+}
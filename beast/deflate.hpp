@@ -0,0 +1,18 @@
+#ifndef NOTIBEAST_DEFLATE_HPP
+#define NOTIBEAST_DEFLATE_HPP
+
+#include <string>
+#include <string_view>
+
+// Raw DEFLATE (RFC 1951) of the message. Each message is compressed on its own,
+// there's no context taken over from the previous ones, so a message compressed
+// once can be sent to any number of clients, e.g. with
+// new DecompressionStream("deflate-raw") in a browser, or zlib with wbits -15.
+std::string
+deflate_message(std::string_view message);
+
+// Same, replacing out, whose buffer is reused
+void
+deflate_message(std::string_view message, std::string& out);
+
+#endif
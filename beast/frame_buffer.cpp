@@ -0,0 +1,156 @@
+#include "frame_buffer.hpp"
+
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// What a pool keeps at most, beyond that buffers go back to the general allocator
+constexpr std::size_t maxPooledBytes = 4 << 20;
+constexpr std::size_t maxPooledCapacity = 64 << 10;
+
+// What a buffer takes, as far as the pool limit goes
+std::size_t
+pooled_bytes(frame_buffer const* p) {
+    return sizeof(frame_buffer) + p->payload().capacity();
+}
+
+std::atomic<std::uint64_t> buffersMade{0};
+
+} //namespace
+
+// The buffers of a thread. The thread takes them from its own free list, the
+// others give them back through a list of their own, taken over when it runs out
+class frame_pool : public std::enable_shared_from_this<frame_pool> {
+    std::vector<frame_buffer*> free_;     // the thread's own
+    std::size_t free_bytes_ = 0;
+    std::mutex mutex_;
+    std::vector<frame_buffer*> returned_; // by the other threads
+    std::size_t returned_bytes_ = 0;
+    bool closed_ = false;                 // the thread is gone
+
+public:
+    // The pool of the calling thread
+    static frame_pool& local();
+
+    frame_buffer*
+    take() {
+        if(free_.empty()) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            free_.swap(returned_);
+            free_bytes_ = std::exchange(returned_bytes_, 0);
+        }
+        if(free_.empty()) {
+            ++buffersMade;
+            return new frame_buffer(shared_from_this());
+        }
+        auto p = free_.back();
+        free_.pop_back();
+        free_bytes_ -= pooled_bytes(p);
+        return p;
+    }
+
+    // Deleting p may delete the pool as well, nothing is to be done after it
+    void
+    give_back(frame_buffer* p) {
+        p->header_size_ = 0;
+        p->payload_.clear();
+        bool kept = false;
+        auto bytes = pooled_bytes(p);
+        if(p->payload_.capacity() <= maxPooledCapacity) {
+            if(this == &local()) {
+                kept = free_bytes_ + bytes <= maxPooledBytes;
+                if(kept) {
+                    free_.push_back(p);
+                    free_bytes_ += bytes;
+                }
+            } else {
+                std::lock_guard<std::mutex> lock(mutex_);
+                kept = ! closed_ && returned_bytes_ + bytes <= maxPooledBytes;
+                if(kept) {
+                    returned_.push_back(p);
+                    returned_bytes_ += bytes;
+                }
+            }
+        }
+        if(! kept)
+            delete p;
+    }
+
+    // The buffers in use are deleted as they're given back
+    void
+    close() {
+        std::vector<frame_buffer*> gone;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+            gone.swap(returned_);
+            returned_bytes_ = 0;
+        }
+        gone.insert(gone.end(), free_.begin(), free_.end());
+        free_.clear();
+        free_bytes_ = 0;
+        for(auto p : gone)
+            delete p;
+    }
+};
+
+frame_pool&
+frame_pool::
+local() {
+    struct holder {
+        std::shared_ptr<frame_pool> pool = std::make_shared<frame_pool>();
+        ~holder() { pool->close(); }
+    };
+    thread_local holder h;
+    return *h.pool;
+}
+
+message_ptr
+frame_buffer::
+make() {
+    return message_ptr(frame_pool::local().take());
+}
+
+std::uint64_t
+frame_buffer::
+made() {
+    return buffersMade;
+}
+
+void
+frame_buffer::
+frame(bool binary) {
+    std::size_t n = 0;
+    header_[n++] = 0x80 | (binary ? 0x2 : 0x1); // FIN, the whole message in one frame
+    auto len = payload_.size();
+    if(len < 126) {
+        header_[n++] = static_cast<unsigned char>(len);
+    } else if(len <= 0xffff) {
+        header_[n++] = 126;
+        header_[n++] = static_cast<unsigned char>(len >> 8);
+        header_[n++] = static_cast<unsigned char>(len & 0xff);
+    } else {
+        header_[n++] = 127;
+        for(int shift = 56; shift >= 0; shift -= 8)
+            header_[n++] = static_cast<unsigned char>((std::uint64_t(len) >> shift) & 0xff);
+    }
+    header_size_ = static_cast<std::uint8_t>(n);
+}
+
+void
+intrusive_ptr_release(frame_buffer const* p) {
+    if(p->refs_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+    auto buffer = const_cast<frame_buffer*>(p);
+    buffer->home_->give_back(buffer);
+}
+
+frame_ptr
+frame_message(std::string_view payload, bool binary) {
+    auto frame = frame_buffer::make();
+    frame->payload().assign(payload);
+    frame->frame(binary);
+    return frame;
+}
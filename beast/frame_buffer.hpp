@@ -0,0 +1,78 @@
+#ifndef NOTIBEAST_FRAME_BUFFER_HPP
+#define NOTIBEAST_FRAME_BUFFER_HPP
+
+#include "net.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <boost/smart_ptr/intrusive_ptr.hpp>
+
+class frame_pool;
+
+// A message and the header making a complete websocket frame of it. The message is
+// rendered right into the payload, the header is put in front of it once it's done:
+// a frame is written as two buffers, with no copy. Buffers are refcounted, the last one
+// letting go of a buffer gives it back to the pool of the thread which made it, whichever
+// thread that happens on. The payload keeps its capacity, so once the pools hold enough
+// buffers, rendering and broadcasting messages doesn't allocate anymore.
+class frame_buffer {
+    mutable std::atomic<std::size_t> refs_{0};
+    std::shared_ptr<frame_pool> home_;
+    std::array<unsigned char, 10> header_{};
+    std::uint8_t header_size_ = 0; // 0 until it's framed
+    std::string payload_;
+
+    friend class frame_pool;
+    friend void intrusive_ptr_add_ref(frame_buffer const* p);
+    friend void intrusive_ptr_release(frame_buffer const* p);
+
+    explicit frame_buffer(std::shared_ptr<frame_pool> home) : home_(std::move(home)) {}
+
+public:
+    frame_buffer(frame_buffer const&) = delete;
+    frame_buffer& operator=(frame_buffer const&) = delete;
+
+    // An empty one, from the pool of the calling thread
+    static boost::intrusive_ptr<frame_buffer> make();
+
+    // Buffers made so far by all the threads, pooled or in use
+    static std::uint64_t made();
+
+    // To be rendered into, before it's framed and shared with the sessions
+    std::string& payload() { return payload_; }
+    std::string const& payload() const { return payload_; }
+
+    // Puts the header of a frame of the payload, as it is now, in front of it
+    void frame(bool binary);
+
+    // The header and the payload
+    std::size_t size() const { return header_size_ + payload_.size(); }
+
+    std::array<net::const_buffer, 2>
+    buffers() const {
+        return {net::buffer(header_.data(), header_size_), net::buffer(payload_)};
+    }
+};
+
+inline void intrusive_ptr_add_ref(frame_buffer const* p) {
+    p->refs_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void intrusive_ptr_release(frame_buffer const* p);
+
+// A message being rendered, and a frame as the sessions share it
+using message_ptr = boost::intrusive_ptr<frame_buffer>;
+using frame_ptr = boost::intrusive_ptr<frame_buffer const>;
+
+// The message as a complete websocket frame, header and payload. Frames from the server
+// aren't masked, so they are the same bytes for every client: a frame is built once and
+// written as it is to each of them, see frame_stream.
+frame_ptr
+frame_message(std::string_view payload, bool binary);
+
+#endif
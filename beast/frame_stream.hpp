@@ -0,0 +1,183 @@
+#ifndef NOTIBEAST_FRAME_STREAM_HPP
+#define NOTIBEAST_FRAME_STREAM_HPP
+
+#include "net.hpp"
+#include "beast.hpp"
+#include "frame_buffer.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+// The stream under the websocket stream of a session. Frames built by frame_message()
+// are written to it directly, bypassing the websocket stream, in between the frames the
+// websocket stream writes itself: pings, pongs and the close frame. Neither starts in
+// the middle of a frame of the other one, whatever the partial writes.
+template<class NextLayer>
+class frame_stream {
+    NextLayer next_;
+    net::steady_timer gate_;  // writes waiting for the other side to finish its frame
+    bool raw_ = false;        // a frame of ours is being written
+    std::uint64_t left_ = 0;  // bytes of the frame of the websocket stream not written yet
+
+    // Size of the frame the buffers start with
+    template<class ConstBufferSequence>
+    static std::uint64_t
+    frame_size(ConstBufferSequence const& buffers) {
+        unsigned char h[10];
+        auto n = net::buffer_copy(net::buffer(h), buffers);
+        if (n < 2)
+            return n;
+        std::uint64_t len = h[1] & 0x7f;
+        std::uint64_t header = 2;
+        if (len == 126 && n >= 4) {
+            header = 4;
+            len = std::uint64_t(h[2]) << 8 | h[3];
+        } else if (len == 127 && n >= 10) {
+            header = 10;
+            len = 0;
+            for (int i = 2; i < 10; ++i)
+                len = len << 8 | h[i];
+        }
+        if (h[1] & 0x80) // masked, the client side
+            header += 4;
+        return header + len;
+    }
+
+    // Calls f once the other side is done with its frame, on the executor of the handler
+    template<class Executor, class F>
+    void
+    wait(Executor const& ex, F&& f) {
+        gate_.async_wait(net::bind_executor(ex,
+            [f = std::forward<F>(f)](beast::error_code) mutable { f(); }));
+    }
+
+    template<class Handler, class ConstBufferSequence>
+    void
+    start_write_some(Handler handler, ConstBufferSequence const& buffers) {
+        auto ex = net::get_associated_executor(handler, get_executor());
+        if (raw_) {
+            wait(ex, [this, handler = std::move(handler), buffers]() mutable {
+                start_write_some(std::move(handler), buffers);
+            });
+            return;
+        }
+        if (left_ == 0)
+            left_ = frame_size(buffers);
+        next_.async_write_some(buffers, net::bind_executor(ex,
+            [this, handler = std::move(handler)](beast::error_code ec, std::size_t n) mutable {
+                left_ = ec ? 0 : left_ - std::min<std::uint64_t>(n, left_);
+                if (left_ == 0)
+                    gate_.cancel();
+                handler(ec, n);
+            }));
+    }
+
+    template<class Handler, class ConstBufferSequence>
+    void
+    start_write_frames(Handler handler, ConstBufferSequence const& frames) {
+        auto ex = net::get_associated_executor(handler, get_executor());
+        if (raw_ || left_) {
+            wait(ex, [this, handler = std::move(handler), frames]() mutable {
+                start_write_frames(std::move(handler), frames);
+            });
+            return;
+        }
+        raw_ = true;
+        net::async_write(next_, frames, net::bind_executor(ex,
+            [this, handler = std::move(handler)](beast::error_code ec, std::size_t n) mutable {
+                raw_ = false;
+                gate_.cancel();
+                handler(ec, n);
+            }));
+    }
+
+public:
+    using executor_type = typename NextLayer::executor_type;
+
+    template<class... Args>
+    explicit
+    frame_stream(Args&&... args)
+        : next_(std::forward<Args>(args)...)
+        , gate_(next_.get_executor(), net::steady_timer::time_point::max())
+    {}
+
+    executor_type get_executor() noexcept { return next_.get_executor(); }
+    NextLayer& next_layer() noexcept { return next_; }
+    NextLayer const& next_layer() const noexcept { return next_; }
+
+    template<class MutableBufferSequence>
+    std::size_t
+    read_some(MutableBufferSequence const& buffers) {
+        return next_.read_some(buffers);
+    }
+
+    template<class MutableBufferSequence>
+    std::size_t
+    read_some(MutableBufferSequence const& buffers, beast::error_code& ec) {
+        return next_.read_some(buffers, ec);
+    }
+
+    template<class MutableBufferSequence, class ReadHandler>
+    auto
+    async_read_some(MutableBufferSequence const& buffers, ReadHandler&& handler) {
+        return next_.async_read_some(buffers, std::forward<ReadHandler>(handler));
+    }
+
+    // Only while nothing is written asynchronously, e.g. closing the session
+    template<class ConstBufferSequence>
+    std::size_t
+    write_some(ConstBufferSequence const& buffers) {
+        return next_.write_some(buffers);
+    }
+
+    template<class ConstBufferSequence>
+    std::size_t
+    write_some(ConstBufferSequence const& buffers, beast::error_code& ec) {
+        return next_.write_some(buffers, ec);
+    }
+
+    // How the websocket stream writes its frames
+    template<class ConstBufferSequence, class WriteHandler>
+    auto
+    async_write_some(ConstBufferSequence const& buffers, WriteHandler&& handler) {
+        return net::async_initiate<WriteHandler, void(beast::error_code, std::size_t)>(
+            [this](auto handler, ConstBufferSequence const& buffers) {
+                start_write_some(std::move(handler), buffers);
+            }, handler, buffers);
+    }
+
+    // Writes a whole frame of frame_message(), which has to outlive the write
+    template<class WriteHandler>
+    auto
+    async_write_frame(frame_buffer const& frame, WriteHandler&& handler) {
+        return async_write_frames(frame.buffers(), std::forward<WriteHandler>(handler));
+    }
+
+    // Writes whole frames of frame_message(), one after the other in a single gathered
+    // write, whatever the buffers. The frames, and the sequence, have to outlive the write
+    template<class ConstBufferSequence, class WriteHandler>
+    auto
+    async_write_frames(ConstBufferSequence const& frames, WriteHandler&& handler) {
+        return net::async_initiate<WriteHandler, void(beast::error_code, std::size_t)>(
+            [this](auto handler, ConstBufferSequence const& frames) {
+                start_write_frames(std::move(handler), frames);
+            }, handler, frames);
+    }
+};
+
+template<class NextLayer>
+void
+teardown(beast::role_type role, frame_stream<NextLayer>& stream, beast::error_code& ec) {
+    using beast::websocket::teardown;
+    teardown(role, stream.next_layer(), ec);
+}
+
+template<class NextLayer, class TeardownHandler>
+void
+async_teardown(beast::role_type role, frame_stream<NextLayer>& stream, TeardownHandler&& handler) {
+    using beast::websocket::async_teardown;
+    async_teardown(role, stream.next_layer(), std::forward<TeardownHandler>(handler));
+}
+
+#endif
@@ -0,0 +1,90 @@
+#include "handoff_listener.hpp"
+#include "listener.hpp"
+#include "shared_state.hpp"
+#include "glue/handoff.h"
+
+#include <boost/log/trivial.hpp>
+#include <unistd.h>
+
+handoff_listener::
+handoff_listener(
+    net::io_context& ioc,
+    std::string const& path,
+    std::vector<boost::shared_ptr<listener>> listeners,
+    boost::shared_ptr<shared_state> const& state)
+    : ioc_(ioc)
+    , acceptor_(ioc)
+    , listeners_(std::move(listeners))
+    , state_(state)
+{
+    BOOST_LOG_TRIVIAL(info) << "Waiting for a successor on " << path;
+    // a leftover of the previous instance
+    unlink(path.c_str());
+    acceptor_.open();
+    acceptor_.bind(stream_protocol::endpoint(path));
+    acceptor_.listen();
+}
+
+handoff_listener::
+~handoff_listener() {
+    if(handover_.joinable())
+        handover_.join();
+}
+
+void
+handoff_listener::
+run() {
+    acceptor_.async_accept(
+        beast::bind_front_handler(
+            &handoff_listener::on_accept,
+            shared_from_this()));
+}
+
+void
+handoff_listener::
+on_accept(beast::error_code ec, stream_protocol::socket socket) {
+    if(ec) {
+        if(ec != net::error::operation_aborted)
+            BOOST_LOG_TRIVIAL(error) << "handoff accept: " << ec.message();
+        return;
+    }
+
+    BOOST_LOG_TRIVIAL(info) << "A successor connected, handing over";
+    for(auto& lsn : listeners_)
+        lsn->pause();
+    // the one of an earlier attempt is done by now
+    if(handover_.joinable())
+        handover_.join();
+    handover_ = std::thread(
+        [this, socket = std::move(socket)]() mutable {
+            hand_over(std::move(socket));
+        });
+}
+
+// On a thread of its own, the owner keeps the listener till it's joined
+void
+handoff_listener::
+hand_over(stream_protocol::socket socket) {
+    HandoffState handoffState;
+    handoffState.acceptorFd = listeners_.front()->native_handle();
+    if(!state_->suspend(handoffState)) {
+        BOOST_LOG_TRIVIAL(warning) << "The message provider doesn't support handoff";
+    } else {
+        try {
+            socket.native_non_blocking(false);
+            handOver(socket.native_handle(), handoffState);
+            BOOST_LOG_TRIVIAL(info) << "The successor took over, shutting down";
+            ioc_.stop();
+            return;
+        } catch (std::exception const& e) {
+            BOOST_LOG_TRIVIAL(error) << "Handoff failed, carrying on: " << e.what();
+        }
+        state_->resume();
+    }
+    // the acceptors belong to the io threads
+    net::post(ioc_, [this] {
+        for(auto& lsn : listeners_)
+            lsn->run();
+        run();
+    });
+}
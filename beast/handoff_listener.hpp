@@ -0,0 +1,45 @@
+#ifndef HANDOFF_LISTENER_HPP
+#define HANDOFF_LISTENER_HPP
+
+#include "beast.hpp"
+#include "net.hpp"
+
+#include <boost/smart_ptr.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+class listener;
+class shared_state;
+
+// Waits for a new instance of the service on a unix socket and hands the listening
+// socket and the inotify state over to it, see glue/handoff.h. The listeners of all
+// the threads share the socket. The handover blocks until the successor answers, it's
+// done on a thread of its own so that the sessions, timers and signals go on meanwhile;
+// the owner keeps the listener till the io_context is stopped, it waits for that thread
+class handoff_listener : public boost::enable_shared_from_this<handoff_listener>
+{
+    using stream_protocol = net::local::stream_protocol;
+
+    net::io_context& ioc_;
+    stream_protocol::acceptor acceptor_;
+    std::vector<boost::shared_ptr<listener>> listeners_;
+    boost::shared_ptr<shared_state> state_;
+    std::thread handover_;
+
+    void on_accept(beast::error_code ec, stream_protocol::socket socket);
+    void hand_over(stream_protocol::socket socket);
+
+public:
+    handoff_listener(
+        net::io_context& ioc,
+        std::string const& path,
+        std::vector<boost::shared_ptr<listener>> listeners,
+        boost::shared_ptr<shared_state> const& state);
+    ~handoff_listener();
+
+    // Start waiting for a successor
+    void run();
+};
+
+#endif
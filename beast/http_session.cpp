@@ -9,10 +9,12 @@
 //
 
 #include "http_session.hpp"
+#include "shared_state.hpp"
 #include "websocket_session.hpp"
 #include <boost/config.hpp>
 #include <boost/log/trivial.hpp>
 #include <iostream>
+#include <sstream>
 
 #define BOOST_NO_CXX14_GENERIC_LAMBDAS
 
@@ -88,6 +90,7 @@ template<
     class Send>
 void
 handle_request(
+    shared_state const& state,
     http::request<Body, http::basic_fields<Allocator>>&& req,
     Send&& send)
 {
@@ -103,6 +106,18 @@ handle_request(
         return res;
     };
 
+    if(req.method() == http::verb::get && req.target() == "/metrics") {
+        std::ostringstream body;
+        state.reportMetrics(body);
+        http::response<http::string_body> res{http::status::ok, req.version()};
+        res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+        res.set(http::field::content_type, "text/plain; version=0.0.4");
+        res.keep_alive(req.keep_alive());
+        res.body() = body.str();
+        res.prepare_payload();
+        return send(std::move(res));
+    }
+
     return send(bad_request("HTTP-methods are not supported"));
 }
 
@@ -218,6 +233,7 @@ on_read(beast::error_code ec, std::size_t) {
     // place of a generic lambda which is not available in C++11
     //
     handle_request(
+        *state_,
         parser_->release(),
         send_lambda(*this));
 
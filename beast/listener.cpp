@@ -12,6 +12,9 @@
 #include "http_session.hpp"
 #include <iostream>
 #include <boost/log/trivial.hpp>
+#include <cstring>
+#include <future>
+#include <sys/socket.h>
 
 namespace {
 
@@ -24,20 +27,37 @@ void fail(beast::error_code ec, char const* what) {
     }
 }
 
+// How long, in microseconds, the kernel busy-polls the device queue on a blocking receive
+constexpr int busyPollUs = 50;
+
+using reuse_port = net::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+
 } //namespace
 
 listener::
 listener(
     net::io_context& ioc,
     tcp::endpoint endpoint,
-    boost::shared_ptr<shared_state> const& state)
+    boost::shared_ptr<shared_state> const& state,
+    int inheritedFd,
+    bool lowLatency,
+    bool reusePort)
     : ioc_(ioc)
     , acceptor_(ioc)
     , state_(state)
+    , low_latency_(lowLatency)
 {
     BOOST_LOG_TRIVIAL(debug) << "Initialize listener";
     beast::error_code ec;
 
+    if(inheritedFd != -1) {
+        BOOST_LOG_TRIVIAL(debug) << "Use the inherited listening socket " << inheritedFd;
+        acceptor_.assign(endpoint.protocol(), inheritedFd, ec);
+        if(ec)
+            fail(ec, "assign");
+        return;
+    }
+
     BOOST_LOG_TRIVIAL(debug) << "Open the acceptor";
     acceptor_.open(endpoint.protocol(), ec);
     if(ec) {
@@ -52,6 +72,15 @@ listener(
         return;
     }
 
+    if(reusePort) {
+        BOOST_LOG_TRIVIAL(debug) << "Share the port with the other threads";
+        acceptor_.set_option(reuse_port(true), ec);
+        if(ec) {
+            fail(ec, "set_option");
+            return;
+        }
+    }
+
     BOOST_LOG_TRIVIAL(debug) << "Bind to the server address";
     acceptor_.bind(endpoint, ec);
     if(ec) {
@@ -73,15 +102,39 @@ listener::~listener() {
 
 void
 listener::
-run() { // The new connection gets its own strand
-    acceptor_.async_accept(
-        net::make_strand(ioc_),
-        beast::bind_front_handler(
-            &listener::on_accept,
-            shared_from_this()));
+run() {
+    // The acceptor belongs to the thread of ioc_
+    net::dispatch(ioc_, [self = shared_from_this()] {
+        // The new connection gets its own strand
+        self->acceptor_.async_accept(
+            net::make_strand(self->ioc_),
+            beast::bind_front_handler(
+                &listener::on_accept,
+                self));
+    });
 }
 
 
+void
+listener::
+pause() {
+    auto cancel = [this] {
+        BOOST_LOG_TRIVIAL(debug) << "Stop accepting connections";
+        beast::error_code ec;
+        acceptor_.cancel(ec);
+        if(ec)
+            fail(ec, "cancel");
+    };
+    if(ioc_.get_executor().running_in_this_thread())
+        return cancel();
+    std::promise<void> done;
+    net::post(ioc_, [&] {
+        cancel();
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
 // Handle a connection
 void
 listener::
@@ -93,6 +146,14 @@ on_accept(beast::error_code ec, tcp::socket socket)
         auto clientIp = socket.remote_endpoint().address().to_string();
         auto clientPort = socket.remote_endpoint().port();
         BOOST_LOG_TRIVIAL(info) << "Accepting connection from " << clientIp<< ":" <<clientPort; 
+        if(low_latency_) {
+            socket.set_option(tcp::no_delay(true), ec);
+            if(ec)
+                fail(ec, "no_delay");
+            // it may require CAP_NET_ADMIN, the connection works without it just as well
+            if(setsockopt(socket.native_handle(), SOL_SOCKET, SO_BUSY_POLL, &busyPollUs, sizeof(busyPollUs)) == -1)
+                BOOST_LOG_TRIVIAL(debug) << "SO_BUSY_POLL is not set: " << strerror(errno);
+        }
         // Launch a new session for this connection
         boost::make_shared<http_session>(
             std::move(socket),
@@ -26,19 +26,34 @@ class listener : public boost::enable_shared_from_this<listener>
     net::io_context& ioc_;
     tcp::acceptor acceptor_;
     boost::shared_ptr<shared_state> state_;
+    bool low_latency_;
 
     void on_accept(beast::error_code ec, tcp::socket socket);
 
 public:
+    // A listening socket inherited from a previous instance
+    // can be passed in with inheritedFd. With lowLatency, accepted
+    // sockets get TCP_NODELAY and SO_BUSY_POLL. With reusePort,
+    // listeners of other threads may bind the same endpoint, the
+    // kernel spreads the connections among them.
     listener(
         net::io_context& ioc,
         tcp::endpoint endpoint,
-        boost::shared_ptr<shared_state> const& state);
+        boost::shared_ptr<shared_state> const& state,
+        int inheritedFd = -1,
+        bool lowLatency = false,
+        bool reusePort = false);
 
     ~listener();
 
-    // Start accepting incoming connections
+    // Start accepting incoming connections, from any thread
     void run();
+
+    // Stop accepting, e.g. while handing the socket over to a new instance.
+    // From any thread, it returns once the listener stopped
+    void pause();
+
+    int native_handle() { return acceptor_.native_handle(); }
 };
 
 #endif
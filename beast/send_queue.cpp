@@ -0,0 +1,152 @@
+#include "send_queue.hpp"
+
+#include <algorithm>
+#include <utility>
+
+send_queue&
+send_queue::
+operator=(send_queue&& other) {
+    ring_ = std::move(other.ring_);
+    head_ = std::exchange(other.head_, 0);
+    size_ = std::exchange(other.size_, 0);
+    bytes_ = std::exchange(other.bytes_, 0);
+    writing_ = std::exchange(other.writing_, 0);
+    index_ = std::move(other.index_);
+    std::scoped_lock lock(masks_mutex_, other.masks_mutex_);
+    masks_ = std::move(other.masks_);
+    return *this;
+}
+
+void
+send_queue::
+push_back(entry e) {
+    if (size_ == ring_.size()) {
+        std::vector<entry> ring(std::max<std::size_t>(8, ring_.size() * 2));
+        for (std::size_t i = 0; i < size_; ++i)
+            ring[i] = std::move(at(i));
+        ring_ = std::move(ring);
+        head_ = 0;
+        // slots changed, the latest message about a key wins as before
+        index_.clear();
+        for (std::size_t i = pinned(); i < size_; ++i)
+            if (at(i).key)
+                index_[at(i).key] = i;
+    }
+    bytes_ += e.frame->size();
+    at(size_++) = std::move(e);
+    if (back().key && size_ > pinned())
+        index(size_ - 1);
+}
+
+void
+send_queue::
+pop_front() {
+    bytes_ -= front().frame->size();
+    unindex(0);
+    front() = {};
+    head_ = (head_ + 1) & (ring_.size() - 1);
+    --size_;
+    if (writing_)
+        --writing_;
+    unindex_pinned();
+}
+
+void
+send_queue::
+start_writing(std::size_t n) {
+    writing_ = n;
+    unindex_pinned();
+}
+
+// Frames being written, or about to be, take no other message's place: later
+// messages about the same go on their own, and aren't rendered with their masks
+void
+send_queue::
+unindex_pinned() {
+    for (std::size_t i = 0; i < std::min(pinned(), size_); ++i)
+        unindex(i);
+}
+
+std::size_t
+send_queue::
+first_droppable() const {
+    for (auto i = pinned(); i < size_; ++i)
+        if (at(i).events)
+            return i;
+    return size_;
+}
+
+std::chrono::steady_clock::time_point
+send_queue::
+oldest_droppable() const {
+    auto k = first_droppable();
+    return k < size_ ? at(k).queued : std::chrono::steady_clock::time_point::max();
+}
+
+void
+send_queue::
+replace(std::size_t i, entry e) {
+    bytes_ -= at(i).frame->size();
+    bytes_ += e.frame->size();
+    unindex(i);
+    at(i) = std::move(e);
+    if (at(i).key)
+        index(i);
+}
+
+bool
+send_queue::
+conflate(conflation_key const& key, frame_ptr const& frame,
+         std::uint32_t mask) {
+    auto it = index_.find(key);
+    if (it == index_.end())
+        return false;
+    auto i = (it->second - head_) & (ring_.size() - 1);
+    auto& e = at(i);
+    if (i < pinned() || (e.mask | mask) != mask)
+        return false;
+    bytes_ -= e.frame->size();
+    bytes_ += frame->size();
+    e.frame = frame;
+    e.mask = mask;
+    std::lock_guard<std::mutex> lock(masks_mutex_);
+    masks_[key] |= mask;
+    return true;
+}
+
+std::uint32_t
+send_queue::
+conflated_mask(conflation_key const& key, std::uint32_t mask) {
+    std::lock_guard<std::mutex> lock(masks_mutex_);
+    auto it = masks_.find(key);
+    return it == masks_.end() ? mask : it->second |= mask;
+}
+
+bool
+send_queue::
+indexed(std::size_t i) const {
+    if (! at(i).key)
+        return false;
+    auto it = index_.find(at(i).key);
+    return it != index_.end() && it->second == slot(i);
+}
+
+void
+send_queue::
+index(std::size_t i) {
+    auto const& e = at(i);
+    index_[e.key] = slot(i);
+    // the one about the same before it, if any, is pinned or replaced
+    std::lock_guard<std::mutex> lock(masks_mutex_);
+    masks_[e.key] = e.mask;
+}
+
+void
+send_queue::
+unindex(std::size_t i) {
+    if (! indexed(i))
+        return;
+    index_.erase(at(i).key);
+    std::lock_guard<std::mutex> lock(masks_mutex_);
+    masks_.erase(at(i).key);
+}
@@ -0,0 +1,190 @@
+#ifndef NOTIBEAST_SEND_QUEUE_HPP
+#define NOTIBEAST_SEND_QUEUE_HPP
+
+#include "frame_buffer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// What a session does once it's too far behind
+enum class queue_policy {
+    drop_oldest, // frames waiting the longest make room
+    drop_newest, // frames coming in are dropped until there's room
+    disconnect   // the client is disconnected
+};
+
+// How far behind a session may be, e.g. "queue": {"policy": "dropNewest", "bytes": 65536, "seconds": 5}
+struct queue_limits {
+    queue_policy policy = queue_policy::drop_oldest;
+    std::size_t bytes = 0;         // queued at most, 0 - the server's cap (--queue_bytes)
+    std::chrono::seconds age{0};   // the oldest frame waiting at most that long, 0 - no limit
+};
+
+// Bytes all the sessions have queued, against the caps of the server
+struct queue_budget {
+    std::size_t session_cap = 4 << 20; // --queue_bytes
+    std::size_t total_cap = 64 << 20;  // --queue_total_bytes
+    std::atomic<std::size_t> queued{0};
+    std::atomic<std::uint64_t> dropped{0};      // messages
+    std::atomic<std::uint64_t> disconnected{0}; // sessions
+};
+
+// What a message is about: the name in the directory of the id, see Rendering.
+// Messages about the same may be conflated for a client falling behind
+struct conflation_key {
+    std::uint32_t path_id = 0;
+    std::string name;
+
+    // messages without a directory or a name are not conflated
+    explicit operator bool() const { return path_id && ! name.empty(); }
+
+    bool operator==(conflation_key const& other) const {
+        return path_id == other.path_id && name == other.name;
+    }
+};
+
+struct conflation_key_hash {
+    std::size_t operator()(conflation_key const& key) const {
+        return std::hash<std::string_view>{}(key.name) ^ (std::size_t(key.path_id) * 0x9e3779b97f4a7c15);
+    }
+};
+
+// The frames of a session waiting to be written, oldest first. The first writing() ones
+// are being written, in a single gathered write, the front one at least as long as there
+// is one. Those are never dropped nor replaced. A ring, growing as needed, the session
+// keeps it bounded.
+class send_queue {
+public:
+    struct entry {
+        frame_ptr frame; // see frame_message()
+        std::size_t events = 0; // messages in the frame, 0 if it's never to be dropped, e.g. defines path ids
+        std::size_t gap = 0;    // a gap record, of that many messages dropped right there
+        std::chrono::steady_clock::time_point queued;
+        conflation_key key;     // of a message which may be conflated
+        std::uint32_t mask = 0; // it's rendered with
+    };
+
+    send_queue() = default;
+    send_queue(send_queue&& other) { *this = std::move(other); }
+    send_queue& operator=(send_queue&& other);
+
+    bool empty() const { return size_ == 0; }
+    std::size_t size() const { return size_; }
+    std::size_t bytes() const { return bytes_; }
+
+    entry& front() { return at(0); }
+    entry& back() { return at(size_ - 1); }
+    entry& at(std::size_t i) { return ring_[slot(i)]; }
+    entry const& at(std::size_t i) const { return ring_[slot(i)]; }
+
+    void push_back(entry e);
+    void pop_front();
+
+    // The first n frames are being written, till they are popped
+    void start_writing(std::size_t n);
+    std::size_t writing() const { return writing_; }
+
+    // When the oldest frame waiting which may be dropped was queued, or never
+    // if there's no such frame
+    std::chrono::steady_clock::time_point oldest_droppable() const;
+
+    // Drops the oldest frame waiting which may be dropped. A gap record made by
+    // make_gap(dropped) takes its place, or the gap record right before it counts
+    // its messages as well. Returns the messages dropped, 0 if nothing could be
+    template<class MakeGap>
+    std::size_t drop_oldest(MakeGap&& make_gap);
+
+    // Counts the messages of a frame dropped as it came in: the gap record at the back
+    // counts them as well, unless it's being written, or one made by make_gap(dropped)
+    // is queued. Not on an empty queue, nothing would write the record
+    template<class MakeGap>
+    void drop_newest(std::size_t dropped, MakeGap&& make_gap);
+
+    // The frame of the message waiting about the key takes the place of the one about
+    // the same, unless that one is being written or has bits of its mask the new one
+    // lacks. Returns false if it didn't, the frame is to be queued on its own then
+    bool conflate(conflation_key const& key, frame_ptr const& frame,
+                  std::uint32_t mask);
+
+    // The mask a message about the key is to be rendered with, to take the place of
+    // the one waiting about the same: OR-ed with its mask, unless there's none waiting
+    // but the ones being written. From any thread
+    std::uint32_t conflated_mask(conflation_key const& key, std::uint32_t mask);
+
+private:
+    std::vector<entry> ring_;
+    std::size_t head_ = 0;
+    std::size_t size_ = 0;
+    std::size_t bytes_ = 0;
+    std::size_t writing_ = 0;
+
+    // Slots in ring_ of the messages which may be conflated, the latest one about each key,
+    // unless it's pinned
+    std::unordered_map<conflation_key, std::size_t, conflation_key_hash> index_;
+
+    // Masks of the messages of index_, for the threads rendering the messages to come.
+    // The masks of those which are to take their place are OR-ed in
+    std::mutex masks_mutex_;
+    std::unordered_map<conflation_key, std::uint32_t, conflation_key_hash> masks_;
+
+    std::size_t slot(std::size_t i) const { return (head_ + i) & (ring_.size() - 1); }
+    // frames before it are being written, or about to be
+    std::size_t pinned() const { return std::max<std::size_t>(writing_, 1); }
+    bool indexed(std::size_t i) const;
+    void index(std::size_t i);
+    void unindex(std::size_t i);
+    void unindex_pinned();
+
+    std::size_t first_droppable() const;
+    void replace(std::size_t i, entry e);
+};
+
+template<class MakeGap>
+std::size_t
+send_queue::
+drop_oldest(MakeGap&& make_gap) {
+    auto k = first_droppable();
+    if (k == size_)
+        return 0;
+    auto dropped = at(k).events;
+    if (k > pinned() && at(k - 1).gap) {
+        // the frames before it move up, the gap record lands in its place
+        auto gap = at(k - 1).gap + dropped;
+        bytes_ -= at(k).frame->size();
+        unindex(k);
+        for (auto i = k; i > 0; --i) {
+            auto moved = indexed(i - 1);
+            at(i) = std::move(at(i - 1));
+            if (moved)
+                index_[at(i).key] = slot(i);
+        }
+        at(0) = {};
+        head_ = (head_ + 1) & (ring_.size() - 1);
+        --size_;
+        replace(k - 1, make_gap(gap));
+    } else {
+        replace(k, make_gap(dropped));
+    }
+    return dropped;
+}
+
+template<class MakeGap>
+void
+send_queue::
+drop_newest(std::size_t dropped, MakeGap&& make_gap) {
+    if (size_ > pinned() && back().gap)
+        replace(size_ - 1, make_gap(back().gap + dropped));
+    else
+        push_back(make_gap(dropped));
+}
+
+#endif
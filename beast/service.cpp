@@ -2,7 +2,16 @@
 
 #include <boost/asio.hpp>
 #include <boost/log/trivial.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <unistd.h>
 
+#include "glue/cpu_affinity.h"
+#include "handoff_listener.hpp"
 #include "listener.hpp"
 #include "shared_state.hpp"
 
@@ -10,19 +19,72 @@ namespace net = boost::asio;                    // from <boost/asio.hpp>
 
 using tcp = boost::asio::ip::tcp;               // from <boost/asio/ip/tcp.hpp>
 
-void runService(const Options &options, const MessageProviderFactory &mpFactory) {
+namespace {
+
+void runIo(net::io_context &ioc, bool lowLatency) {
+  if (lowLatency) {
+    // spin instead of sleeping in epoll
+    while (!ioc.stopped()) {
+      if (ioc.poll() == 0) {
+        std::this_thread::yield();
+      }
+    }
+  } else {
+    ioc.run();
+  }
+}
+
+} //namespace
+
+void runService(const Options &options, const MessageProviderFactory &mpFactory, int acceptorFd,
+                OptionsLoader reloadOptions) {
   auto address = net::ip::make_address(options.address);
   auto port = static_cast<unsigned short>(std::stoi(options.port));
+  auto threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+
+  // An io_context per thread, the calling one being the first. A connection stays
+  // on the thread which accepted it, so what's sent to a session keeps its order
+  std::vector<std::unique_ptr<net::io_context>> iocs;
+  for (unsigned i = 0; i < threads; ++i) {
+    iocs.push_back(std::make_unique<net::io_context>(1));
+  }
+  auto &ioc = *iocs.front();
+
+  auto state = boost::make_shared<shared_state>(ioc, mpFactory, std::move(reloadOptions), options.lowLatency,
+                                               options.queueBytes, options.queueTotalBytes,
+                                               std::chrono::seconds(options.catchupRetention),
+                                               options.adminToken);
 
-  // The io_context is required for all I/O
-  net::io_context ioc;
+  // Each thread listens on a socket of its own, bound with SO_REUSEPORT. An inherited socket,
+  // or one to be handed over to a successor, is shared by all of them instead
+  bool sharedSocket = acceptorFd != -1 || !options.handoffSocket.empty();
+  std::vector<boost::shared_ptr<listener>> listeners;
+  for (unsigned i = 0; i < threads; ++i) {
+    int fd = acceptorFd;
+    if (i > 0) {
+      fd = sharedSocket ? dup(listeners.front()->native_handle()) : -1;
+      if (sharedSocket && fd == -1) {
+        BOOST_LOG_TRIVIAL(error) << "Thread " << i << " can't share the listening socket: " << strerror(errno);
+        continue;
+      }
+    }
+    listeners.push_back(boost::make_shared<listener>(
+      *iocs[i],
+      tcp::endpoint{address, port},
+      state,
+      fd,
+      options.lowLatency,
+      threads > 1 && !sharedSocket
+    ));
+    listeners.back()->run();
+  }
 
-  // Create and launch a listening port
-  boost::make_shared<listener>(
-    ioc,
-    tcp::endpoint{address, port},
-    boost::make_shared<shared_state>(mpFactory)
-  )->run();
+  // kept till the end, a handover under way is waited for
+  boost::shared_ptr<handoff_listener> handoff;
+  if (!options.handoffSocket.empty()) {
+    handoff = boost::make_shared<handoff_listener>(ioc, options.handoffSocket, listeners, state);
+    handoff->run();
+  }
 
   // Capture SIGINT and SIGTERM to perform a clean shutdown
   net::signal_set signals(ioc, SIGINT, SIGTERM);
@@ -35,5 +97,48 @@ void runService(const Options &options, const MessageProviderFactory &mpFactory)
       ioc.stop();
     });
 
-  ioc.run();
+  // Capture SIGHUP to re-read the configuration
+  net::signal_set reloadSignals(ioc, SIGHUP);
+  std::function<void(boost::system::error_code const&, int)> onReload =
+    [&](boost::system::error_code const& ec, int) {
+      if (ec) {
+        return;
+      }
+      BOOST_LOG_TRIVIAL(info) << "Caught SIGHUP";
+      state->reload();
+      reloadSignals.async_wait(onReload);
+    };
+  reloadSignals.async_wait(onReload);
+
+  if (options.lowLatency && std::thread::hardware_concurrency() < threads + 2) {
+    BOOST_LOG_TRIVIAL(warning) << "Low latency mode busy-polls on " << threads + 1 << " threads, "
+      << std::thread::hardware_concurrency() << " cores are not enough for it to pay off";
+  }
+
+  // Pinned only now: the threads the message provider started along with the
+  // shared_state would have inherited the core meant for the network loop
+  pinCurrentThread(options.ioCpu);
+
+  std::vector<std::thread> workers;
+  for (unsigned i = 1; i < threads; ++i) {
+    workers.emplace_back([&options, &iocs, i]() {
+      pinCurrentThread(options.ioCpu < 0 ? -1 : options.ioCpu + static_cast<int>(i));
+      runIo(*iocs[i], options.lowLatency);
+    });
+  }
+  runIo(ioc, options.lowLatency);
+
+  // The first thread stops them all
+  for (auto &other : iocs) {
+    other->stop();
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  handoff.reset();
+  // the shared_state's own io_context goes last, sessions of the others leave it on their way
+  listeners.clear();
+  while (iocs.size() > 1) {
+    iocs.pop_back();
+  }
 }
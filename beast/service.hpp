@@ -4,6 +4,10 @@
 #include "glue/options.h"
 #include "glue/message_provider_factory.h"
 
-void runService(const Options &options, const MessageProviderFactory &mpFactory);
+// A listening socket inherited from a previous instance can be passed in with acceptorFd.
+// reloadOptions is called on SIGHUP and on a 'reload' command of a loopback client,
+// or of one with the --admin_token if there's one.
+void runService(const Options &options, const MessageProviderFactory &mpFactory, int acceptorFd = -1,
+                OptionsLoader reloadOptions = {});
 
 #endif
@@ -10,12 +10,88 @@
 
 #include "shared_state.hpp"
 #include "websocket_session.hpp"
+#include "deflate.hpp"
+#include "frame_stream.hpp"
+#include "glue/cpu_affinity.h"
 #include "glue/message_provider_factory.h"
+#include <boost/log/trivial.hpp>
+#include <algorithm>
+#include <thread>
+
+namespace {
+// Bounds the memory kept for late subscribers
+constexpr size_t maxRetained = 100000;
+
+// Path ids a client has to keep at most, it's told to forget them all beyond that
+constexpr size_t maxPathIds = 65536;
+
+// Versions of the snapshots of all the shared_states, a thread's copy of one is never taken
+// for another's
+std::atomic<std::uint64_t> snapshotVersions{0};
+
+// A thread sending, as the sessions leaving see it: the version of the snapshot it walks,
+// 0 while it walks none
+struct reader {
+    std::atomic<std::uint64_t> walking{0};
+};
+
+std::mutex readersMutex;
+std::vector<reader const*> readers; // of the threads which sent so far, and still run
+
+reader&
+local_reader() {
+    struct registered {
+        reader r;
+        registered() {
+            std::lock_guard<std::mutex> lock(readersMutex);
+            readers.push_back(&r);
+        }
+        ~registered() {
+            std::lock_guard<std::mutex> lock(readersMutex);
+            readers.erase(std::find(readers.begin(), readers.end(), &r));
+        }
+    };
+    thread_local registered reg;
+    return reg.r;
+}
+
+// Returns once no other thread walks a snapshot older than version: the sessions
+// which aren't in it are not to be walked anymore then
+void
+wait_for_readers(std::uint64_t version) {
+    auto const* self = &local_reader();
+    for (;;) {
+        bool walking = false;
+        {
+            std::lock_guard<std::mutex> lock(readersMutex);
+            for (auto r : readers) {
+                auto v = r->walking.load();
+                walking = walking || (r != self && v && v < version);
+            }
+        }
+        if (!walking)
+            return;
+        std::this_thread::yield();
+    }
+}
+}
 
 shared_state::
-shared_state(const MessageProviderFactory &factory)
-  : messageProvider_{factory.makeMessageProvider(*this)}
-{}
+shared_state(net::io_context& ioc, const MessageProviderFactory &factory,
+             OptionsLoader loadOptions, bool lowLatency,
+             std::size_t queueBytes, std::size_t queueTotalBytes,
+             std::chrono::seconds retainFor, std::string adminToken)
+  : version_{++snapshotVersions}
+  , retainFor_{retainFor}
+  , ioc_{ioc}
+  , lowLatency_{lowLatency}
+  , messageProvider_{factory.makeMessageProvider(*this)}
+  , loadOptions_{std::move(loadOptions)}
+  , adminToken_{std::move(adminToken)}
+{
+    budget_.session_cap = queueBytes;
+    budget_.total_cap = queueTotalBytes;
+}
 
 shared_state::~shared_state() {}
 
@@ -23,51 +99,630 @@ void
 shared_state::
 join(websocket_session* session) {
     std::lock_guard<std::mutex> lock(mutex_);
-    sessions_[session] = 0;
+    sessions_[session] = {session, session->weak_from_this(), {}, nullptr};
+    publish();
 }
 
 void
 shared_state::
 leave(websocket_session* session) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    sessions_.erase(session);
+    std::vector<frame> frames;
+    std::uint64_t version;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = sessions_.find(session);
+        if (it == sessions_.end())
+            return;
+        unbatch(it->second.sub, frames);
+        sessions_.erase(it);
+        updateMetadata();
+        publish();
+        version = version_.load();
+    }
+    deliver(frames);
+    // the session is gone once no thread walks the snapshots it's in
+    wait_for_readers(version);
+}
+
+// Tells the provider what to gather, nobody pays for metadata nobody asked for.
+// Called with mutex_ locked
+void
+shared_state::
+updateMetadata() {
+    unsigned metadata = 0;
+    for(auto const& p : sessions_)
+        metadata |= p.second.sub.metadata;
+    if (metadata != metadata_) {
+        metadata_ = metadata;
+        messageProvider_->requestMetadata(metadata);
+    }
+}
+
+// Sending in progress still walks the snapshot it started with, a session leaving
+// meanwhile waits for it in leave(). Called with mutex_ locked
+void
+shared_state::
+publish() {
+    auto s = std::make_shared<snapshot>();
+    s->sessions = sessions_.size();
+    std::unordered_map<uint64_t, std::size_t> group_of;
+    for(auto const& p : sessions_) {
+        auto mask = p.second.sub.mask;
+        if (mask == 0) // not subscribed yet
+            continue;
+        auto [it, added] = group_of.try_emplace(mask, s->masks.size());
+        if (added) {
+            s->masks.push_back(mask);
+            s->groups.emplace_back();
+        }
+        s->groups[it->second].push_back(p.second);
+    }
+    std::atomic_store(&snapshot_, std::shared_ptr<snapshot const>(std::move(s)));
+    version_.store(++snapshotVersions);
+}
+
+// The sessions as of the last join, leave or subscribe, till walked() is called. The thread
+// tells which version it walks first, so a session leaving meanwhile waits for it, see leave():
+// the sessions are walked with no reference taken. std::atomic_load() of snapshot_ locks one
+// of libstdc++'s mutexes, so a thread takes it only once another snapshot is published, and
+// keeps a copy in between: loading version_ is all it takes then
+shared_state::snapshot const&
+shared_state::
+walk() const {
+    struct copy {
+        std::uint64_t version = 0;
+        std::shared_ptr<snapshot const> subscribers;
+    };
+    thread_local copy c;
+    auto& r = local_reader();
+    std::uint64_t version;
+    do {
+        version = version_.load();
+        r.walking.store(version);
+    } while (version_.load() != version);
+    // a newer one maybe, which is as good
+    if (c.version != version) {
+        c.subscribers = std::atomic_load(&snapshot_);
+        c.version = version;
+    }
+    return *c.subscribers;
+}
+
+void
+shared_state::
+walked() const {
+    local_reader().walking.store(0);
+}
+
+message_ptr
+shared_state::
+find(rendered const& messages, rendering_key const& key) {
+    for (auto const& [k, ss] : messages)
+        if (k.format == key.format && k.rendering == key.rendering && k.projection == key.projection)
+            return ss;
+    return {};
+}
+
+// The message in the format and projection, rendered on first use, right into a pooled buffer
+message_ptr
+shared_state::
+in_format(MessageRenderer const& render, rendered& messages, WireFormat format,
+          Rendering rendering, Projection const& projection) {
+    rendering_key key{format, rendering, projection};
+    if (auto ss = find(messages, key))
+        return ss;
+    auto message = frame_buffer::make();
+    render(message->payload(), format, rendering, projection);
+    messages.emplace_back(key, message);
+    return message;
+}
+
+Projection
+shared_state::
+projection_of(subscription const& sub) {
+    return {sub.fields, sub.metadata};
+}
+
+// Whether the path id is to be defined first. When there are too many
+// of them already, they're all forgotten, and so is to be told beforehand
+bool
+shared_state::
+learn(std::unordered_set<uint32_t>& known, uint32_t pathId, bool& reset) {
+    if (known.count(pathId))
+        return false;
+    if (known.size() >= maxPathIds) {
+        known.clear();
+        reset = true;
+    }
+    known.insert(pathId);
+    return true;
 }
 
 // Broadcast a message to all websocket client sessions
 void
 shared_state::
-send(std::string message, int mask) const {
-    // Put the message in a shared pointer so we can re-use it for each client
-    auto const ss = boost::make_shared<std::string const>(std::move(message));
+send(MessageRenderer const& render, int mask, uint32_t pathId, std::string_view name) const {
+    // No lock, unless the sessions changed since this thread last sent, see walk()
+    std::vector<frame> packed;
+    fanout(render, mask, pathId, name, walk(), packed,
+        [](websocket_session* session, websocket_session::outgoing&& frame) {
+            session->send(std::move(frame));
+        });
+    walked();
+    deliver(packed);
+}
+
+// Broadcast the messages, each session gets its frames of all of them at once, unless it gets path ids
+void
+shared_state::
+send(std::vector<OutgoingMessage> const& batch) const {
+    auto const& subscribers = walk();
+    std::vector<frame> packed;
+    std::unordered_map<websocket_session*, std::vector<websocket_session::outgoing>> handoffs;
+    for (auto const& m : batch)
+        fanout(m.render, m.mask, m.pathId, m.name, subscribers, packed,
+            [&handoffs](websocket_session* session, websocket_session::outgoing&& frame) {
+                handoffs[session].push_back(std::move(frame));
+            });
+    for (auto& [session, frames] : handoffs)
+        session->send(std::move(frames));
+    walked();
+    deliver(packed);
+}
 
-    // Make a local list of all the weak pointers representing
-    // the sessions, so we can do the actual sending without
-    // holding the mutex:
-    std::vector<std::pair<boost::weak_ptr<websocket_session>, uint64_t>> v;
+// Renders the message for the sessions whose mask matches, deliver(session, frame) hands their frames
+// over. Those of sessions getting path ids are handed over right away, see below. The frames of the
+// batches it fills up are added to packed, they're delivered once the sessions aren't walked anymore
+template<class Deliver>
+void
+shared_state::
+fanout(MessageRenderer const& render, int mask, uint32_t pathId, std::string_view name,
+       snapshot const& subscribers, std::vector<frame>& packed, Deliver&& deliver) const {
+    auto const& masks = subscribers.masks;
+
+    // Each format and projection is rendered once and shared by all the sessions
+    // which asked for it, so are its frames, plain and compressed. The thread's
+    // vectors, kept for the messages to come
+    thread_local rendered messages;
+    thread_local rendered frames;
+    thread_local rendered compressed;
+    messages.clear();
+    frames.clear();
+    compressed.clear();
+    bool batched = false;
+
+    // path definitions and resets are the same whatever the projection
+    auto frame_for = [&](subscription const& sub, Rendering rendering, uint32_t conflatedMask) {
+        auto projection = rendering == Rendering::full || rendering == Rendering::pathId
+            ? projection_of(sub) : Projection{};
+        projection.mask = conflatedMask;
+        rendering_key key{sub.format, rendering, projection};
+        auto& cache = sub.compress ? compressed : frames;
+        auto frame = find(cache, key);
+        if (!frame) {
+            auto ss = in_format(render, messages, sub.format, rendering, projection);
+            if (sub.compress) {
+                frame = deflated(ss->payload());
+            } else {
+                // framed where it is, the payload stays as it is for the others
+                ss->frame(isBinary(sub.format));
+                frame = ss;
+            }
+            cache.emplace_back(key, frame);
+        }
+        return frame;
+    };
+    // Only the sessions whose mask matches are visited, the others are just counted
+    std::size_t matched = 0;
+    for(std::size_t g = 0; g < masks.size(); ++g) {
+        if (!(mask & masks[g]))
+            continue;
+        auto const& group = subscribers.groups[g];
+        matched += group.size();
+        for(auto const& s : group) {
+            auto const& sub = s.sub;
+            auto rendering = pathId && sub.pathIds ? Rendering::pathId : Rendering::full;
+            if (sub.batch.enabled()) {
+                // packed once for all the sessions sharing the batch
+                in_format(render, messages, sub.format, rendering, projection_of(sub));
+                batched = true;
+            } else {
+                auto sp = s.session;
+                // A session getting path ids is handed its frames right away, with its ids locked:
+                // a message sent meanwhile can't reach it with an id before the definition of it,
+                // or with one it's told to forget before
+                std::unique_lock<std::mutex> lock;
+                if (s.paths)
+                    lock = std::unique_lock<std::mutex>(s.paths->mutex);
+                auto hand_over = [&](websocket_session::outgoing&& frame) {
+                    if (lock)
+                        sp->send(std::move(frame));
+                    else
+                        deliver(sp, std::move(frame));
+                };
+                bool reset = false;  // the session forgets the path ids it got so far
+                bool define = false; // it gets the definition of pathId first
+                if (rendering == Rendering::pathId)
+                    define = learn(s.paths->ids, pathId, reset);
+                if (reset)
+                    hand_over({frame_for(sub, Rendering::pathReset, 0), 0, {}, 0});
+                if (define)
+                    hand_over({frame_for(sub, Rendering::pathDefinition, 0), 0, {}, 0});
+                if (sub.conflate && !name.empty() && pathId) {
+                    // should the session fall behind, the message takes the place of the one
+                    // waiting about the same file, with the mask of both
+                    conflation_key key{pathId, std::string(name)};
+                    auto merged = sp->conflated_mask(key, static_cast<uint32_t>(mask));
+                    auto frame = frame_for(sub, rendering, merged == static_cast<uint32_t>(mask) ? 0 : merged);
+                    hand_over({frame, 1, std::move(key), merged});
+                } else {
+                    hand_over({frame_for(sub, rendering, 0), 1, {}, 0});
+                }
+            }
+        }
+    }
+    if (matched < subscribers.sessions)
+        filtered_ += subscribers.sessions - matched;
+    if (batched)
+        pack(render, messages, mask, pathId, packed);
+    // the buffers go back to their pools
+    messages.clear();
+    frames.clear();
+    compressed.clear();
+}
+
+shared_state::batch_key
+shared_state::
+key_of(subscription const& sub) {
+    return {sub.mask, sub.format, sub.compress, sub.pathIds, sub.fields, sub.metadata,
+            sub.batch.bytes, sub.batch.events, sub.batch.delay.count()};
+}
+
+// A frame of the message compressed
+message_ptr
+shared_state::
+deflated(std::string_view message) const {
+    auto frame = frame_buffer::make();
+    deflate_message(message, frame->payload());
+    deflatedIn_ += message.size();
+    deflatedOut_ += frame->payload().size();
+    frame->frame(true);
+    return frame;
+}
+
+// Adds the message to the frames of the batched subscriptions it matches,
+// after the path definitions their sessions need, if any
+void
+shared_state::
+pack(MessageRenderer const& render, rendered& messages, int mask, uint32_t pathId,
+     std::vector<frame>& frames) const {
     {
         std::lock_guard<std::mutex> lock(mutex_);
-        v.reserve(sessions_.size());
-        for(auto p : sessions_)
-            v.emplace_back(p.first->weak_from_this(), p.second);
+        for (auto& [key, b] : batches_) {
+            auto& [bmask, format, compress, pathIds, fields, metadata, bytes, events, delay] = key;
+            if (!(mask & bmask))
+                continue;
+            auto rendering = pathId && pathIds ? Rendering::pathId : Rendering::full;
+            auto ss = find(messages, {format, rendering, {fields, metadata}});
+            if (!ss) // not rendered: its sessions left in between
+                continue;
+            message_ptr reset;
+            message_ptr definition;
+            auto size = ss->payload().size();
+            bool forget = false;
+            if (rendering == Rendering::pathId && learn(b.knownPaths, pathId, forget)) {
+                definition = in_format(render, messages, format, Rendering::pathDefinition);
+                size += definition->payload().size();
+                if (forget) {
+                    reset = in_format(render, messages, format, Rendering::pathReset);
+                    size += reset->payload().size();
+                }
+            }
+            if (!b.pending.empty() && bytes && b.pending.size() + size > bytes)
+                flush(key, b, frames);
+            if (b.pending.empty()) {
+                // flushes whatever is pending then, unless it's flushed before
+                auto timer = std::make_shared<net::steady_timer>(ioc_, std::chrono::milliseconds(delay));
+                timer->async_wait(
+                    [this, key = key, epoch = b.epoch, timer](beast::error_code ec) {
+                        if (!ec)
+                            on_timer(key, epoch);
+                    });
+                b.pending.reserve(std::min<std::size_t>(bytes ? bytes : size, 65536));
+            }
+            if (reset)
+                b.pending += reset->payload();
+            if (definition) {
+                b.pending += definition->payload();
+                b.defines = true;
+            }
+            b.pending += ss->payload();
+            ++b.events;
+            ++batchedMessages_;
+            if ((events && b.events >= events) || (bytes && b.pending.size() >= bytes))
+                flush(key, b, frames);
+        }
     }
+}
 
-    // For each session in our local list, try to acquire a strong
-    // pointer. If successful, then send the message on that session.
-    for(auto const& wp : v) {
-        if(auto sp = wp.first.lock()) {
-            if (mask & wp.second) {
-                sp->send(ss);
-            } else {
-                messageProvider_->logFiltered(*ss, wp.second);
-            }
+// Takes what's pending for the sessions of the batch. Called with mutex_ locked
+void
+shared_state::
+flush(batch_key const& key, batch& b, std::vector<frame>& frames) const {
+    ++b.epoch;
+    if (b.pending.empty())
+        return;
+    auto format = std::get<WireFormat>(key);
+    frame f;
+    if (std::get<2>(key)) // compressed once for all the sessions
+        f.message = deflated(b.pending);
+    else
+        f.message = frame_message(b.pending, isBinary(format));
+    // the definitions are needed by the frames to come
+    f.events = b.defines ? 0 : b.events;
+    b.defines = false;
+    b.pending.clear(); // its buffer is kept for the next frame
+    b.events = 0;
+    for (auto const& p : sessions_)
+        if (p.second.sub.batch.enabled() && key_of(p.second.sub) == key)
+            f.sessions.push_back(p.second.weak);
+    ++batchFrames_;
+    frames.push_back(std::move(f));
+}
+
+void
+shared_state::
+on_timer(batch_key const& key, uint64_t epoch) const {
+    std::vector<frame> frames;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = batches_.find(key);
+        if (it == batches_.end() || it->second.epoch != epoch)
+            return;
+        flush(key, it->second, frames);
+    }
+    deliver(frames);
+}
+
+// A session leaves the batch of its subscription, what's pending is flushed
+// to all the sessions of the batch first. Called with mutex_ locked
+void
+shared_state::
+unbatch(subscription const& sub, std::vector<frame>& frames) {
+    if (!sub.batch.enabled())
+        return;
+    auto key = key_of(sub);
+    auto it = batches_.find(key);
+    if (it == batches_.end())
+        return;
+    flush(key, it->second, frames);
+    if (--it->second.subscribers == 0)
+        batches_.erase(it);
+}
+
+void
+shared_state::
+deliver(std::vector<frame> const& frames) {
+    for (auto const& f : frames)
+        for (auto const& wp : f.sessions)
+            if (auto sp = wp.lock())
+                sp->send(f.message, f.events);
+}
+
+void
+shared_state::
+sendRetained(MessageRenderer render, int mask) const {
+    if (retainFor_.count()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = std::chrono::steady_clock::now();
+        if (retained_.empty())
+            expire_retained_at(now + retainFor_);
+        if (retained_.size() < maxRetained) {
+            retained_.push_back({render, uint64_t(mask), {}, now});
+        } else if (!retainedOverflow_) {
+            retainedOverflow_ = true;
+            BOOST_LOG_TRIVIAL(warning) << "Too many retained messages, those beyond " << maxRetained
+                << " are only sent to the clients connected now";
         }
     }
+    send(render, mask, 0, {});
 }
 
+// Forgets the retained messages sent more than retainFor_ ago. Called with mutex_ locked
 void
 shared_state::
-subscribe(websocket_session* session, uint64_t mask) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    messageProvider_->logSubscribing(mask);
-    sessions_[session] = mask;
+expire_retained() const {
+    auto now = std::chrono::steady_clock::now();
+    auto expired = std::find_if(retained_.begin(), retained_.end(),
+        [&](retained const& r) { return now - r.at < retainFor_; });
+    retained_.erase(retained_.begin(), expired);
+    if (retained_.empty()) {
+        // all of them gone, so is their memory
+        std::vector<retained>().swap(retained_);
+        retainedOverflow_ = false;
+    }
+}
+
+// Expires the retained messages then, and so on till there's none left. Called with mutex_ locked
+void
+shared_state::
+expire_retained_at(std::chrono::steady_clock::time_point when) const {
+    auto timer = std::make_shared<net::steady_timer>(ioc_, when);
+    timer->async_wait(
+        [this, timer](beast::error_code ec) {
+            if (ec)
+                return;
+            std::lock_guard<std::mutex> lock(mutex_);
+            expire_retained();
+            if (!retained_.empty())
+                expire_retained_at(retained_.front().at + retainFor_);
+        });
+}
+
+bool
+shared_state::
+suspend(HandoffState &state) {
+    return messageProvider_->suspend(state);
+}
+
+void
+shared_state::
+resume() {
+    messageProvider_->resume();
+}
+
+// How many of the sessions connected now have what queued(), a few buckets of them whatever
+// their number, and the most one has. Called with mutex_ locked
+void
+shared_state::
+report_sessions(std::ostream& out, char const* name, std::vector<std::size_t> const& bounds,
+                std::size_t (websocket_session::*queued)() const) const {
+    std::vector<std::size_t> counts(bounds.size() + 1);
+    std::size_t sum = 0;
+    std::size_t max = 0;
+    for (auto const& p : sessions_) {
+        auto n = (p.first->*queued)();
+        ++counts[std::lower_bound(bounds.begin(), bounds.end(), n) - bounds.begin()];
+        sum += n;
+        max = std::max(max, n);
+    }
+    std::size_t below = 0;
+    for (std::size_t i = 0; i < bounds.size(); ++i) {
+        below += counts[i];
+        out << name << "_bucket{le=\"" << bounds[i] << "\"} " << below << "\n";
+    }
+    out << name << "_bucket{le=\"+Inf\"} " << sessions_.size() << "\n"
+        << name << "_sum " << sum << "\n"
+        << name << "_count " << sessions_.size() << "\n"
+        << "# HELP " << name << "_max The most queued for a client\n"
+        << "# TYPE " << name << "_max gauge\n"
+        << name << "_max " << max << "\n";
+}
+
+void
+shared_state::
+reportMetrics(std::ostream &out) const {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        out << "# HELP notibeast_sessions Connected websocket clients\n"
+            << "# TYPE notibeast_sessions gauge\n"
+            << "notibeast_sessions " << sessions_.size() << "\n"
+            << "# HELP notibeast_batch_frames_total Frames of batched subscriptions sent\n"
+            << "# TYPE notibeast_batch_frames_total counter\n"
+            << "notibeast_batch_frames_total " << batchFrames_ << "\n"
+            << "# HELP notibeast_batched_messages_total Messages packed into them\n"
+            << "# TYPE notibeast_batched_messages_total counter\n"
+            << "notibeast_batched_messages_total " << batchedMessages_ << "\n"
+            << "# HELP notibeast_session_queue_bytes Bytes queued for each client, not written yet\n"
+            << "# TYPE notibeast_session_queue_bytes histogram\n";
+        report_sessions(out, "notibeast_session_queue_bytes",
+            {4 << 10, 64 << 10, 1 << 20, 4 << 20, 16 << 20}, &websocket_session::queued_bytes);
+        out << "# HELP notibeast_session_queue_frames Frames queued for each client, not written yet\n"
+            << "# TYPE notibeast_session_queue_frames histogram\n";
+        report_sessions(out, "notibeast_session_queue_frames",
+            {1, 10, 100, 1000, 10000}, &websocket_session::queued_frames);
+    }
+    out << "# HELP notibeast_queue_bytes Bytes queued for all the clients\n"
+        << "# TYPE notibeast_queue_bytes gauge\n"
+        << "notibeast_queue_bytes " << budget_.queued << "\n"
+        << "# HELP notibeast_dropped_messages_total Messages dropped for clients too far behind\n"
+        << "# TYPE notibeast_dropped_messages_total counter\n"
+        << "notibeast_dropped_messages_total " << budget_.dropped << "\n"
+        << "# HELP notibeast_slow_disconnects_total Clients disconnected for being too far behind\n"
+        << "# TYPE notibeast_slow_disconnects_total counter\n"
+        << "notibeast_slow_disconnects_total " << budget_.disconnected << "\n";
+    out << "# HELP notibeast_filtered_total Messages a session didn't get, its mask doesn't match\n"
+        << "# TYPE notibeast_filtered_total counter\n"
+        << "notibeast_filtered_total " << filtered_ << "\n";
+    out << "# HELP notibeast_frame_buffers_total Message buffers allocated, they are pooled and reused\n"
+        << "# TYPE notibeast_frame_buffers_total counter\n"
+        << "notibeast_frame_buffers_total " << frame_buffer::made() << "\n";
+    out << "# HELP notibeast_deflate_in_bytes_total Bytes of compressed frames before compression\n"
+        << "# TYPE notibeast_deflate_in_bytes_total counter\n"
+        << "notibeast_deflate_in_bytes_total " << deflatedIn_ << "\n"
+        << "# HELP notibeast_deflate_out_bytes_total Bytes of compressed frames\n"
+        << "# TYPE notibeast_deflate_out_bytes_total counter\n"
+        << "notibeast_deflate_out_bytes_total " << deflatedOut_ << "\n";
+    messageProvider_->reportMetrics(out);
+}
+
+// With an admin token, whoever presents it, wherever from: loopback clients can be
+// anyone logged in to the host. Without one, loopback clients only
+bool
+shared_state::
+may_reload(bool loopback, std::string_view token) const {
+    if (adminToken_.empty())
+        return loopback;
+    // as long whatever the token, not to tell how much of it matched
+    unsigned char differ = token.size() != adminToken_.size();
+    for (std::size_t i = 0; i < adminToken_.size(); ++i)
+        differ |= adminToken_[i] ^ (i < token.size() ? token[i] : 0);
+    return !differ;
+}
+
+void
+shared_state::
+reload() {
+    // clients of several io threads and SIGHUP may ask for it at once
+    std::lock_guard<std::mutex> lock(reloadMutex_);
+    if (!loadOptions_) {
+        BOOST_LOG_TRIVIAL(warning) << "Nothing to reload, the service wasn't started with a config file";
+        return;
+    }
+    try {
+        auto options = loadOptions_();
+        BOOST_LOG_TRIVIAL(info) << "Reloaded options: '" << options << "'";
+        // the threads it starts for the new tree aren't to be stuck on the core of the io thread
+        UnpinnedScope unpinned;
+        if (!messageProvider_->reconfigure(options)) {
+            BOOST_LOG_TRIVIAL(warning) << "The message provider doesn't support reconfiguration";
+        }
+    } catch (std::exception const& e) {
+        BOOST_LOG_TRIVIAL(error) << "Reload failed: " << e.what();
+    }
+}
+
+void
+shared_state::
+subscribe(websocket_session* session, subscription sub) {
+    if (sub.batch.enabled() && lowLatency_) {
+        BOOST_LOG_TRIVIAL(info) << "Not batching in the low latency mode";
+        sub.batch = {};
+    }
+    std::vector<frame> frames;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        messageProvider_->logSubscribing(sub.mask);
+        auto &current = sessions_[session];
+        if (current.sub.mask == 0) {
+            // handed over before the session is published: whatever is sent to it
+            // from then on comes after
+            expire_retained();
+            for (auto &r : retained_)
+                if (sub.mask & r.mask) {
+                    auto ss = in_format(r.render, r.messages, sub.format, Rendering::full, projection_of(sub));
+                    if (sub.compress)
+                        session->send(deflated(ss->payload()), 1);
+                    else
+                        session->send(frame_message(ss->payload(), isBinary(sub.format)), 1);
+                }
+        }
+        unbatch(current.sub, frames);
+        if (sub.batch.enabled()) {
+            auto key = key_of(sub);
+            auto& b = batches_[key];
+            if (sub.pathIds) {
+                // the newcomer got none of the definitions so far, they're sent again
+                flush(key, b, frames);
+                b.knownPaths.clear();
+            }
+            ++b.subscribers;
+        }
+        current.sub = sub;
+        // a new subscription starts with no path ids
+        current.paths = sub.pathIds && !sub.batch.enabled() ? std::make_shared<known_paths>() : nullptr;
+        updateMetadata();
+        publish();
+    }
+    deliver(frames);
 }
@@ -11,33 +11,202 @@
 #ifndef NOTIFYING_STATE_HPP
 #define NOTIFYING_STATE_HPP
 
+#include <atomic>
+#include <chrono>
+#include <map>
 #include <mutex>
 #include <string>
+#include <tuple>
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
 #include <vector>
+#include <boost/smart_ptr.hpp>
+#include "net.hpp"
+#include "send_queue.hpp"
 #include "glue/message_provider_factory.h"
 
 class websocket_session;
 
+// Packs the messages of a subscription into frames, until one of the thresholds is hit
+struct batching {
+    std::size_t bytes = 0;               // a frame doesn't grow beyond, unless a message does
+    std::size_t events = 0;              // at most as many messages a frame
+    std::chrono::milliseconds delay{0};  // the first message of a frame waits at most that long
+    // a message a frame, as they come, without a delay
+    bool enabled() const { return delay.count() > 0; }
+};
+
+struct subscription {
+    uint64_t mask = 0;
+    unsigned metadata = 0; // MD_* bits
+    unsigned fields = EF_ALL; // EF_* bits
+    WireFormat format = WireFormat::json;
+    batching batch;
+    bool compress = false; // frames are binary, raw DEFLATE of what they'd be otherwise
+    bool pathIds = false;  // directories go as ids, see Rendering
+    queue_limits queue;    // how far behind the session may be
+    bool conflate = false; // a message waiting takes in the next one about the same file, unless batched
+};
+
 class shared_state: public MessageSender {
-    // This mutex synchronizes all access to sessions_
+    // Path ids a session with pathIds got the definition of, since its subscription
+    struct known_paths {
+        std::mutex mutex;
+        std::unordered_set<uint32_t> ids;
+    };
+
+    // A connected client as send() sees it. send() walks the sessions as they are, with no
+    // reference taken: a session leaving waits for the threads walking it, see walk()
+    struct subscriber {
+        websocket_session* session;
+        boost::weak_ptr<websocket_session> weak; // for the frames of its batch
+        subscription sub;
+        std::shared_ptr<known_paths> paths; // unless batched, the batch knows them then
+    };
+
+    // This mutex synchronizes all access to sessions_ and batches_
     mutable std::mutex mutex_;
 
     // Keep a list of all the connected clients and associated notification masks
-    std::unordered_map<websocket_session*, uint64_t> sessions_;
+    std::unordered_map<websocket_session*, subscriber> sessions_;
+
+    // The sessions grouped by mask, a message only visits the groups it matches
+    struct snapshot {
+        std::vector<uint64_t> masks;                 // a mask a group, side by side for a quick scan
+        std::vector<std::vector<subscriber>> groups; // in the same order
+        std::size_t sessions = 0;                    // subscribed or not
+    };
+
+    // The sessions send() walks, without taking mutex_: an immutable copy of sessions_,
+    // published anew on each join, leave and subscribe. Read and replaced with
+    // std::atomic_load() and std::atomic_store(), which lock a mutex of libstdc++'s,
+    // so senders keep a copy of their own till version_ changes, see walk()
+    std::shared_ptr<snapshot const> snapshot_ = std::make_shared<snapshot const>();
+    std::atomic<std::uint64_t> version_; // of snapshot_, growing across the shared_states
+
+    // Union of the metadata asked for by the sessions
+    unsigned metadata_ = 0;
+
+    struct rendering_key {
+        WireFormat format;
+        Rendering rendering;
+        Projection projection;
+    };
+
+    // A message as each distinct subscription gets it, a handful of them however many the sessions
+    using rendered = std::vector<std::pair<rendering_key, message_ptr>>;
+
+    struct retained {
+        MessageRenderer render;
+        uint64_t mask;
+        rendered messages; // on the first replay in a format
+        std::chrono::steady_clock::time_point at;
+    };
 
-    void send(std::string message, int mask) const override;
+    // Messages to be replayed to each session on its first subscription, for retainFor_
+    // after they were sent, oldest first
+    mutable std::vector<retained> retained_;
+    std::chrono::seconds retainFor_;
+    mutable bool retainedOverflow_ = false; // some weren't retained, it's been logged
+
+    net::io_context& ioc_;
+    bool lowLatency_;
+
+    // Sessions with the same mask, format, options, projection and thresholds share their frames
+    using batch_key = std::tuple<uint64_t, WireFormat, bool, bool, unsigned, unsigned,
+                                 std::size_t, std::size_t, std::chrono::milliseconds::rep>;
+
+    struct batch {
+        std::string pending;    // messages packed so far
+        std::size_t events = 0; // in pending
+        uint64_t epoch = 0;     // flushes so far, a timer of an earlier frame has nothing to do
+        std::size_t subscribers = 0;
+        std::unordered_set<uint32_t> knownPaths; // defined to all the sessions of the batch
+        bool defines = false;   // pending holds path definitions
+    };
+
+    struct frame {
+        frame_ptr message; // see frame_message()
+        std::size_t events = 0; // messages in it, 0 if it's not to be dropped
+        std::vector<boost::weak_ptr<websocket_session>> sessions;
+    };
+
+    mutable std::map<batch_key, batch> batches_;
+    mutable uint64_t batchFrames_ = 0;
+    mutable uint64_t batchedMessages_ = 0;
+    mutable std::atomic<uint64_t> deflatedIn_{0};
+    mutable std::atomic<uint64_t> deflatedOut_{0};
+    mutable std::atomic<uint64_t> filtered_{0}; // messages a session didn't get for its mask
+    queue_budget budget_;
+
+    static batch_key key_of(subscription const& sub);
+    void pack(MessageRenderer const& render, rendered& messages, int mask, uint32_t pathId,
+              std::vector<frame>& frames) const;
+    void flush(batch_key const& key, batch& b, std::vector<frame>& frames) const;
+    void on_timer(batch_key const& key, uint64_t epoch) const;
+    void unbatch(subscription const& sub, std::vector<frame>& frames);
+    static void deliver(std::vector<frame> const& frames);
+
+    void send(MessageRenderer const& render, int mask, uint32_t pathId, std::string_view name) const override;
+    void send(std::vector<OutgoingMessage> const& batch) const override;
+    template<class Deliver>
+    void fanout(MessageRenderer const& render, int mask, uint32_t pathId, std::string_view name,
+                snapshot const& subscribers, std::vector<frame>& packed, Deliver&& deliver) const;
+    void sendRetained(MessageRenderer render, int mask) const override;
+    void report_sessions(std::ostream& out, char const* name, std::vector<std::size_t> const& bounds,
+                         std::size_t (websocket_session::*queued)() const) const;
+    void expire_retained() const;
+    void expire_retained_at(std::chrono::steady_clock::time_point when) const;
+    void updateMetadata();
+    void publish();
+    snapshot const& walk() const;
+    void walked() const;
+    static message_ptr
+    in_format(MessageRenderer const& render, rendered& messages, WireFormat format,
+              Rendering rendering = Rendering::full, Projection const& projection = {});
+    static message_ptr
+    find(rendered const& messages, rendering_key const& key);
+    static Projection projection_of(subscription const& sub);
+    static bool learn(std::unordered_set<uint32_t>& known, uint32_t pathId, bool& reset);
+    message_ptr
+    deflated(std::string_view message) const;
 
     std::unique_ptr<MessageProvider> messageProvider_;
+    OptionsLoader loadOptions_;
+    std::string adminToken_; // --admin_token
+    std::mutex reloadMutex_;
 public:
-    explicit
-    shared_state(const MessageProviderFactory &factory);
+    // Batching windows are off in the low latency mode. Sessions queue
+    // at most queueBytes each, queueTotalBytes together. Clients presenting
+    // adminToken may ask for a reload
+    shared_state(net::io_context& ioc, const MessageProviderFactory &factory,
+                 OptionsLoader loadOptions = {}, bool lowLatency = false,
+                 std::size_t queueBytes = 4 << 20, std::size_t queueTotalBytes = 64 << 20,
+                 std::chrono::seconds retainFor = std::chrono::minutes(10),
+                 std::string adminToken = {});
     ~shared_state() override;
 
     void join(websocket_session* session);
     void leave(websocket_session* session);
-    void subscribe(websocket_session* session, uint64_t mask);
+    void subscribe(websocket_session* session, subscription sub);
+
+    // Shared by the send queues of the sessions
+    queue_budget& budget() { return budget_; }
+    queue_budget const& budget() const { return budget_; }
+
+    // see MessageProvider
+    bool suspend(HandoffState &state);
+    void resume();
+
+    // Re-reads the options and passes them to the message provider. On SIGHUP, or a
+    // 'reload' command of a client may_reload() lets do it: the config file is all
+    // it re-reads, clients have no say in what's in it
+    void reload();
+    bool may_reload(bool loopback, std::string_view token) const;
+
+    // Prometheus text format, served on GET /metrics
+    void reportMetrics(std::ostream &out) const;
 };
 
 #endif
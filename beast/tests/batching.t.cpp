@@ -0,0 +1,248 @@
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <signal.h>
+#include <unistd.h>
+#include "helper.h"
+#include "manual_service.h"
+
+#include "beast/service.hpp"
+
+using namespace std::this_thread; // sleep_for, sleep_until
+using namespace std::chrono; // nanoseconds, system_clock, seconds
+using namespace manual_service;
+
+SCENARIO("Batched subscriptions") {
+  GIVEN("A connected client") {
+    init_logging(boost::log::trivial::warning);
+
+    auto options = serviceOptions("8092");
+    std::thread service([&options]() {
+      runService(options, ManualFactory{});
+    });
+
+    net::io_context ioc;
+    websocket::stream<tcp::socket> ws{ioc};
+    connect(ws, options.port);
+
+    WHEN("Events come in for frames of 3 events, or 10 bytes") {
+      subscribe(ws, R"("batch": {"events": 3, "bytes": 10, "delay": 100})");
+      for (auto m: {"a\n", "b\n", "c\n", "d\n", "e\n", "f\n", "g\n", "012345678\n"}) {
+        send(m);
+      }
+      auto last = steady_clock::now();
+      send("h\n");
+
+      THEN("They're packed into frames until a threshold is hit") {
+        CHECK(readFrame(ws) == "a\nb\nc\n");
+        CHECK(readFrame(ws) == "d\ne\nf\n");
+        CHECK(readFrame(ws) == "g\n");          // another 10 bytes wouldn't fit
+        CHECK(readFrame(ws) == "012345678\n");  // 10 bytes
+        AND_THEN("What's left is sent after the delay") {
+          CHECK(readFrame(ws) == "h\n");
+          CHECK(steady_clock::now() - last >= milliseconds(100));
+        }
+      }
+    }
+
+    WHEN("Events come in compressed") {
+      subscribe(ws, R"("batch": {"events": 100, "delay": 10}, "compress": true)");
+      std::string batch;
+      for (int i = 0; i < 100; ++i) {
+        auto m = R"({"path":"photos/2023/summer","name":"IMG_)" + std::to_string(1000 + i) + R"(.jpg","mask":8,"cookie":0})" "\n";
+        batch += m;
+        send(m);
+      }
+
+      THEN("The frame is binary, a fraction of the size") {
+        beast::flat_buffer buffer;
+        ws.read(buffer);
+        CHECK(ws.got_binary());
+        auto frame = beast::buffers_to_string(buffer.data());
+        CHECK(frame.size() * 5 < batch.size());
+        CHECK(inflate(frame) == batch);
+      }
+    }
+
+    ws.close(websocket::close_code::normal);
+    kill(getpid(), SIGINT);
+    service.join();
+  }
+}
+
+SCENARIO("Directories as ids") {
+  GIVEN("A connected client") {
+    init_logging(boost::log::trivial::warning);
+
+    auto options = serviceOptions("8093");
+    std::thread service([&options]() {
+      runService(options, ManualFactory{});
+    });
+
+    net::io_context ioc;
+    websocket::stream<tcp::socket> ws{ioc};
+    connect(ws, options.port);
+
+    WHEN("It doesn't ask for path ids") {
+      subscribe(ws, R"("format": "json")");
+      sendInDir(1, "a", "x");
+
+      THEN("Paths are sent") {
+        CHECK(readFrame(ws) == "a/x\n");
+      }
+    }
+
+    WHEN("It asks for path ids") {
+      subscribe(ws, R"("pathIds": true)");
+      sendInDir(1, "a", "x");
+      sendInDir(1, "a", "y");
+      sendInDir(2, "b", "z");
+
+      THEN("An id is defined before the first event which has it") {
+        CHECK(readFrame(ws) == "1=a\n");
+        CHECK(readFrame(ws) == "1:x\n");
+        CHECK(readFrame(ws) == "1:y\n");
+        CHECK(readFrame(ws) == "2=b\n");
+        CHECK(readFrame(ws) == "2:z\n");
+        AND_THEN("Again after a new subscription") {
+          subscribe(ws, R"("pathIds": true)");
+          sendInDir(1, "a", "w");
+          CHECK(readFrame(ws) == "1=a\n");
+          CHECK(readFrame(ws) == "1:w\n");
+        }
+      }
+    }
+
+    WHEN("It asks for path ids, and messages come from several threads at once") {
+      subscribe(ws, R"("pathIds": true)");
+      constexpr int threads = 4;
+      constexpr int messages = 200;
+      std::vector<std::thread> senders;
+      for (int t = 0; t < threads; ++t) {
+        senders.emplace_back([t]() {
+          for (int i = 0; i < messages; ++i) {
+            auto pathId = static_cast<uint32_t>(t * 1000 + i % 50 + 1);
+            sendInDir(pathId, "d" + std::to_string(pathId), "f");
+          }
+        });
+      }
+      for (auto &sender : senders) {
+        sender.join();
+      }
+
+      THEN("Each id comes after its definition") {
+        std::unordered_set<std::string> defined;
+        int events = 0;
+        int undefined = 0;
+        while (events < threads * messages) {
+          auto frame = readFrame(ws);
+          if (frame == "reset\n") {
+            defined.clear();
+          } else if (auto eq = frame.find('='); eq != std::string::npos) {
+            defined.insert(frame.substr(0, eq));
+          } else {
+            ++events;
+            undefined += defined.count(frame.substr(0, frame.find(':'))) ? 0 : 1;
+          }
+        }
+        CHECK(undefined == 0);
+      }
+    }
+
+    WHEN("It asks for path ids in batches") {
+      subscribe(ws, R"("pathIds": true, "batch": {"events": 3, "delay": 100})");
+      sendInDir(1, "a", "x");
+      sendInDir(1, "a", "y");
+      sendInDir(2, "b", "z");
+
+      THEN("Definitions are packed along, they don't count as events") {
+        CHECK(readFrame(ws) == "1=a\n1:x\n1:y\n2=b\n2:z\n");
+      }
+    }
+
+    ws.close(websocket::close_code::normal);
+    kill(getpid(), SIGINT);
+    service.join();
+  }
+}
+
+SCENARIO("Projections") {
+  GIVEN("Three connected clients") {
+    init_logging(boost::log::trivial::warning);
+
+    auto options = serviceOptions("8094");
+    std::thread service([&options]() {
+      runService(options, ManualFactory{});
+    });
+
+    net::io_context ioc;
+    websocket::stream<tcp::socket> full{ioc}, names{ioc}, moreNames{ioc};
+    connect(full, options.port);
+    connect(names, options.port);
+    connect(moreNames, options.port);
+
+    WHEN("Two of them ask for names only") {
+      subscribe(full, R"("format": "json")");
+      subscribe(names, R"("fields": ["name"])");
+      subscribe(moreNames, R"("fields": ["name"])");
+      g_renders = 0;
+      sendProjected("a", "x");
+
+      THEN("Each gets the fields it asked for") {
+        CHECK(readFrame(full) == "a/x\n");
+        CHECK(readFrame(names) == "x\n");
+        CHECK(readFrame(moreNames) == "x\n");
+        AND_THEN("The message is rendered once per projection") {
+          CHECK(g_renders == 2);
+        }
+      }
+    }
+
+    for (auto ws: {&full, &names, &moreNames}) {
+      ws->close(websocket::close_code::normal);
+    }
+    kill(getpid(), SIGINT);
+    service.join();
+  }
+}
+
+SCENARIO("Subscription index") {
+  GIVEN("Clients subscribed to different events, and one not subscribed") {
+    init_logging(boost::log::trivial::warning);
+
+    auto options = serviceOptions("8095");
+    std::thread service([&options]() {
+      runService(options, ManualFactory{});
+    });
+
+    net::io_context ioc;
+    websocket::stream<tcp::socket> closeWrites{ioc}, accesses{ioc}, idle{ioc};
+    connect(closeWrites, options.port);
+    connect(accesses, options.port);
+    connect(idle, options.port);
+    subscribe(closeWrites, R"("format": "json")");
+    accesses.write(net::buffer(std::string(R"({"command": "subscribe", "mask": 1})")));
+    sleep_for(milliseconds(50));
+
+    WHEN("Each kind of event comes in") {
+      send("written\n");
+      g_sender.load()->send("accessed\n", IN_ACCESS);
+
+      THEN("Each client gets its own") {
+        CHECK(readFrame(closeWrites) == "written\n");
+        CHECK(readFrame(accesses) == "accessed\n");
+        AND_THEN("The others are counted") {
+          CHECK(getMetrics(options.port).find("notibeast_filtered_total 4\n") != std::string::npos);
+        }
+      }
+    }
+
+    for (auto ws: {&closeWrites, &accesses, &idle}) {
+      ws->close(websocket::close_code::normal);
+    }
+    kill(getpid(), SIGINT);
+    service.join();
+  }
+}
@@ -15,6 +15,7 @@
 #include "beast/service.hpp"
 
 #include <signal.h>
+#include <unistd.h>
 #include <boost/beast/core.hpp>
 #include <boost/beast/websocket.hpp>
 #include <boost/asio/connect.hpp>
@@ -40,8 +41,6 @@ std::mutex g_mtx;
 std::condition_variable g_cv;
 bool g_ready = false;
 
-bool isFilteredOut = false;
-
 class TestMessageProvider: public MessageProvider {
 public:
   TestMessageProvider(const MessageSender &messageSender) {
@@ -55,16 +54,6 @@ public:
     }).detach();
   }
 private:
-  void logFiltered( [[maybe_unused]] std::string const &ss, [[maybe_unused]] int filteringMask) const override {
-    std::string_view sv = ss;
-    if (!sv.empty() && *sv.rbegin() == '\n') {
-      sv.remove_suffix(1);
-    }
-    BOOST_LOG_TRIVIAL(debug) << "Message '" << sv << "' is filtered out by mask " << filteringMask << "";
-    if (ss == "Message 153, to be filtered out\n") {
-      isFilteredOut = true;
-    }
-  }
   void logSubscribing( [[maybe_unused]] int mask) const override {}
 };
 
@@ -142,19 +131,13 @@ SCENARIO("Testing network component") {
   GIVEN("Websocket is connected to the service") {
     init_logging(boost::log::trivial::warning);
 
-    Options options {
-      .address = "0.0.0.0",
-      .port = "8080",
-      .pathToMonitor = "",
-      .pathsToExclude = {},
-      .logSeverity = boost::log::trivial::severity_level::info
-    };
+    Options options{}; // on 0.0.0.0:8080
 
     BOOST_LOG_TRIVIAL(info) << "starting the service\n";
 
-    std::thread([&options](){
+    std::thread service([&options](){
       runService(options, TestFactory{options});
-    }).detach();
+    });
 
     net::io_context ioc;
     websocket::stream<tcp::socket> ws{ioc};
@@ -178,17 +161,16 @@ SCENARIO("Testing network component") {
       THEN("We receive the expected message from the service") {
         BOOST_LOG_TRIVIAL(info) << "Reading a line from the websocket...";
         std::string receivedMessage = readLine(ws);
-        REQUIRE(receivedMessage == "Message 42"); // note the absence of the terminating EOL
-        REQUIRE(isFilteredOut);
+        REQUIRE(receivedMessage == "Message 42"); // note the absence of the terminating EOL, 153 is filtered out
       }
     }
 
     BOOST_LOG_TRIVIAL(info) << "closing the websocket\n";
     ws.close(websocket::close_code::normal);
 
-    //This mostly works...
-    //BOOST_LOG_TRIVIAL(info) << "Sending SIGNINT signal\n";
-    //kill(getpid(), SIGINT);
+    // stopped, the scenarios of the other files start services of their own
+    kill(getpid(), SIGINT);
+    service.join();
   }
 }
 
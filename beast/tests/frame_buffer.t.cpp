@@ -0,0 +1,116 @@
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "beast/frame_buffer.hpp"
+
+namespace {
+// header and payload, as they're written
+std::string bytesOf(frame_buffer const &frame) {
+  std::string res;
+  for (auto const &b: frame.buffers()) {
+    res.append(static_cast<char const *>(b.data()), b.size());
+  }
+  return res;
+}
+
+// rendered the way the sessions get them, then let go of
+std::vector<message_ptr> render(int count) {
+  std::vector<message_ptr> res;
+  for (int i = 0; i < count; ++i) {
+    res.push_back(frame_buffer::make());
+    res.back()->payload() = "message " + std::to_string(i) + std::string(100, ' ');
+    res.back()->frame(false);
+  }
+  return res;
+}
+} //namespace
+
+SCENARIO("Frame buffers") {
+  GIVEN("Messages rendered into buffers") {
+    WHEN("They're framed") {
+      auto text = frame_message("short", false);
+      auto longer = frame_message(std::string(300, 'x'), false);
+      auto binary = frame_message(std::string(70000, '\xff'), true);
+
+      THEN("The header goes in front of the payload") {
+        CHECK(bytesOf(*text) == std::string("\x81\x05short"));
+        CHECK(bytesOf(*longer) == std::string("\x81\x7e\x01\x2c", 4) + std::string(300, 'x'));
+        CHECK(bytesOf(*binary) == std::string("\x82\x7f\0\0\0\0\0\x01\x11\x70", 10) + std::string(70000, '\xff'));
+        CHECK(binary->size() == 70010);
+      }
+    }
+
+    WHEN("They're let go of on the thread which made them") {
+      render(100);
+      auto made = frame_buffer::made();
+      auto again = render(100);
+
+      THEN("Their buffers are taken again, as they were") {
+        CHECK(frame_buffer::made() == made);
+        for (auto &message: again) {
+          CHECK(message->payload().capacity() >= 100);
+        }
+        again.clear();
+        auto fresh = frame_buffer::make();
+        CHECK(fresh->payload().empty());
+        CHECK(fresh->size() == 0);
+      }
+    }
+
+    WHEN("They're let go of on other threads, the way sessions do") {
+      auto made = frame_buffer::made();
+      for (int round = 0; round < 10; ++round) {
+        auto frames = render(100);
+        std::thread session([frames = std::move(frames)]() mutable {
+          frames.clear();
+        });
+        session.join();
+      }
+
+      THEN("They go back to the pool of the thread which made them") {
+        CHECK(frame_buffer::made() - made <= 100);
+      }
+    }
+
+    WHEN("Large ones are let go of") {
+      auto large = [](int count) {
+        std::vector<message_ptr> res;
+        for (int i = 0; i < count; ++i) {
+          res.push_back(frame_buffer::make());
+          res.back()->payload().assign(60000, 'x');
+        }
+        return res;
+      };
+      // on a thread of its own, the pool of this one holds whatever the tests before left
+      std::uint64_t made = 0;
+      std::thread([&large, &made]() {
+        large(200);
+        made = frame_buffer::made();
+        large(200);
+        made = frame_buffer::made() - made;
+      }).join();
+
+      THEN("The pool keeps a few MiB of them, not all") {
+        CHECK(made >= 100);
+        CHECK(made < 200);
+      }
+    }
+
+    WHEN("The thread which made them is gone") {
+      std::vector<frame_ptr> frames;
+      std::thread maker([&frames]() {
+        for (auto &message: render(10)) {
+          frames.push_back(message);
+        }
+      });
+      maker.join();
+
+      THEN("They're still there, till they're let go of") {
+        CHECK(frames.back()->payload() == "message 9" + std::string(100, ' '));
+        frames.clear();
+      }
+    }
+  }
+}
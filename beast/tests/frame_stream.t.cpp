@@ -0,0 +1,212 @@
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "beast/frame_stream.hpp"
+
+#include <boost/beast/_experimental/test/stream.hpp>
+
+namespace {
+using test_stream = beast::test::stream;
+
+// What a client sends to open a websocket
+constexpr char upgrade[] =
+  "GET / HTTP/1.1\r\n"
+  "Host: localhost\r\n"
+  "Upgrade: websocket\r\n"
+  "Connection: upgrade\r\n"
+  "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+  "Sec-WebSocket-Version: 13\r\n"
+  "\r\n";
+
+// The server side of a session and a client, connected
+struct connection {
+  websocket::stream<frame_stream<test_stream>> server;
+  test_stream client;
+
+  explicit connection(net::io_context &ioc): server{ioc}, client{ioc} {
+    server.next_layer().next_layer().connect(client);
+    server.next_layer().next_layer().append(upgrade);
+    server.accept();
+    client.clear(); // the handshake response
+  }
+};
+
+// ns per message and session
+template <class Write>
+double nsPerWrite(net::io_context &ioc, std::vector<std::unique_ptr<connection>> &connections, Write &&write) {
+  constexpr int rounds = 10;
+  size_t written = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds; ++round) {
+    for (auto &c: connections) {
+      write(c->server, [&written](beast::error_code ec, std::size_t n) {
+        if (!ec) {
+          written += n;
+        }
+      });
+    }
+    ioc.run();
+    ioc.restart();
+    for (auto &c: connections) {
+      c->client.clear();
+    }
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  REQUIRE(written > 0);
+  return elapsed.count() / (rounds * connections.size());
+}
+} //namespace
+
+SCENARIO("Frames built once") {
+  GIVEN("A session and a client") {
+    net::io_context ioc;
+    websocket::stream<frame_stream<test_stream>> server{ioc};
+    websocket::stream<test_stream> client{ioc};
+    server.next_layer().next_layer().connect(client.next_layer());
+    server.async_accept([](beast::error_code ec) { REQUIRE_FALSE(ec); });
+    client.async_handshake("localhost", "/", [](beast::error_code ec) { REQUIRE_FALSE(ec); });
+    ioc.run();
+    ioc.restart();
+
+    auto read = [&client]() {
+      beast::flat_buffer buffer;
+      client.read(buffer);
+      return beast::buffers_to_string(buffer.data());
+    };
+
+    WHEN("Frames of every length are written as they are") {
+      std::vector<std::pair<std::string, bool>> messages{
+        {"short", false}, {std::string(300, 'x'), false}, {std::string(70000, '\xff'), true}};
+      for (auto &[payload, binary]: messages) {
+        auto frame = frame_message(payload, binary);
+        server.next_layer().async_write_frame(*frame, [frame](beast::error_code ec, std::size_t n) {
+          REQUIRE_FALSE(ec);
+          CHECK(n == frame->size());
+        });
+        ioc.run();
+        ioc.restart();
+      }
+
+      THEN("The client reads them as websocket messages") {
+        for (auto &[payload, binary]: messages) {
+          CHECK(read() == payload);
+          CHECK(client.got_binary() == binary);
+        }
+      }
+    }
+
+    WHEN("Frames are written together, in a single gathered write") {
+      std::vector<std::string> payloads{"first", std::string(300, 'x'), "last"};
+      std::vector<frame_ptr> frames;
+      std::vector<net::const_buffer> buffers;
+      for (auto &payload: payloads) {
+        frames.push_back(frame_message(payload, false));
+        for (auto const &b: frames.back()->buffers()) {
+          buffers.push_back(b);
+        }
+      }
+      // a few bytes at a time, the ping comes in the middle of them
+      server.next_layer().next_layer().write_size(7);
+      beast::flat_buffer serverBuffer;
+      server.async_read(serverBuffer, [](beast::error_code, std::size_t) {});
+      bool written = false;
+      server.next_layer().async_write_frames(buffers, [&](beast::error_code ec, std::size_t n) {
+        REQUIRE_FALSE(ec);
+        CHECK(n == frames[0]->size() + frames[1]->size() + frames[2]->size());
+        written = true;
+      });
+      client.async_ping({}, [](beast::error_code ec) { REQUIRE_FALSE(ec); });
+      while (!written) {
+        ioc.run_one();
+      }
+      ioc.poll();
+
+      THEN("The client reads them one after the other, the pong after them") {
+        bool pong = false;
+        client.control_callback([&](websocket::frame_type kind, beast::string_view) {
+          pong = pong || kind == websocket::frame_type::pong;
+        });
+        for (auto &payload: payloads) {
+          CHECK(read() == payload);
+          CHECK_FALSE(pong);
+        }
+        server.next_layer().async_write_frame(*frames[0], [](beast::error_code ec, std::size_t) {
+          REQUIRE_FALSE(ec);
+        });
+        ioc.poll();
+        CHECK(read() == payloads[0]);
+        CHECK(pong);
+      }
+    }
+
+    WHEN("The session answers a ping in the middle of a frame") {
+      // a few bytes at a time, the pong comes while the frame is being written
+      server.next_layer().next_layer().write_size(7);
+      std::string payload(1000, 'y');
+      auto frame = frame_message(payload, false);
+      beast::flat_buffer serverBuffer;
+      server.async_read(serverBuffer, [](beast::error_code, std::size_t) {});
+      bool written = false;
+      server.next_layer().async_write_frame(*frame, [&written](beast::error_code ec, std::size_t) {
+        REQUIRE_FALSE(ec);
+        written = true;
+      });
+      client.async_ping({}, [](beast::error_code ec) { REQUIRE_FALSE(ec); });
+      while (!written) {
+        ioc.run_one();
+      }
+      ioc.poll();
+
+      THEN("The pong goes after the frame") {
+        bool pong = false;
+        client.control_callback([&pong](websocket::frame_type kind, beast::string_view) {
+          pong = pong || kind == websocket::frame_type::pong;
+        });
+        CHECK(read() == payload);
+        server.next_layer().async_write_frame(*frame, [](beast::error_code ec, std::size_t) {
+          REQUIRE_FALSE(ec);
+        });
+        ioc.poll();
+        CHECK(read() == payload);
+        CHECK(pong);
+      }
+    }
+  }
+}
+
+TEST_CASE("Framing", "[.][benchmark]") {
+  net::io_context ioc;
+  std::vector<std::unique_ptr<connection>> connections;
+  for (int i = 0; i < 10000; ++i) {
+    connections.push_back(std::make_unique<connection>(ioc));
+  }
+  std::string message = R"({"path":"photos/2023/summer","name":"IMG_1000.jpg","mask":8,"cookie":0})" "\n";
+
+  auto viaWebsocket = nsPerWrite(ioc, connections, [&message](auto &ws, auto handler) {
+    ws.text(true);
+    ws.async_write(net::buffer(message), handler);
+  });
+  auto frame = frame_message(message, false);
+  auto prebuilt = nsPerWrite(ioc, connections, [&frame](auto &ws, auto handler) {
+    ws.next_layer().async_write_frame(*frame, handler);
+  });
+  // frames queued meanwhile go out together
+  constexpr int gathered = 16;
+  std::vector<net::const_buffer> frames;
+  for (int i = 0; i < gathered; ++i) {
+    auto buffers = frame->buffers();
+    frames.insert(frames.end(), buffers.begin(), buffers.end());
+  }
+  auto together = nsPerWrite(ioc, connections, [&frames](auto &ws, auto handler) {
+    ws.next_layer().async_write_frames(frames, handler);
+  }) / gathered;
+  std::cout << connections.size() << " sessions, websocket stream: " << viaWebsocket << " ns/message/session, "
+            << "frames built once: " << prebuilt << " ns/message/session, "
+            << gathered << " frames a write: " << together << " ns/message/session\n";
+  CHECK(prebuilt < viaWebsocket);
+  CHECK(together < prebuilt);
+}
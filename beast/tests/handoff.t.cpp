@@ -0,0 +1,56 @@
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <thread>
+#include <signal.h>
+#include <unistd.h>
+#include "helper.h"
+#include "manual_service.h"
+
+#include "beast/service.hpp"
+
+#include <boost/asio/local/stream_protocol.hpp>
+
+using namespace std::this_thread; // sleep_for, sleep_until
+using namespace std::chrono; // nanoseconds, system_clock, seconds
+using namespace manual_service;
+
+SCENARIO("Handing over to a successor") {
+  GIVEN("A client, and a successor which connected but doesn't go on") {
+    init_logging(boost::log::trivial::fatal);
+
+    auto options = serviceOptions("8081");
+    options.handoffSocket = (createTempDir("test_handoff_")/"handoff.sock").string();
+    std::thread service([&options]() {
+      runService(options, ManualFactory{});
+    });
+
+    net::io_context ioc;
+    websocket::stream<tcp::socket> ws{ioc};
+    connect(ws, options.port);
+    subscribe(ws, R"("format": "json")");
+    net::local::stream_protocol::socket successor{ioc};
+    successor.connect(net::local::stream_protocol::endpoint(options.handoffSocket));
+    sleep_for(milliseconds(100));
+
+    WHEN("A message comes in meanwhile") {
+      auto start = steady_clock::now();
+      send("live\n");
+      auto frame = readFrame(ws);
+      auto elapsed = steady_clock::now() - start;
+
+      THEN("The client gets it without waiting for the handover") {
+        CHECK(frame == "live\n");
+        CHECK(elapsed < seconds(1));
+      }
+    }
+
+    // the handover fails, and the service carries on
+    successor.close();
+    sleep_for(milliseconds(100));
+    send("still there\n");
+    CHECK(readFrame(ws) == "still there\n");
+    ws.close(websocket::close_code::normal);
+    kill(getpid(), SIGINT);
+    service.join();
+  }
+}
@@ -0,0 +1,132 @@
+#include "recursive_i_notify.h"
+#include "recursive_notify_event.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <signal.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include "helper.h"
+
+#include "glue/options.h"
+#include "beast/service.hpp"
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+
+using namespace std::this_thread; // sleep_for, sleep_until
+using namespace std::chrono; // nanoseconds, system_clock, seconds
+
+namespace {
+namespace beast = boost::beast;
+namespace websocket = beast::websocket;
+namespace net = boost::asio;
+using tcp = boost::asio::ip::tcp;
+
+class BenchmarkFactory: public MessageProviderFactory {
+public:
+  explicit BenchmarkFactory(Options options): options{std::move(options)} {}
+
+  std::unique_ptr<MessageProvider> makeMessageProvider(const MessageSender &messageSender) const override {
+    return std::make_unique<RecursiveINotify>(
+      [&messageSender](RecursiveNotifyEvent const &rne) {
+        messageSender.send(rne.name + "\n", rne.mask);
+      },
+      options.pathToMonitor,
+      options.pathsToExclude,
+      fs::path{},
+      std::chrono::seconds{},
+      HandoffState{},
+      std::vector<EventScheduler::Class>{},
+      ReaderOptions{.cpu = options.inotifyCpu, .busyPoll = options.lowLatency}
+    );
+  }
+private:
+  Options options;
+};
+
+void connect(websocket::stream<tcp::socket> &ws, std::string const &port) {
+  tcp::resolver resolver{ws.get_executor()};
+  auto const results = resolver.resolve("localhost", port);
+  for(int i=1; i<=10; ++i) {
+    boost::system::error_code ec;
+    net::connect(ws.next_layer(), results, ec);
+    if (!ec) {
+      ws.next_layer().set_option(tcp::no_delay(true));
+      ws.handshake("localhost:" + port, "/");
+      return;
+    }
+    sleep_for(milliseconds(i*i*10));
+  }
+  throw std::runtime_error("Failed to establish connection");
+}
+
+// File write to client receipt, in microseconds
+std::vector<double> measure(Options const &options, int iterations) {
+  std::thread service([&options]() {
+    runService(options, BenchmarkFactory{options});
+  });
+
+  net::io_context ioc;
+  websocket::stream<tcp::socket> ws{ioc};
+  connect(ws, options.port);
+  ws.write(net::buffer("{\"command\": \"subscribe\", \"mask\": " + std::to_string(IN_CLOSE_WRITE) + "}"));
+  sleep_for(milliseconds(10));
+
+  std::vector<double> latencies;
+  latencies.reserve(iterations);
+  beast::flat_buffer buffer;
+  auto file = fs::path(options.pathToMonitor) / "foo";
+  for (int i = 0; i < iterations; ++i) {
+    auto start = steady_clock::now();
+    {std::ofstream(file) << i;}
+    ws.read(buffer);
+    latencies.push_back(duration<double, std::micro>(steady_clock::now() - start).count());
+    buffer.consume(buffer.size());
+  }
+
+  ws.close(websocket::close_code::normal);
+  kill(getpid(), SIGINT);
+  service.join();
+  return latencies;
+}
+
+void report(std::string const &mode, std::vector<double> latencies) {
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&latencies](double p) {
+    return latencies[std::min(latencies.size() - 1, size_t(p * latencies.size()))];
+  };
+  std::cout << mode << ": p50 " << percentile(0.5)
+            << " us, p99 " << percentile(0.99)
+            << " us, p999 " << percentile(0.999) << " us\n";
+}
+} //namespace
+
+// test/tests "[benchmark]"
+TEST_CASE("Latency from a file write to the client", "[.][benchmark]") {
+  init_logging(boost::log::trivial::warning);
+  auto ph = createTempDir("bench_latency_");
+  constexpr int iterations = 20000;
+
+  Options options{};
+  options.address = "127.0.0.1";
+  options.port = "8091";
+  options.pathToMonitor = ph.string();
+  report("default", measure(options, iterations));
+
+  options.lowLatency = true;
+  if (std::thread::hardware_concurrency() >= 3) {
+    options.inotifyCpu = 1;
+    options.ioCpu = 2;
+  }
+  report("low latency", measure(options, iterations));
+
+  fs::remove_all(ph);
+}
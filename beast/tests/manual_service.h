@@ -0,0 +1,155 @@
+#ifndef MANUAL_SERVICE_H
+#define MANUAL_SERVICE_H
+
+// The service with a message provider the test sends the messages of, and a client's
+// side of it, for the scenarios of the beast tests
+
+#include <catch2/catch_test_macros.hpp>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <sys/inotify.h>
+
+#include "glue/options.h"
+#include "glue/message_provider_factory.h"
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/beast/zlib/inflate_stream.hpp>
+#include <boost/json.hpp>
+
+namespace manual_service {
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace websocket = beast::websocket;
+namespace net = boost::asio;
+namespace js = boost::json;
+using tcp = boost::asio::ip::tcp;
+
+inline std::atomic<MessageSender const *> g_sender{nullptr};
+
+// Sends whatever the test tells it to
+class ManualMessageProvider: public MessageProvider {
+public:
+  explicit ManualMessageProvider(MessageSender const &messageSender) {
+    g_sender = &messageSender;
+  }
+  ~ManualMessageProvider() override {
+    g_sender = nullptr;
+  }
+  // Hands nothing over, for a handover to get as far as waiting for the successor
+  bool suspend([[maybe_unused]] HandoffState &state) override { return true; }
+private:
+  void logSubscribing([[maybe_unused]] int mask) const override {}
+};
+
+class ManualFactory: public MessageProviderFactory {
+public:
+  std::unique_ptr<MessageProvider> makeMessageProvider(const MessageSender &messageSender) const override {
+    return std::make_unique<ManualMessageProvider>(messageSender);
+  }
+};
+
+inline void connect(websocket::stream<tcp::socket> &ws, std::string const &port) {
+  tcp::resolver resolver{ws.get_executor()};
+  auto const results = resolver.resolve("localhost", port);
+  for(int i=1; i<=10; ++i) {
+    boost::system::error_code ec;
+    net::connect(ws.next_layer(), results, ec);
+    if (!ec) {
+      ws.handshake("localhost:" + port, "/");
+      return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(i*i*10));
+  }
+  throw std::runtime_error("Failed to establish connection");
+}
+
+inline std::string readFrame(websocket::stream<tcp::socket> &ws) {
+  beast::flat_buffer buffer;
+  ws.read(buffer);
+  return beast::buffers_to_string(buffer.data());
+}
+
+inline void subscribe(websocket::stream<tcp::socket> &ws, std::string const &extra) {
+  ws.write(net::buffer(R"({"command": "subscribe", "mask": 8, )" + extra + "}"));
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  REQUIRE(g_sender.load());
+}
+
+inline std::string getMetrics(std::string const &port) {
+  net::io_context ioc;
+  tcp::socket socket{ioc};
+  tcp::resolver resolver{ioc};
+  net::connect(socket, resolver.resolve("localhost", port));
+  http::request<http::empty_body> req{http::verb::get, "/metrics", 11};
+  req.set(http::field::host, "localhost");
+  http::write(socket, req);
+  beast::flat_buffer buffer;
+  http::response<http::string_body> res;
+  http::read(socket, buffer, res);
+  return res.body();
+}
+
+inline std::string inflate(std::string const &in) {
+  beast::zlib::inflate_stream is;
+  std::string out(1 << 20, '\0');
+  beast::zlib::z_params zs;
+  zs.next_in = in.data();
+  zs.avail_in = in.size();
+  zs.next_out = &out[0];
+  zs.avail_out = out.size();
+  beast::error_code ec;
+  is.write(zs, beast::zlib::Flush::finish, ec);
+  out.resize(zs.total_out);
+  return out;
+}
+
+inline void send(std::string const &message) {
+  g_sender.load()->send(message, IN_CLOSE_WRITE);
+}
+
+// x/y, 1:y with the id of x, 1=x to define it
+inline void sendInDir(uint32_t pathId, std::string const &path, std::string const &name) {
+  g_sender.load()->send([&](std::string &out, WireFormat, Rendering rendering, Projection const &) {
+    switch (rendering) {
+      case Rendering::full: out = path + "/" + name + "\n"; break;
+      case Rendering::pathId: out = std::to_string(pathId) + ":" + name + "\n"; break;
+      case Rendering::pathDefinition: out = std::to_string(pathId) + "=" + path + "\n"; break;
+      case Rendering::pathReset: out = "reset\n"; break;
+    }
+  }, IN_CLOSE_WRITE, pathId, name);
+}
+
+// x/y, or just y without EF_PATH
+inline std::atomic<int> g_renders{0};
+inline void sendProjected(std::string const &path, std::string const &name) {
+  g_sender.load()->send([&](std::string &out, WireFormat, Rendering, Projection const &projection) {
+    ++g_renders;
+    out = (projection.fields & EF_PATH ? path + "/" : "") + name + "\n";
+  }, IN_CLOSE_WRITE, 0, name);
+}
+
+// name mask padding, with the mask of the messages conflated
+inline void sendAbout(std::string const &name, int mask, std::string const &padding) {
+  g_sender.load()->send([&](std::string &out, WireFormat, Rendering, Projection const &projection) {
+    out = name + " " + std::to_string(projection.mask ? projection.mask : mask) + " " + padding + "\n";
+  }, mask, 1, name);
+}
+
+// On loopback, with the defaults of the command line otherwise
+inline Options serviceOptions(std::string port) {
+  Options options{};
+  options.address = "127.0.0.1";
+  options.port = std::move(port);
+  return options;
+}
+} //namespace manual_service
+
+#endif
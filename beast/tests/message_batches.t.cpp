@@ -0,0 +1,78 @@
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+#include <signal.h>
+#include <unistd.h>
+#include "helper.h"
+#include "manual_service.h"
+
+#include "beast/service.hpp"
+
+using namespace std::this_thread; // sleep_for, sleep_until
+using namespace std::chrono; // nanoseconds, system_clock, seconds
+using namespace manual_service;
+
+SCENARIO("Batches of messages") {
+  GIVEN("Clients with and without path ids") {
+    init_logging(boost::log::trivial::warning);
+
+    auto options = serviceOptions("8098");
+    std::thread service([&options]() {
+      runService(options, ManualFactory{});
+    });
+
+    net::io_context ioc;
+    websocket::stream<tcp::socket> paths{ioc};
+    websocket::stream<tcp::socket> ids{ioc};
+    connect(paths, options.port);
+    connect(ids, options.port);
+    subscribe(paths, R"("format": "json")");
+    subscribe(ids, R"("pathIds": true)");
+
+    // x/y, 1:y with the id of x, 1=x to define it, as sendInDir() does
+    std::vector<std::string> names{"x", "y", "z"};
+    auto inDir = [](uint32_t pathId, std::string path, std::string const &name) {
+      return OutgoingMessage{[=](std::string &out, WireFormat, Rendering rendering, Projection const &) {
+        switch (rendering) {
+          case Rendering::full: out = path + "/" + name + "\n"; break;
+          case Rendering::pathId: out = std::to_string(pathId) + ":" + name + "\n"; break;
+          case Rendering::pathDefinition: out = std::to_string(pathId) + "=" + path + "\n"; break;
+          case Rendering::pathReset: out = "reset\n"; break;
+        }
+      }, IN_CLOSE_WRITE, pathId, name};
+    };
+
+    WHEN("A batch comes in between single messages") {
+      sendInDir(1, "a", "w");
+      g_sender.load()->send(std::vector<OutgoingMessage>{
+        inDir(1, "a", names[0]),
+        inDir(2, "b", names[1]),
+        {[](std::string &out, WireFormat, Rendering, Projection const &) { out = "ignored\n"; }, IN_DELETE, 0, {}},
+        inDir(2, "b", names[2])
+      });
+      sendInDir(2, "b", "v");
+
+      THEN("Each client gets its messages of it, in order") {
+        CHECK(readFrame(paths) == "a/w\n");
+        CHECK(readFrame(paths) == "a/x\n");
+        CHECK(readFrame(paths) == "b/y\n");
+        CHECK(readFrame(paths) == "b/z\n");
+        CHECK(readFrame(paths) == "b/v\n");
+
+        CHECK(readFrame(ids) == "1=a\n");
+        CHECK(readFrame(ids) == "1:w\n");
+        CHECK(readFrame(ids) == "1:x\n");
+        CHECK(readFrame(ids) == "2=b\n");
+        CHECK(readFrame(ids) == "2:y\n");
+        CHECK(readFrame(ids) == "2:z\n");
+        CHECK(readFrame(ids) == "2:v\n");
+      }
+    }
+
+    paths.close(websocket::close_code::normal);
+    ids.close(websocket::close_code::normal);
+    kill(getpid(), SIGINT);
+    service.join();
+  }
+}
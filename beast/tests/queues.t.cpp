@@ -0,0 +1,121 @@
+#include <catch2/catch_test_macros.hpp>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <signal.h>
+#include <unistd.h>
+#include "helper.h"
+#include "manual_service.h"
+
+#include "beast/service.hpp"
+
+using namespace std::this_thread; // sleep_for, sleep_until
+using namespace std::chrono; // nanoseconds, system_clock, seconds
+using namespace manual_service;
+
+SCENARIO("Slow clients") {
+  GIVEN("A client which doesn't read for a while") {
+    init_logging(boost::log::trivial::error);
+
+    auto options = serviceOptions("8096");
+    std::thread service([&options]() {
+      runService(options, ManualFactory{});
+    });
+
+    net::io_context ioc;
+    websocket::stream<tcp::socket> ws{ioc};
+    connect(ws, options.port);
+    // well beyond what the socket buffers take
+    constexpr int messages = 300;
+    std::string message(100000, 'x');
+    message += '\n';
+
+    WHEN("It drops the oldest messages beyond 1MB") {
+      subscribe(ws, R"("queue": {"policy": "dropOldest", "bytes": 1000000})");
+      for (int i = 0; i < messages; ++i) {
+        send(message);
+      }
+      send("last\n");
+      auto metrics = getMetrics(options.port);
+
+      THEN("It's told how many it missed in between") {
+        int received = 0;
+        std::size_t missed = 0;
+        for (auto frame = readFrame(ws); frame != "last\n"; frame = readFrame(ws)) {
+          if (frame == message) {
+            ++received;
+          } else {
+            auto gap = js::parse(js::string_view(frame)).as_object().at("gap").to_number<std::size_t>();
+            CHECK(gap > 0);
+            missed += gap;
+          }
+        }
+        CHECK(missed > 0);
+        CHECK(received + missed == messages);
+        AND_THEN("The metrics tell how far behind clients are, not who they are") {
+          CHECK(metrics.find("notibeast_session_queue_bytes_count 1\n") != std::string::npos);
+          CHECK(metrics.find("notibeast_session_queue_bytes_bucket{le=\"+Inf\"} 1\n") != std::string::npos);
+          CHECK(metrics.find("client=") == std::string::npos);
+        }
+      }
+    }
+
+    WHEN("It conflates messages about the same file") {
+      subscribe(ws, R"("conflate": true)");
+      std::string padding(100000, 'x');
+      std::vector<std::string> names{"a", "b", "c"};
+      for (int i = 0; i < messages; ++i) {
+        sendAbout(names[i % names.size()], IN_CLOSE_WRITE | (i < 3 ? IN_CREATE : IN_MODIFY), padding);
+      }
+      send("last\n");
+
+      THEN("It gets fewer of them, with the masks of those it missed") {
+        int received = 0;
+        std::map<std::string, int> masks;
+        for (auto frame = readFrame(ws); frame != "last\n"; frame = readFrame(ws)) {
+          std::istringstream is(frame);
+          std::string name;
+          int mask = 0;
+          REQUIRE(is >> name >> mask);
+          masks[name] |= mask;
+          ++received;
+        }
+        CHECK(received < messages);
+        for (auto &name : names) {
+          CHECK(masks[name] == (IN_CLOSE_WRITE | IN_CREATE | IN_MODIFY));
+        }
+      }
+    }
+
+    WHEN("It's disconnected beyond 1MB") {
+      subscribe(ws, R"("queue": {"policy": "disconnect", "bytes": 1000000})");
+      for (int i = 0; i < messages; ++i) {
+        send(message);
+      }
+      send("last\n");
+
+      THEN("It gets what was written, not the rest") {
+        beast::error_code ec;
+        beast::flat_buffer buffer;
+        int received = 0;
+        while (!ec) {
+          buffer.clear();
+          ws.read(buffer, ec);
+          if (!ec) {
+            CHECK(beast::buffers_to_string(buffer.data()) == message);
+            ++received;
+          }
+        }
+        CHECK(received < messages);
+      }
+    }
+
+    if (ws.is_open()) {
+      ws.close(websocket::close_code::normal);
+    }
+    kill(getpid(), SIGINT);
+    service.join();
+  }
+}
@@ -0,0 +1,52 @@
+#include <catch2/catch_test_macros.hpp>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <signal.h>
+#include <unistd.h>
+#include "helper.h"
+#include "manual_service.h"
+
+#include "beast/service.hpp"
+
+using namespace std::this_thread; // sleep_for, sleep_until
+using namespace std::chrono; // nanoseconds, system_clock, seconds
+using namespace manual_service;
+
+SCENARIO("Reloading on a client's command") {
+  GIVEN("A service with an admin token, and a client") {
+    init_logging(boost::log::trivial::fatal);
+
+    auto options = serviceOptions("8082");
+    options.adminToken = "secret";
+    std::atomic<int> reloads{0};
+    std::thread service([&options, &reloads]() {
+      runService(options, ManualFactory{}, -1, [&options, &reloads]() {
+        ++reloads;
+        return options;
+      });
+    });
+
+    net::io_context ioc;
+    websocket::stream<tcp::socket> ws{ioc};
+    connect(ws, options.port);
+
+    WHEN("It asks for a reload without the token, then with it") {
+      ws.write(net::buffer(std::string(R"({"command": "reload"})")));
+      ws.write(net::buffer(std::string(R"({"command": "reload", "token": "secreT"})")));
+      ws.write(net::buffer(std::string(R"({"command": "reload", "token": "secret"})")));
+      for (int i = 0; i < 100 && !reloads; ++i) {
+        sleep_for(milliseconds(10));
+      }
+      sleep_for(milliseconds(100));
+
+      THEN("Only the one with the token reloads, loopback or not") {
+        CHECK(reloads == 1);
+      }
+    }
+
+    ws.close(websocket::close_code::normal);
+    kill(getpid(), SIGINT);
+    service.join();
+  }
+}
@@ -0,0 +1,97 @@
+#include <catch2/catch_test_macros.hpp>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <signal.h>
+#include <unistd.h>
+#include "helper.h"
+#include "manual_service.h"
+
+#include "beast/service.hpp"
+
+using namespace std::this_thread; // sleep_for, sleep_until
+using namespace std::chrono; // nanoseconds, system_clock, seconds
+using namespace manual_service;
+
+SCENARIO("Retained messages") {
+  GIVEN("A service retaining messages for a second") {
+    init_logging(boost::log::trivial::warning);
+
+    auto options = serviceOptions("8099");
+    options.catchupRetention = 1;
+    std::thread service([&options]() {
+      runService(options, ManualFactory{});
+    });
+
+    net::io_context ioc;
+    websocket::stream<tcp::socket> early{ioc};
+    connect(early, options.port);
+    subscribe(early, R"("format": "json")");
+    g_sender.load()->sendRetained([](std::string &out, WireFormat, Rendering, Projection const &) {
+      out = "caught up\n";
+    }, IN_CLOSE_WRITE);
+
+    WHEN("A client subscribes within that second") {
+      websocket::stream<tcp::socket> ws{ioc};
+      connect(ws, options.port);
+      subscribe(ws, R"("format": "json")");
+      send("live\n");
+
+      THEN("It gets the retained message first") {
+        CHECK(readFrame(early) == "caught up\n");
+        CHECK(readFrame(ws) == "caught up\n");
+        CHECK(readFrame(ws) == "live\n");
+      }
+      ws.close(websocket::close_code::normal);
+    }
+
+    WHEN("A client subscribes while messages keep coming in") {
+      for (int i = 0; i < 1000; ++i) {
+        g_sender.load()->sendRetained([i](std::string &out, WireFormat, Rendering, Projection const &) {
+          out = "caught up " + std::to_string(i) + "\n";
+        }, IN_CLOSE_WRITE);
+      }
+      std::atomic<bool> sending{true};
+      std::thread sender([&sending]() {
+        while (sending) {
+          send("live\n");
+          sleep_for(microseconds(100));
+        }
+      });
+      websocket::stream<tcp::socket> ws{ioc};
+      connect(ws, options.port);
+      subscribe(ws, R"("format": "json")");
+      sending = false;
+      sender.join();
+
+      THEN("It gets the retained messages before any other") {
+        CHECK(readFrame(ws) == "caught up\n");
+        int inOrder = 0;
+        while (inOrder < 1000 && readFrame(ws) == "caught up " + std::to_string(inOrder) + "\n") {
+          ++inOrder;
+        }
+        CHECK(inOrder == 1000);
+        CHECK(readFrame(ws) == "live\n");
+      }
+      ws.close(websocket::close_code::normal);
+    }
+
+    WHEN("A client subscribes later on") {
+      sleep_for(milliseconds(1500));
+      websocket::stream<tcp::socket> ws{ioc};
+      connect(ws, options.port);
+      subscribe(ws, R"("format": "json")");
+      send("live\n");
+
+      THEN("The message is gone") {
+        CHECK(readFrame(early) == "caught up\n");
+        CHECK(readFrame(ws) == "live\n");
+      }
+      ws.close(websocket::close_code::normal);
+    }
+
+    early.close(websocket::close_code::normal);
+    kill(getpid(), SIGINT);
+    service.join();
+  }
+}
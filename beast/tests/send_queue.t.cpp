@@ -0,0 +1,241 @@
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <vector>
+
+#include "beast/send_queue.hpp"
+
+namespace {
+using steady = std::chrono::steady_clock;
+
+// the text as it is, unframed, so that its size is that of the text
+frame_ptr unframed(std::string text) {
+  auto frame = frame_buffer::make();
+  frame->payload() = std::move(text);
+  return frame;
+}
+
+send_queue::entry frameOf(std::string text, std::size_t events = 1) {
+  return {unframed(std::move(text)), events, 0, steady::now(), {}, 0};
+}
+
+auto makeGap = [](std::size_t dropped) {
+  return send_queue::entry{unframed("gap " + std::to_string(dropped)), 0, dropped, steady::now(), {}, 0};
+};
+
+send_queue::entry messageAbout(std::string name, std::uint32_t mask, std::string text) {
+  return {unframed(std::move(text)), 1, 0, steady::now(), {1, std::move(name)}, mask};
+}
+
+// what's queued, front first
+std::vector<std::string> contents(send_queue &queue) {
+  std::vector<std::string> res;
+  send_queue copy;
+  while (!queue.empty()) {
+    res.push_back(queue.front().frame->payload());
+    copy.push_back(queue.front());
+    queue.pop_front();
+  }
+  queue = std::move(copy);
+  return res;
+}
+} //namespace
+
+SCENARIO("Send queue") {
+  GIVEN("A queue of a frame being written and frames waiting") {
+    send_queue queue;
+    queue.push_back(frameOf("written"));
+    queue.push_back(frameOf("a", 2));
+    queue.push_back(frameOf("define", 0));
+    queue.push_back(frameOf("b"));
+    queue.push_back(frameOf("c"));
+
+    WHEN("The oldest frames are dropped") {
+      CHECK(queue.drop_oldest(makeGap) == 2);
+      CHECK(queue.drop_oldest(makeGap) == 1);
+
+      THEN("Gap records take their place, frames of no messages stay") {
+        CHECK(contents(queue) == std::vector<std::string>{"written", "gap 2", "define", "gap 1", "c"});
+        AND_WHEN("Another one is dropped right after a gap record") {
+          CHECK(queue.drop_oldest(makeGap) == 1);
+          THEN("The gap record counts it as well") {
+            CHECK(contents(queue) == std::vector<std::string>{"written", "gap 2", "define", "gap 2"});
+            CHECK(queue.bytes() == std::string("written" "gap 2" "define" "gap 2").size());
+          }
+        }
+      }
+    }
+
+    WHEN("Frames coming in are dropped") {
+      queue.drop_newest(1, makeGap);
+      queue.drop_newest(3, makeGap);
+
+      THEN("A gap record at the back counts them") {
+        CHECK(contents(queue) == std::vector<std::string>{"written", "a", "define", "b", "c", "gap 4"});
+      }
+    }
+
+    WHEN("Nothing but the frame being written and frames of no messages is left") {
+      while (queue.drop_oldest(makeGap)) {
+      }
+
+      THEN("Nothing more is dropped") {
+        CHECK(contents(queue) == std::vector<std::string>{"written", "gap 2", "define", "gap 2"});
+        CHECK(queue.oldest_droppable() == steady::time_point::max());
+      }
+    }
+  }
+
+  GIVEN("A queue of frames being written together and frames waiting") {
+    send_queue queue;
+    queue.push_back(frameOf("a"));
+    queue.push_back(frameOf("gap", 0));
+    queue.back().gap = 1;
+    queue.push_back(messageAbout("c", 1, "c"));
+    queue.push_back(frameOf("d"));
+    queue.push_back(frameOf("e"));
+    queue.start_writing(3);
+
+    WHEN("Frames are dropped") {
+      CHECK(queue.drop_oldest(makeGap) == 1);
+      queue.drop_newest(1, makeGap);
+
+      THEN("Only those waiting are, no gap record being written counts them") {
+        CHECK(contents(queue) == std::vector<std::string>{"a", "gap", "c", "gap 1", "e", "gap 1"});
+      }
+    }
+
+    WHEN("A message about one being written comes in") {
+      THEN("It's not conflated") {
+        CHECK_FALSE(queue.conflate({1, "c"}, unframed("c 3"), 3));
+      }
+    }
+
+    WHEN("The write completes") {
+      while (queue.writing()) {
+        queue.pop_front();
+      }
+      THEN("The frames waiting are left") {
+        CHECK(contents(queue) == std::vector<std::string>{"d", "e"});
+      }
+    }
+  }
+
+  GIVEN("A queue wrapping around its ring") {
+    send_queue queue;
+    for (int i = 0; i < 6; ++i) {
+      queue.push_back(frameOf(std::to_string(i)));
+    }
+    for (int i = 0; i < 5; ++i) {
+      queue.pop_front();
+    }
+    WHEN("It grows beyond") {
+      for (int i = 6; i < 20; ++i) {
+        queue.push_back(frameOf(std::to_string(i)));
+      }
+      THEN("Frames keep their order") {
+        auto queued = contents(queue);
+        REQUIRE(queued.size() == 15);
+        for (int i = 0; i < 15; ++i) {
+          CHECK(queued[i] == std::to_string(i + 5));
+        }
+      }
+    }
+  }
+
+  GIVEN("A queue of messages about files") {
+    send_queue queue;
+    queue.push_back(messageAbout("a", 1, "a written"));
+    queue.push_back(messageAbout("b", 1, "b 1"));
+    queue.push_back(messageAbout("a", 2, "a 2"));
+    queue.push_back(frameOf("c"));
+    conflation_key a{1, "a"};
+    conflation_key b{1, "b"};
+
+    WHEN("Another one about a file waiting comes in") {
+      auto mask = queue.conflated_mask(b, 4);
+      CHECK(mask == 5);
+      CHECK(queue.conflate(b, unframed("b 5"), mask));
+
+      THEN("It takes the place of the one waiting") {
+        CHECK(contents(queue) == std::vector<std::string>{"a written", "b 5", "a 2", "c"});
+        CHECK(queue.bytes() == std::string("a written" "b 5" "a 2" "c").size());
+      }
+    }
+
+    WHEN("One comes in about the file being written and waiting as well") {
+      CHECK(queue.conflated_mask(a, 1) == 3);
+      CHECK(queue.conflate(a, unframed("a 3"), 3));
+
+      THEN("The latest one waiting takes it in") {
+        CHECK(contents(queue) == std::vector<std::string>{"a written", "b 1", "a 3", "c"});
+      }
+    }
+
+    WHEN("One comes in with bits of the mask waiting missing") {
+      THEN("It's not conflated") {
+        CHECK_FALSE(queue.conflate(b, unframed("b 4"), 4));
+        CHECK(contents(queue) == std::vector<std::string>{"a written", "b 1", "a 2", "c"});
+      }
+    }
+
+    WHEN("The messages are written") {
+      queue.pop_front();
+      queue.pop_front();
+
+      THEN("Those about the file are not conflated anymore") {
+        CHECK(queue.conflated_mask(b, 4) == 4);
+        CHECK_FALSE(queue.conflate(b, unframed("b 4"), 4));
+        AND_THEN("Nor the one being written") {
+          CHECK_FALSE(queue.conflate(a, unframed("a 3"), 3));
+        }
+      }
+    }
+
+    WHEN("Nothing is waiting but a frame being written, and one about the same file comes in") {
+      send_queue writing;
+      writing.push_back(messageAbout("a", 1, "a 1"));
+      writing.start_writing(1);
+      auto mask = writing.conflated_mask(a, 2);
+      auto conflated = writing.conflate(a, unframed("a 2"), mask);
+      if (!conflated) {
+        writing.push_back(messageAbout("a", mask, "a 2"));
+      }
+
+      THEN("It goes on its own, with its own mask") {
+        CHECK(mask == 2);
+        CHECK_FALSE(conflated);
+        AND_THEN("Later ones take the place of the one after it, once it's written") {
+          writing.pop_front();
+          CHECK(writing.conflated_mask(a, 4) == 4);
+          writing.push_back(messageAbout("a", 4, "a 4"));
+          CHECK(writing.conflated_mask(a, 8) == 12);
+          CHECK(writing.conflate(a, unframed("a 12"), 12));
+          CHECK(contents(writing) == std::vector<std::string>{"a 2", "a 12"});
+        }
+      }
+    }
+
+    WHEN("The frames waiting are written together") {
+      queue.start_writing(3);
+
+      THEN("Messages about their files don't get their masks") {
+        CHECK(queue.conflated_mask(a, 4) == 4);
+        CHECK(queue.conflated_mask(b, 4) == 4);
+      }
+    }
+
+    WHEN("The queue grows and wraps around") {
+      for (int i = 0; i < 10; ++i) {
+        queue.push_back(frameOf(std::to_string(i)));
+      }
+      queue.pop_front();
+
+      THEN("Messages waiting are conflated still") {
+        CHECK(queue.conflate(a, unframed("a 3"), 3));
+        auto queued = contents(queue);
+        REQUIRE(queued.size() == 13);
+        CHECK(queued[1] == "a 3");
+      }
+    }
+  }
+}
@@ -0,0 +1,68 @@
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+#include <signal.h>
+#include <unistd.h>
+#include "helper.h"
+#include "manual_service.h"
+
+#include "beast/service.hpp"
+
+using namespace std::this_thread; // sleep_for, sleep_until
+using namespace std::chrono; // nanoseconds, system_clock, seconds
+using namespace manual_service;
+
+SCENARIO("Sessions changing between messages") {
+  GIVEN("A client getting the messages sent from this thread") {
+    init_logging(boost::log::trivial::warning);
+
+    auto options = serviceOptions("8090");
+    std::thread service([&options]() {
+      runService(options, ManualFactory{});
+    });
+
+    net::io_context ioc;
+    websocket::stream<tcp::socket> first{ioc};
+    connect(first, options.port);
+    subscribe(first, R"("format": "json")");
+    send("one\n");
+    REQUIRE(readFrame(first) == "one\n");
+
+    WHEN("Another one subscribes, and the first one asks for other events") {
+      websocket::stream<tcp::socket> second{ioc};
+      connect(second, options.port);
+      subscribe(second, R"("format": "json")");
+      first.write(net::buffer(std::string(R"({"command": "subscribe", "mask": 512, "format": "json"})")));
+      sleep_for(milliseconds(50));
+      send("two\n");
+      g_sender.load()->send("gone\n", IN_DELETE);
+
+      THEN("The next messages go by their subscriptions as they are now") {
+        CHECK(readFrame(second) == "two\n");
+        CHECK(readFrame(first) == "gone\n");
+      }
+      second.close(websocket::close_code::normal);
+    }
+
+    WHEN("It leaves, and another one subscribes") {
+      first.close(websocket::close_code::normal);
+      sleep_for(milliseconds(50));
+      websocket::stream<tcp::socket> second{ioc};
+      connect(second, options.port);
+      subscribe(second, R"("format": "json")");
+      send("two\n");
+
+      THEN("The new one gets the next message") {
+        CHECK(readFrame(second) == "two\n");
+      }
+      second.close(websocket::close_code::normal);
+    }
+
+    if (first.is_open()) {
+      first.close(websocket::close_code::normal);
+    }
+    kill(getpid(), SIGINT);
+    service.join();
+  }
+}
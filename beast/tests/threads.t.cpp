@@ -0,0 +1,222 @@
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <signal.h>
+#include <sys/inotify.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "helper.h"
+#include "manual_service.h"
+
+#include "glue/options.h"
+#include "glue/message_provider_factory.h"
+#include "beast/service.hpp"
+
+using namespace std::this_thread; // sleep_for, sleep_until
+using namespace std::chrono; // nanoseconds, system_clock, seconds
+using namespace manual_service;
+
+namespace {
+std::atomic<MessageSender const *> g_benchSender{nullptr};
+
+class BenchmarkProvider: public MessageProvider {
+public:
+  explicit BenchmarkProvider(MessageSender const &messageSender) {
+    g_benchSender = &messageSender;
+  }
+  ~BenchmarkProvider() override {
+    g_benchSender = nullptr;
+  }
+private:
+  void logSubscribing([[maybe_unused]] int mask) const override {}
+};
+
+class BenchmarkFactory: public MessageProviderFactory {
+public:
+  std::unique_ptr<MessageProvider> makeMessageProvider(const MessageSender &messageSender) const override {
+    return std::make_unique<BenchmarkProvider>(messageSender);
+  }
+};
+
+// A client reading whatever comes, counting the messages of all of them
+struct client {
+  websocket::stream<tcp::socket> ws;
+  beast::flat_buffer buffer;
+  std::atomic<std::size_t> &received;
+  std::atomic<bool> subscribed{false}; // got a message
+
+  client(net::io_context &ioc, std::atomic<std::size_t> &received): ws{ioc}, received{received} {}
+
+  void read() {
+    ws.async_read(buffer, [this](beast::error_code ec, std::size_t) {
+      if (ec) {
+        return;
+      }
+      buffer.clear();
+      subscribed = true;
+      ++received;
+      read();
+    });
+  }
+};
+
+Options benchmarkOptions(std::string port, unsigned threads) {
+  auto options = serviceOptions(std::move(port));
+  options.queueTotalBytes = 1 << 30; // nothing is dropped, the clients count every message
+  options.threads = threads;
+  return options;
+}
+
+// Connections the process can afford, both ends of them being in it
+std::size_t affordableConnections(std::size_t wanted) {
+  rlimit limit{};
+  getrlimit(RLIMIT_NOFILE, &limit);
+  limit.rlim_cur = limit.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &limit);
+  rlim_t reserve = 100;
+  return std::min<std::size_t>(wanted, limit.rlim_cur > 2 * reserve ? (limit.rlim_cur - reserve) / 2 : 0);
+}
+
+// Time from the first message sent to the last one received by all the clients, in ns per message and client
+double nsPerDelivery(unsigned threads, std::string const &port, std::size_t connections, int messages) {
+  auto options = benchmarkOptions(port, threads);
+  std::thread service([&options]() {
+    runService(options, BenchmarkFactory{});
+  });
+
+  // the clients have threads of their own, so the service is what's measured
+  net::io_context ioc;
+  std::atomic<std::size_t> received{0};
+  std::vector<std::unique_ptr<client>> clients;
+  tcp::resolver resolver{ioc};
+  auto const results = resolver.resolve("127.0.0.1", port);
+  for (std::size_t i = 0; i < connections; ++i) {
+    clients.push_back(std::make_unique<client>(ioc, received));
+    auto &ws = clients.back()->ws;
+    for (int attempt = 1; ; ++attempt) {
+      boost::system::error_code ec;
+      net::connect(ws.next_layer(), results, ec);
+      if (!ec) {
+        break;
+      }
+      REQUIRE(attempt < 10);
+      sleep_for(milliseconds(attempt * attempt * 10));
+    }
+    ws.handshake("127.0.0.1:" + port, "/");
+    ws.write(net::buffer("{\"command\": \"subscribe\", \"mask\": " + std::to_string(IN_CLOSE_WRITE) + "}"));
+    clients.back()->read();
+  }
+  auto guard = net::make_work_guard(ioc);
+  std::vector<std::thread> readers;
+  for (unsigned i = 0; i < std::max(2u, std::thread::hardware_concurrency() / 2); ++i) {
+    readers.emplace_back([&ioc]() { ioc.run(); });
+  }
+
+  auto waitFor = [&received](std::size_t count) {
+    while (received < count) {
+      sleep_for(microseconds(100));
+    }
+  };
+  // the subscriptions are in once each client got a warm-up message
+  auto subscribed = [&clients]() {
+    return std::all_of(clients.begin(), clients.end(), [](auto &c) { return c->subscribed.load(); });
+  };
+  while (!subscribed()) {
+    g_benchSender.load()->send("warm up\n", IN_CLOSE_WRITE);
+    sleep_for(milliseconds(100));
+  }
+  sleep_for(milliseconds(100));
+  received = 0;
+
+  std::string message = R"({"path":"photos/2023/summer","name":"IMG_1000.jpg","mask":8,"cookie":0})" "\n";
+  auto start = steady_clock::now();
+  for (int i = 0; i < messages; ++i) {
+    g_benchSender.load()->send(message, IN_CLOSE_WRITE);
+  }
+  waitFor(connections * messages);
+  auto elapsed = duration<double, std::nano>(steady_clock::now() - start).count();
+
+  kill(getpid(), SIGINT);
+  service.join();
+  guard.reset();
+  ioc.stop();
+  for (auto &reader : readers) {
+    reader.join();
+  }
+  return elapsed / (double(messages) * connections);
+}
+} //namespace
+
+SCENARIO("Networking threads") {
+  GIVEN("Clients of a service running four networking threads") {
+    init_logging(boost::log::trivial::warning);
+
+    auto options = serviceOptions("8097");
+    options.threads = 4;
+    std::thread service([&options]() {
+      runService(options, ManualFactory{});
+    });
+
+    net::io_context ioc;
+    std::vector<std::unique_ptr<websocket::stream<tcp::socket>>> clients;
+    for (int i = 0; i < 16; ++i) {
+      clients.push_back(std::make_unique<websocket::stream<tcp::socket>>(ioc));
+      connect(*clients.back(), options.port);
+      subscribe(*clients.back(), R"("format": "json")");
+    }
+
+    WHEN("Messages come in") {
+      constexpr int messages = 200;
+      for (int i = 0; i < messages; ++i) {
+        send(std::to_string(i) + "\n");
+      }
+
+      THEN("Each client gets all of them, in order") {
+        CHECK(getMetrics(options.port).find("notibeast_sessions 16\n") != std::string::npos);
+        for (auto &ws : clients) {
+          int expected = 0;
+          for (; expected < messages; ++expected) {
+            if (readFrame(*ws) != std::to_string(expected) + "\n") {
+              break;
+            }
+          }
+          CHECK(expected == messages);
+        }
+      }
+    }
+
+    for (auto &ws : clients) {
+      ws->close(websocket::close_code::normal);
+    }
+    kill(getpid(), SIGINT);
+    service.join();
+  }
+}
+
+// test/tests "[benchmark]"
+TEST_CASE("Scaling with networking threads", "[.][benchmark]") {
+  init_logging(boost::log::trivial::fatal);
+  auto connections = affordableConnections(10000);
+  REQUIRE(connections > 0);
+  constexpr int messages = 100;
+
+  auto cores = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<unsigned> counts;
+  for (unsigned threads = 1; threads < cores; threads *= 2) {
+    counts.push_back(threads);
+  }
+  counts.push_back(cores);
+
+  int port = 8100;
+  for (auto threads : counts) {
+    auto ns = nsPerDelivery(threads, std::to_string(port++), connections, messages);
+    std::cout << connections << " sessions, " << threads << " networking threads: "
+              << ns << " ns/message/session\n";
+  }
+}
@@ -10,9 +10,66 @@
 
 #include "websocket_session.hpp"
 #include "shared_state.hpp"
+#include "deflate.hpp"
+#include "glue/event_fields.h"
+#include "glue/metadata_fields.h"
+#include "glue/wire_format.h"
 #include <boost/json.hpp>
 #include <boost/log/trivial.hpp>
+#include <algorithm>
 #include <iostream>
+#include <tuple>
+#include <utility>
+
+namespace {
+
+// Frames of a gathered write at most: as many as fit into the buffers asio passes to a
+// single writev(), each frame taking a header and a payload. Those queued beyond may still
+// be dropped, should the session fall behind
+constexpr std::size_t maxGatheredFrames =
+    std::min<std::size_t>(64, net::detail::max_iov_len) /
+    std::tuple_size<decltype(std::declval<frame_buffer const&>().buffers())>::value;
+
+// e.g. "batch": {"bytes": 65536, "events": 1000, "delay": 10}, the delay in milliseconds,
+// what's not given is the default
+batching
+parseBatching(boost::json::object const& batch) {
+    constexpr std::size_t maxBytes = 1 << 20;
+    constexpr std::chrono::milliseconds maxDelay{1000};
+    batching res{64 * 1024, 1000, std::chrono::milliseconds{10}};
+    if (auto bytes = batch.if_contains("bytes"))
+        res.bytes = std::min<std::size_t>(bytes->to_number<std::size_t>(), maxBytes);
+    if (auto events = batch.if_contains("events"))
+        res.events = events->to_number<std::size_t>();
+    if (auto delay = batch.if_contains("delay"))
+        res.delay = std::min(std::chrono::milliseconds{delay->to_number<int64_t>()}, maxDelay);
+    return res;
+}
+
+// e.g. "queue": {"policy": "dropNewest", "bytes": 65536, "seconds": 5}, policies being
+// "dropOldest", "dropNewest" and "disconnect". It throws on an unknown policy
+queue_limits
+parseQueueLimits(boost::json::object const& queue) {
+    queue_limits res;
+    if (auto policy = queue.if_contains("policy")) {
+        auto& name = policy->as_string();
+        if (name == "dropOldest")
+            res.policy = queue_policy::drop_oldest;
+        else if (name == "dropNewest")
+            res.policy = queue_policy::drop_newest;
+        else if (name == "disconnect")
+            res.policy = queue_policy::disconnect;
+        else
+            throw std::runtime_error("Unknown queue policy: " + std::string(name));
+    }
+    if (auto bytes = queue.if_contains("bytes"))
+        res.bytes = bytes->to_number<std::size_t>();
+    if (auto seconds = queue.if_contains("seconds"))
+        res.age = std::chrono::seconds{seconds->to_number<int64_t>()};
+    return res;
+}
+
+} // namespace
 
 websocket_session::
 websocket_session(
@@ -21,6 +78,15 @@ websocket_session(
     : ws_(std::move(socket))
     , state_(state)
 {
+    beast::error_code ec;
+    auto ep = beast::get_lowest_layer(ws_).socket().remote_endpoint(ec);
+    if(! ec) {
+        client_ = ep.address().to_string() + ":" + std::to_string(ep.port());
+        auto address = ep.address();
+        if(address.is_v6() && address.to_v6().is_v4_mapped())
+            address = net::ip::make_address_v4(net::ip::v4_mapped, address.to_v6());
+        loopback_ = address.is_loopback();
+    }
 }
 
 websocket_session::
@@ -28,6 +94,7 @@ websocket_session::
     BOOST_LOG_TRIVIAL(info) <<"Closing websocket";
     // Remove this session from the list of active sessions
     state_->leave(this);
+    state_->budget().queued -= queue_.bytes();
     if (ws_.is_open()) {
         ws_.close(websocket::close_reason("Shutting down"));
     }
@@ -36,8 +103,10 @@ websocket_session::
 void
 websocket_session::
 fail(beast::error_code ec, char const* what) {
+    // Nothing unexpected, a client disconnected for being too far behind is logged already
     if( ec == net::error::operation_aborted ||
-        ec == websocket::error::closed)
+        ec == websocket::error::closed ||
+        disconnected_)
     {
         BOOST_LOG_TRIVIAL(debug) << what << ": " << ec.message();
     } else {
@@ -93,32 +162,188 @@ on_read(beast::error_code ec, std::size_t) {
 
 void
 websocket_session::
-send(boost::shared_ptr<std::string const> const& ss) {
+send(frame_ptr const& frame, std::size_t events) {
+    send(outgoing{frame, events, {}, 0});
+}
+
+void
+websocket_session::
+send(frame_ptr const& frame, conflation_key key, std::uint32_t mask) {
+    send(outgoing{frame, 1, std::move(key), mask});
+}
+
+void
+websocket_session::
+send(std::vector<outgoing>&& frames) {
+    if(frames.empty())
+        return;
+    bool post = false;
+    {
+        std::lock_guard<std::mutex> lock(inbox_mutex_);
+        if(inbox_.empty())
+            inbox_.swap(frames);
+        else
+            inbox_.insert(inbox_.end(),
+                std::make_move_iterator(frames.begin()), std::make_move_iterator(frames.end()));
+        post = ! std::exchange(inbox_posted_, true);
+    }
     // Post our work to the strand, this ensures
     // that the members of `this` will not be
-    // accessed concurrently.
+    // accessed concurrently. Unless the session
+    // is going, it leaves first, see shared_state
+    if(! post)
+        return;
+    if(auto self = weak_from_this().lock())
+        net::post(
+            ws_.get_executor(),
+            beast::bind_front_handler(
+                &websocket_session::on_send,
+                std::move(self)));
+}
 
-    net::post(
-        ws_.get_executor(),
-        beast::bind_front_handler(
-            &websocket_session::on_send,
-            shared_from_this(),
-            ss));
+void
+websocket_session::
+send(outgoing&& frame) {
+    bool post = false;
+    {
+        std::lock_guard<std::mutex> lock(inbox_mutex_);
+        inbox_.push_back(std::move(frame));
+        post = ! std::exchange(inbox_posted_, true);
+    }
+    if(! post)
+        return;
+    if(auto self = weak_from_this().lock())
+        net::post(
+            ws_.get_executor(),
+            beast::bind_front_handler(
+                &websocket_session::on_send,
+                std::move(self)));
 }
 
 void
 websocket_session::
-on_send(boost::shared_ptr<std::string const> const& ss) {
-    // Always add to queue
-    queue_.push_back(ss);
+on_send() {
+    {
+        std::lock_guard<std::mutex> lock(inbox_mutex_);
+        taken_.swap(inbox_);
+        inbox_posted_ = false;
+    }
+    auto now = std::chrono::steady_clock::now();
+    for(auto const& frame : taken_)
+        if(! queue(frame, now))
+            break;
+    taken_.clear();
 
-    // Are we already writing?
-    if(queue_.size() > 1)
+    // Are we already writing? What's queued meanwhile goes out with the next write
+    if(queue_.writing() || queue_.empty() || disconnected_)
         return;
 
-    // We are not currently writing, so send this immediately
-    ws_.async_write(
-        net::buffer(*queue_.front()),
+    // We are not currently writing, so send all of it immediately
+    write_pending();
+}
+
+bool
+websocket_session::
+queue(outgoing const& frame, std::chrono::steady_clock::time_point now) {
+    // Closing, nothing goes after the close frame
+    if(! ws_.is_open() || disconnected_)
+        return false;
+
+    auto make_gap = [this, now](std::size_t dropped) {
+        return gap_record(dropped, now);
+    };
+    auto bytes_before = queue_.bytes();
+    // the one waiting about the same takes it in, nothing more is queued
+    if(frame.key && queue_.conflate(frame.key, frame.frame, frame.mask)) {
+        queue_changed(bytes_before);
+        return true;
+    }
+
+    if(limits_.policy == queue_policy::drop_newest &&
+        frame.events && ! queue_.empty() && behind(frame.frame->size(), now))
+    {
+        queue_.drop_newest(frame.events, make_gap);
+        state_->budget().dropped += frame.events;
+        queue_changed(bytes_before);
+        return true;
+    }
+
+    queue_.push_back({frame.frame, frame.events, 0, now, frame.key, frame.mask});
+    if(limits_.policy == queue_policy::drop_oldest) {
+        while(behind(0, now)) {
+            auto dropped = queue_.drop_oldest(make_gap);
+            if(dropped == 0)
+                break;
+            state_->budget().dropped += dropped;
+        }
+    }
+    queue_changed(bytes_before);
+    if(limits_.policy == queue_policy::disconnect && behind(0, now)) {
+        disconnect();
+        return false;
+    }
+    return true;
+}
+
+// Whether the session is too far behind, with the incoming bytes queued as well
+bool
+websocket_session::
+behind(std::size_t incoming, std::chrono::steady_clock::time_point now) const {
+    auto const& budget = state_->budget();
+    auto cap = limits_.bytes ? std::min(limits_.bytes, budget.session_cap) : budget.session_cap;
+    if(queue_.bytes() + incoming > cap)
+        return true;
+    // the frame being written aside, a session keeping up has nothing queued
+    auto waiting = queue_.size() + (incoming ? 1 : 0);
+    if(waiting > 1 && budget.queued + incoming > budget.total_cap)
+        return true;
+    return limits_.age.count() && now - queue_.oldest_droppable() > limits_.age;
+}
+
+// Tells the client it missed that many messages, in the format of its subscription
+send_queue::entry
+websocket_session::
+gap_record(std::size_t dropped, std::chrono::steady_clock::time_point now) const {
+    std::string record;
+    appendGap(record, format_, dropped);
+    auto frame = compress_ ? frame_message(deflate_message(record), true)
+                           : frame_message(record, isBinary(format_));
+    return {frame, 0, dropped, now, {}, 0};
+}
+
+void
+websocket_session::
+queue_changed(std::size_t bytes_before) {
+    state_->budget().queued += queue_.bytes() - bytes_before;
+    queued_bytes_ = queue_.bytes();
+    queued_frames_ = queue_.size();
+}
+
+void
+websocket_session::
+disconnect() {
+    BOOST_LOG_TRIVIAL(warning) << "Disconnecting " << client_ << ", "
+        << queue_.bytes() << " bytes behind";
+    disconnected_ = true;
+    ++state_->budget().disconnected;
+    // what's pending fails, the session goes once it's done
+    beast::error_code ec;
+    beast::get_lowest_layer(ws_).socket().close(ec);
+}
+
+void
+websocket_session::
+write_pending() {
+    // All the frames waiting, as they are, built once for all the sessions, go
+    // out in a single gathered write: a syscall and a handler for all of them
+    auto n = std::min(queue_.size(), maxGatheredFrames);
+    writing_.clear();
+    for(std::size_t i = 0; i < n; ++i)
+        for(auto const& b : queue_.at(i).frame->buffers())
+            writing_.push_back(b);
+    queue_.start_writing(n);
+    ws_.next_layer().async_write_frames(
+        beast::span<net::const_buffer const>(writing_.data(), writing_.size()),
         beast::bind_front_handler(
             &websocket_session::on_write,
             shared_from_this()));
@@ -131,16 +356,15 @@ on_write(beast::error_code ec, std::size_t) {
     if(ec)
         return fail(ec, "write");
 
-    // Remove the string from the queue
-    queue_.erase(queue_.begin());
+    // Remove the frames written from the queue
+    auto bytes_before = queue_.bytes();
+    while(queue_.writing())
+        queue_.pop_front();
+    queue_changed(bytes_before);
 
-    // Send the next message if any
+    // Send what's queued meanwhile, if any
     if(! queue_.empty())
-        ws_.async_write(
-            net::buffer(*queue_.front()),
-            beast::bind_front_handler(
-                &websocket_session::on_write,
-                shared_from_this()));
+        write_pending();
 }
 
 void
@@ -166,8 +390,57 @@ processMessage(boost::string_view message) {
         BOOST_LOG_TRIVIAL(debug) << "\"mask\" is not present on the object";
         return;
       }
-      auto &mask = maskValue.as_int64();
-      state_->subscribe(this, mask);
+      subscription sub;
+      sub.mask = maskValue.as_int64();
+      if (auto fields = messageObject.if_contains("metadata")) {
+        for (auto &field : fields->as_array()) {
+          sub.metadata |= parseMetadataField(std::string(field.as_string()));
+        }
+      }
+      if (auto fields = messageObject.if_contains("fields")) {
+        sub.fields = 0;
+        for (auto &field : fields->as_array()) {
+          std::string name(field.as_string());
+          try {
+            sub.fields |= parseEventField(name);
+          } catch (std::runtime_error const &) { // metadata is asked for this way as well
+            sub.metadata |= parseMetadataField(name);
+          }
+        }
+      }
+      if (auto name = messageObject.if_contains("format")) {
+        sub.format = parseWireFormat(std::string(name->as_string()));
+      }
+      if (auto batch = messageObject.if_contains("batch")) {
+        sub.batch = parseBatching(batch->as_object());
+      }
+      if (auto compress = messageObject.if_contains("compress")) {
+        sub.compress = compress->as_bool();
+      }
+      if (auto pathIds = messageObject.if_contains("pathIds")) {
+        sub.pathIds = pathIds->as_bool();
+      }
+      if (auto conflate = messageObject.if_contains("conflate")) {
+        sub.conflate = conflate->as_bool();
+      }
+      if (auto queue = messageObject.if_contains("queue")) {
+        sub.queue = parseQueueLimits(queue->as_object());
+      }
+      limits_ = sub.queue;
+      format_ = sub.format;
+      compress_ = sub.compress;
+      state_->subscribe(this, sub);
+    } else if (command == "reload") {
+      std::string_view token;
+      if (auto value = messageObject.if_contains("token"); value && value->is_string()) {
+        auto const &s = value->as_string();
+        token = std::string_view(s.data(), s.size());
+      }
+      if (state_->may_reload(loopback_, token)) {
+        state_->reload();
+      } else {
+        BOOST_LOG_TRIVIAL(warning) << "Reload refused to " << client_;
+      }
     }
   } catch (std::exception const &ec) {
     BOOST_LOG_TRIVIAL(error) << "JSON processing failed: " << ec.what();
@@ -13,7 +13,13 @@
 
 #include "net.hpp"
 #include "beast.hpp"
+#include "frame_stream.hpp"
+#include "send_queue.hpp"
+#include "glue/wire_format.h"
 
+#include <atomic>
+#include <chrono>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -24,14 +30,29 @@ class shared_state;
 class websocket_session : public boost::enable_shared_from_this<websocket_session>
 {
     beast::flat_buffer buffer_;
-    websocket::stream<beast::tcp_stream> ws_;
+    websocket::stream<frame_stream<beast::tcp_stream>> ws_;
     boost::shared_ptr<shared_state> state_;
-    std::vector<boost::shared_ptr<std::string const>> queue_;
+
+    send_queue queue_;
+    std::vector<net::const_buffer> writing_;   // buffers of the frames of the write in progress
+    queue_limits limits_;                      // of the subscription
+    WireFormat format_ = WireFormat::json;     // of the subscription, gap records go in it
+    bool compress_ = false;                    // so are they compressed
+    bool disconnected_ = false;                // too far behind
+    std::string client_;                       // address:port
+    bool loopback_ = false;                    // the client connected on a loopback address
+    std::atomic<std::size_t> queued_bytes_{0}; // see queued_bytes()
+    std::atomic<std::size_t> queued_frames_{0};
 
     void fail(beast::error_code ec, char const* what);
     void on_accept(beast::error_code ec);
     void on_read(beast::error_code ec, std::size_t bytes_transferred);
     void on_write(beast::error_code ec, std::size_t bytes_transferred);
+    void write_pending();
+    bool behind(std::size_t incoming, std::chrono::steady_clock::time_point now) const;
+    send_queue::entry gap_record(std::size_t dropped, std::chrono::steady_clock::time_point now) const;
+    void queue_changed(std::size_t bytes_before);
+    void disconnect();
 
 public:
     websocket_session(
@@ -44,13 +65,54 @@ public:
     void
     run(http::request<Body, http::basic_fields<Allocator>> req);
 
-    // Send a message
+    // A frame handed to the session, see send()
+    struct outgoing {
+        frame_ptr frame;
+        std::size_t events = 1;
+        conflation_key key;     // see send_queue::conflate()
+        std::uint32_t mask = 0; // it's rendered with, for a key
+    };
+
+    // Send a frame of frame_message() holding that many messages. Frames of 0 messages,
+    // e.g. path definitions, are never dropped, whatever the queue_limits
+    void
+    send(frame_ptr const& frame, std::size_t events);
+
+    // Send the frame of a message about the key, rendered with conflated_mask(). It takes
+    // the place of the one waiting about the same, if any may be
+    void
+    send(frame_ptr const& frame, conflation_key key, std::uint32_t mask);
+
     void
-    send(boost::shared_ptr<std::string const> const& ss);
+    send(outgoing&& frame);
+
+    // Send the frames in order, handed over at once
+    void
+    send(std::vector<outgoing>&& frames);
+
+    // The mask to render the message about the key with, see send_queue::conflated_mask(), from any thread
+    std::uint32_t conflated_mask(conflation_key const& key, std::uint32_t mask) {
+        return queue_.conflated_mask(key, mask);
+    }
+
+    // What's queued for the client and not written yet, from any thread
+    std::size_t queued_bytes() const { return queued_bytes_; }
+    std::size_t queued_frames() const { return queued_frames_; }
 
 private:
+    // Frames handed over by the other threads, the session's own one takes them
+    // all at once in on_send(): a post for as many frames as come in meanwhile
+    std::mutex inbox_mutex_;
+    std::vector<outgoing> inbox_;
+    bool inbox_posted_ = false;
+    std::vector<outgoing> taken_; // out of the inbox, on the session's thread
+
     void
-    on_send(boost::shared_ptr<std::string const> const& ss);
+    on_send();
+
+    // Queues the frame, false if nothing more is to be
+    bool
+    queue(outgoing const& frame, std::chrono::steady_clock::time_point now);
 
     void
     processMessage(boost::string_view message);
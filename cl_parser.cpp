@@ -7,23 +7,63 @@ namespace po = boost::program_options;
 
 //Unset Options indicate --help being requested
 boost::optional<Options> parseCommandLine(int argc, char **argv) {
-  Options res;
+  Options res; // with the defaults of each option, see options.h
+
   po::options_description desc("Allowed options");
   desc.add_options()
       ("help", "produce help message")
-      ("address,a", po::value(&res.address)->default_value("0.0.0.0"), "TCP address of the binding interface.")
-      ("port,p", po::value(&res.port)->default_value("8080"), "Which port to listen to.")
+      ("address,a", po::value(&res.address)->default_value(res.address), "TCP address of the binding interface.")
+      ("port,p", po::value(&res.port)->default_value(res.port), "Which port to listen to.")
       ("monitor_path,m", po::value(&res.pathToMonitor)->required(), "Path to the directory to monitor")
       ("path_to_exclude,x", po::value(&res.pathsToExclude), "Path(s) to exclude from monitoring. Doesn't have to be a full path.")
-      ("log_severity,l", po::value(&res.logSeverity)->default_value(boost::log::trivial::info), "log level to output");
+      ("state_file,s", po::value(&res.stateFile), "File to persist the state of the monitored tree to. "
+                                                  "Changes made while the service was down are sent as catch-up events on the next start.")
+      ("state_interval", po::value(&res.stateInterval)->default_value(res.stateInterval), "How often (in seconds) the tree state is persisted, 0 - only at shutdown.")
+      ("catchup_retention", po::value(&res.catchupRetention)->default_value(res.catchupRetention), "How long (in seconds) catch-up events are "
+                                                                              "replayed to clients subscribing later, 0 - not at all.")
+      ("handoff_socket", po::value(&res.handoffSocket), "Unix socket for zero-downtime upgrades. A new instance started with the same socket "
+                                                        "takes the listening port and the inotify watches over from the running one.")
+      ("class,w", po::value(&res.schedulingClasses), "Weighted fair share of a subtree in event processing as 'subtree:weight', "
+                                                    "e.g. -w critical:8 -w backups:1. The rest of the tree is '.', of weight 1 unless given.")
+      ("low_latency", po::bool_switch(&res.lowLatency), "Trade CPU for latency: busy-poll inotify and the sockets "
+                                                      "instead of sleeping, no Nagle. Takes a core per polling thread.")
+      ("inotify_cpu", po::value(&res.inotifyCpu)->default_value(res.inotifyCpu), "Core to pin the inotify reading thread to, -1 - don't pin.")
+      ("io_cpu", po::value(&res.ioCpu)->default_value(res.ioCpu), "Core to pin the networking thread to, the next ones to the next cores, "
+                                                          "-1 - don't pin.")
+      ("tail,t", po::value(&res.tailPatterns), "Name(s) of the files, e.g. logs, to stream appended bytes of. Doesn't have to be a full name. "
+                                              "Subscribe with mask bit 0x00100000 to receive them.")
+      ("tail_chunk", po::value(&res.tailChunk)->default_value(res.tailChunk), "Max bytes of a file sent in one message.")
+      ("hash", po::bool_switch(&res.hash), "Send the XXH64 digest of the file content with IN_CLOSE_WRITE events. "
+                                          "Files are read on a separate pool of threads, such events are delayed until then.")
+      ("hash_threads", po::value(&res.hashThreads)->default_value(res.hashThreads), "Threads reading files to hash.")
+      ("delta", po::value(&res.deltaPatterns), "Path(s) of the files to send what changed of on IN_CLOSE_WRITE, as block ranges. "
+                                              "Doesn't have to be a full path. Subscribe with mask bit 0x00200000 to receive them.")
+      ("delta_store", po::value(&res.deltaStore)->default_value(res.deltaStore), "Directory to keep block signatures of the files in.")
+      ("delta_block", po::value(&res.deltaBlock)->default_value(res.deltaBlock), "Block size of the signatures.")
+      ("delta_data", po::bool_switch(&res.deltaData), "Send the changed bytes along with the ranges.")
+      ("symbolic_mask", po::bool_switch(&res.symbolicMask), "Send masks as names, e.g. \"IN_CREATE|IN_ISDIR\", rather than numbers.")
+      ("queue_bytes", po::value(&res.queueBytes)->default_value(res.queueBytes), "Max bytes queued for a client which can't keep up. "
+                                                                         "What then is up to its subscription, oldest messages are dropped by default.")
+      ("queue_total_bytes", po::value(&res.queueTotalBytes)->default_value(res.queueTotalBytes), "Max bytes queued for all the clients.")
+      ("threads", po::value(&res.threads)->default_value(res.threads), "Networking threads, each accepting and serving connections of its own. "
+                                                            "0 - a thread per core.")
+      ("config,c", po::value(&res.configFile), "Config file with any of the options above as 'name=value' lines. "
+                                               "Command line options take precedence. monitor_path and path_to_exclude "
+                                               "are re-read on SIGHUP or a reload command, without a restart.")
+      ("admin_token", po::value(&res.adminToken), "Token a client has to send along with a reload command, "
+                                                  "from wherever it connects. Without it, only clients on loopback may reload.")
+      ("log_severity,l", po::value(&res.logSeverity)->default_value(res.logSeverity), "log level to output");
 
   po::variables_map vm;
   po::store(po::command_line_parser(argc, argv)
       .options(desc).run(), vm);
+  if (vm.count("config")) {
+    po::store(po::parse_config_file(vm["config"].as<std::string>().c_str(), desc), vm);
+  }
 
   if (vm.count("help")) {
       BOOST_LOG_TRIVIAL(info) << desc
-        << "e.g.:\n./notibeast -a 0.0.0.0 -p 8080 -m /tmp  -x '@eaDir' -x '#recycle' -l debug";
+        << "e.g.:\n./notibeast -a 0.0.0.0 -p 8080 -m /tmp  -x '@eaDir' -x '#recycle' -s /var/lib/notibeast/tmp.state -l debug";
       return {};
   }
 
@@ -0,0 +1,45 @@
+#include "cpu_affinity.h"
+
+#include <boost/log/trivial.hpp>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <pthread.h>
+
+namespace {
+// The cores of the first thread pinned, as they were before
+std::once_flag unpinnedOnce;
+cpu_set_t unpinned;
+std::atomic<bool> unpinnedKnown{false};
+} //namespace
+
+bool pinCurrentThread(int cpu) {
+  if (cpu < 0) {
+    return true;
+  }
+  std::call_once(unpinnedOnce, []() {
+    unpinnedKnown = pthread_getaffinity_np(pthread_self(), sizeof(unpinned), &unpinned) == 0;
+  });
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set); err != 0) {
+    BOOST_LOG_TRIVIAL(warning) << "Failed to pin thread to cpu " << cpu << ", error: " << strerror(err);
+    return false;
+  }
+  BOOST_LOG_TRIVIAL(info) << "Thread pinned to cpu " << cpu;
+  return true;
+}
+
+UnpinnedScope::UnpinnedScope() {
+  if (!unpinnedKnown || pthread_getaffinity_np(pthread_self(), sizeof(pinned), &pinned) != 0) {
+    return;
+  }
+  restore = !CPU_EQUAL(&pinned, &unpinned) && pthread_setaffinity_np(pthread_self(), sizeof(unpinned), &unpinned) == 0;
+}
+
+UnpinnedScope::~UnpinnedScope() {
+  if (restore) {
+    pthread_setaffinity_np(pthread_self(), sizeof(pinned), &pinned);
+  }
+}
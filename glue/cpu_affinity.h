@@ -0,0 +1,22 @@
+#ifndef CPU_AFFINITY_H
+#define CPU_AFFINITY_H
+
+#include <sched.h>
+
+// Pins the calling thread to the given core. It returns false if it fails, negative cpu is a no-op.
+bool pinCurrentThread(int cpu);
+
+// Lets the calling thread run on the cores it could before it was pinned, till the end of the
+// scope, so that the threads it starts meanwhile don't inherit its core. A no-op if it isn't pinned.
+class UnpinnedScope {
+public:
+  UnpinnedScope();
+  ~UnpinnedScope();
+  UnpinnedScope(UnpinnedScope const &) = delete;
+  UnpinnedScope& operator=(UnpinnedScope const &) = delete;
+private:
+  cpu_set_t pinned;
+  bool restore = false;
+};
+
+#endif
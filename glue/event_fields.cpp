@@ -0,0 +1,15 @@
+#include "event_fields.h"
+
+#include <stdexcept>
+
+unsigned parseEventField(std::string const &name) {
+  if (name == "path") return EF_PATH;
+  if (name == "name") return EF_NAME;
+  if (name == "mask") return EF_MASK;
+  if (name == "cookie") return EF_COOKIE;
+  if (name == "catchup") return EF_CATCHUP;
+  if (name == "tail") return EF_TAIL;
+  if (name == "xxh64") return EF_XXH64;
+  if (name == "delta") return EF_DELTA;
+  throw std::runtime_error("Unknown field: " + name);
+}
@@ -0,0 +1,33 @@
+#ifndef EVENT_FIELDS_H
+#define EVENT_FIELDS_H
+
+#include <cstdint>
+#include <string>
+
+// Fields of an event sent to a subscriber, all of them unless it asks for some,
+// e.g. {"command": "subscribe", "mask": 8, "fields": ["path", "name"]}
+constexpr unsigned EF_PATH = 1 << 0;    // or pathId, with pathIds
+constexpr unsigned EF_NAME = 1 << 1;
+constexpr unsigned EF_MASK = 1 << 2;
+constexpr unsigned EF_COOKIE = 1 << 3;
+constexpr unsigned EF_CATCHUP = 1 << 4;
+constexpr unsigned EF_TAIL = 1 << 5;    // offset, data, truncated and rotated of NB_TAIL events
+constexpr unsigned EF_XXH64 = 1 << 6;
+constexpr unsigned EF_DELTA = 1 << 7;   // size, blockSize, changed and moved of NB_DELTA events
+constexpr unsigned EF_ALL = (1 << 8) - 1;
+
+// it throws on an unknown name
+unsigned parseEventField(std::string const &name);
+
+// What of an event a subscriber gets. Events are rendered once per projection
+struct Projection {
+  unsigned fields = EF_ALL;
+  unsigned metadata = ~0u; // MD_* bits, of those gathered
+  uint32_t mask = 0;       // rendered instead of the event's, that of conflated events; 0 - the event's
+};
+
+inline bool operator==(Projection const &a, Projection const &b) {
+  return a.fields == b.fields && a.metadata == b.metadata && a.mask == b.mask;
+}
+
+#endif
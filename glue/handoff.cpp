@@ -0,0 +1,206 @@
+#include "handoff.h"
+
+#include <boost/log/trivial.hpp>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char takeOverRequest[] = "notibeast-takeover-1";
+constexpr uint32_t handoffMagic = 0x4e424831; // "NBH1"
+constexpr char takeOverAck = 'K';
+constexpr int handoffFdCount = 2;
+
+struct Header {
+  uint32_t magic;
+  uint32_t watchCount;
+  uint64_t payloadSize;
+};
+
+[[noreturn]] void throwError(std::string const &what) {
+  std::stringstream sstr;
+  sstr << what << ", error: " << strerror(errno);
+  BOOST_LOG_TRIVIAL(error) << sstr.str();
+  throw std::runtime_error(sstr.str());
+}
+
+void writeAll(int fd, void const *buf, size_t len) {
+  auto p = static_cast<char const *>(buf);
+  while (len) {
+    auto n = send(fd, p, len, MSG_NOSIGNAL);
+    if (n == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throwError("Handoff write failed");
+    }
+    p += n;
+    len -= n;
+  }
+}
+
+void readAll(int fd, void *buf, size_t len) {
+  auto p = static_cast<char *>(buf);
+  while (len) {
+    auto n = read(fd, p, len);
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      if (n == 0) {
+        errno = ECONNRESET;
+      }
+      throwError("Handoff read failed");
+    }
+    p += n;
+    len -= n;
+  }
+}
+
+sockaddr_un makeAddress(std::string const &socketPath) {
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(addr.sun_path)) {
+    throw std::runtime_error("Handoff socket path is too long: " + socketPath);
+  }
+  memcpy(addr.sun_path, socketPath.c_str(), socketPath.size() + 1);
+  return addr;
+}
+
+} //namespace
+
+std::optional<HandoffState> takeOver(std::string const &socketPath) {
+  auto addr = makeAddress(socketPath);
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd == -1) {
+    throwError("Can't create handoff socket");
+  }
+  if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == -1) {
+    if (errno == ENOENT || errno == ECONNREFUSED) {
+      BOOST_LOG_TRIVIAL(info) << "No running instance listens on " << socketPath << ", starting from scratch";
+      close(fd);
+      return {};
+    }
+    close(fd);
+    throwError("Can't connect to handoff socket " + socketPath);
+  }
+
+  HandoffState res;
+  try {
+    BOOST_LOG_TRIVIAL(info) << "Taking over from the instance listening on " << socketPath;
+    writeAll(fd, takeOverRequest, sizeof(takeOverRequest));
+
+    Header header;
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * handoffFdCount)];
+    iovec iov{&header, sizeof(header)};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t n;
+    while ((n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC)) == -1 && errno == EINTR) {}
+    if (n <= 0) {
+      throwError("Failed to receive handoff descriptors");
+    }
+    // the descriptors arrive with the first byte, the rest of the header may lag behind
+    readAll(fd, reinterpret_cast<char *>(&header) + n, sizeof(header) - n);
+
+    auto cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS
+        || cmsg->cmsg_len != CMSG_LEN(sizeof(int) * handoffFdCount)) {
+      throw std::runtime_error("Handoff message carries no descriptors");
+    }
+    int fds[handoffFdCount];
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    res.acceptorFd = fds[0];
+    res.inotifyFd = fds[1];
+    if (header.magic != handoffMagic) {
+      throw std::runtime_error("Unexpected handoff message");
+    }
+
+    std::string payload(header.payloadSize, '\0');
+    readAll(fd, payload.data(), payload.size());
+    res.watches.reserve(header.watchCount);
+    size_t pos = 0;
+    for (uint32_t i = 0; i < header.watchCount; ++i) {
+      int32_t wd;
+      uint32_t len;
+      if (pos + sizeof(wd) + sizeof(len) > payload.size()) {
+        throw std::runtime_error("Truncated handoff watch registry");
+      }
+      memcpy(&wd, payload.data() + pos, sizeof(wd));
+      memcpy(&len, payload.data() + pos + sizeof(wd), sizeof(len));
+      pos += sizeof(wd) + sizeof(len);
+      if (pos + len > payload.size()) {
+        throw std::runtime_error("Truncated handoff watch registry");
+      }
+      res.watches.emplace_back(wd, payload.substr(pos, len));
+      pos += len;
+    }
+
+    writeAll(fd, &takeOverAck, sizeof(takeOverAck));
+  } catch (...) {
+    close(fd);
+    if (res.acceptorFd != -1) close(res.acceptorFd);
+    if (res.inotifyFd != -1) close(res.inotifyFd);
+    throw;
+  }
+  close(fd);
+  BOOST_LOG_TRIVIAL(info) << "Took over " << res.watches.size() << " watches";
+  return res;
+}
+
+void handOver(int connFd, HandoffState const &state) {
+  // don't hang forever on a successor which got stuck
+  timeval timeout{5, 0};
+  setsockopt(connFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  char request[sizeof(takeOverRequest)];
+  readAll(connFd, request, sizeof(request));
+  if (memcmp(request, takeOverRequest, sizeof(request)) != 0) {
+    throw std::runtime_error("Unexpected takeover request");
+  }
+
+  std::string payload;
+  for (auto &[wd, path]: state.watches) {
+    int32_t wd32 = wd;
+    uint32_t len = path.size();
+    payload.append(reinterpret_cast<char const *>(&wd32), sizeof(wd32));
+    payload.append(reinterpret_cast<char const *>(&len), sizeof(len));
+    payload += path;
+  }
+  Header header{handoffMagic, uint32_t(state.watches.size()), payload.size()};
+
+  int fds[handoffFdCount] = {state.acceptorFd, state.inotifyFd};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))] = {};
+  iovec iov{&header, sizeof(header)};
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  auto cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+  ssize_t n;
+  while ((n = sendmsg(connFd, &msg, MSG_NOSIGNAL)) == -1 && errno == EINTR) {}
+  if (n == -1) {
+    throwError("Failed to send handoff descriptors");
+  }
+  writeAll(connFd, reinterpret_cast<char const *>(&header) + n, sizeof(header) - n);
+  writeAll(connFd, payload.data(), payload.size());
+
+  char ack;
+  readAll(connFd, &ack, sizeof(ack));
+  if (ack != takeOverAck) {
+    throw std::runtime_error("Successor didn't confirm the takeover");
+  }
+  BOOST_LOG_TRIVIAL(info) << "Handed over " << state.watches.size() << " watches";
+}
@@ -0,0 +1,26 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Zero-downtime upgrades: the running instance hands its listening socket, inotify
+// descriptor and watch registry over to its successor with SCM_RIGHTS, so the
+// successor doesn't have to add a single watch.
+struct HandoffState {
+  int acceptorFd = -1;
+  int inotifyFd = -1;
+  std::vector<std::pair<int, std::string>> watches; // watch descriptor -> watched directory
+};
+
+// Successor side. Returns an empty optional if no instance listens on socketPath,
+// throws if the handoff fails half way
+std::optional<HandoffState> takeOver(std::string const &socketPath);
+
+// Predecessor side, serves a takeover request on an accepted connection.
+// Returns once the successor confirmed it took over, throws on error.
+void handOver(int connFd, HandoffState const &state);
+
+#endif
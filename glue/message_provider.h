@@ -1,13 +1,25 @@
 #ifndef MESSAGE_PROVIDER_H
 #define MESSAGE_PROVIDER_H
 
+#include <ostream>
 #include <string>
+#include "handoff.h"
+#include "options.h"
 
 class MessageProvider {
 public:
   virtual ~MessageProvider () = 0;
-  virtual void logFiltered(std::string const &ss, int filteringMask) const = 0;
   virtual void logSubscribing(int mask) const = 0;
+  // Zero-downtime upgrades: suspend() stops producing messages and fills in what a successor
+  // needs to continue, resume() carries on if the takeover failed
+  virtual bool suspend([[maybe_unused]] HandoffState &state) { return false; }
+  virtual void resume() {}
+  // Applies changed options without a restart, returns false if it isn't supported
+  virtual bool reconfigure([[maybe_unused]] Options const &options) { return false; }
+  // The metadata fields (MD_* bits) any of the subscribers asks for, nothing else is to be gathered
+  virtual void requestMetadata([[maybe_unused]] unsigned fields) {}
+  // Appends the provider's metrics in Prometheus text format
+  virtual void reportMetrics([[maybe_unused]] std::ostream &out) const {}
 };
 
 inline MessageProvider::~MessageProvider() = default;
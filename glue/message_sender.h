@@ -1,13 +1,60 @@
 #ifndef MESSAGE_SENDER_H
 #define MESSAGE_SENDER_H
 
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <string_view>
+#include <vector>
+#include "event_fields.h"
+#include "wire_format.h"
+
+// What is rendered of a message. Sessions subscribing with "pathIds" get the directory
+// of a message as an id, defined by a record of its own the first time they need it
+enum class Rendering {
+  full,           // the message as it is
+  pathId,         // the message with the id of its directory instead of the path
+  pathDefinition, // the id and the path of the directory of the message
+  pathReset       // ids defined so far are forgotten
+};
+
+constexpr size_t renderingCount = 4;
+
+// Replaces out with the message in the given format, with the fields of the projection
+using MessageRenderer = std::function<void(std::string &out, WireFormat format, Rendering rendering,
+                                           Projection const &projection)>;
+
+// A message of a batch, see MessageSender::send()
+struct OutgoingMessage {
+  MessageRenderer render;
+  int mask = 0;
+  uint32_t pathId = 0;
+  std::string_view name;
+};
 
 class MessageSender {
 protected:
   virtual ~MessageSender() = 0;
 public:
-  virtual void send(std::string message, int mask) const = 0;
+  // The message is rendered once per format and projection the subscribers asked for, however many they are.
+  // pathId is the id of the directory of the message, 0 if it has none. A message with a name may be
+  // conflated with one waiting about the same name in the same directory, for a client falling behind
+  virtual void send(MessageRenderer const &render, int mask, uint32_t pathId, std::string_view name) const = 0;
+  // Same as send() for each of the messages, in order, but a session is handed its part of the
+  // whole batch at once, instead of one message at a time
+  virtual void send(std::vector<OutgoingMessage> const &batch) const {
+    for (auto const &m : batch) {
+      send(m.render, m.mask, m.pathId, m.name);
+    }
+  }
+  // Same as send(), but the message is also delivered to sessions subscribing later on.
+  // Those get it in full, the ids are long gone by then
+  virtual void sendRetained(MessageRenderer render, int mask) const = 0;
+
+  // A message which is the same in any format
+  void send(std::string const &message, int mask) const {
+    send([&message](std::string &out, WireFormat, Rendering, Projection const &) { out = message; }, mask, 0, {});
+  }
 };
 
 inline MessageSender::~MessageSender() = default;
@@ -0,0 +1,24 @@
+#include "metadata_fields.h"
+
+#include <stdexcept>
+#include <sys/stat.h>
+
+unsigned parseMetadataField(std::string const &name) {
+  if (name == "size") return MD_SIZE;
+  if (name == "mtime") return MD_MTIME;
+  if (name == "ino") return MD_INO;
+  if (name == "type") return MD_TYPE;
+  if (name == "mode") return MD_MODE;
+  if (name == "uid") return MD_UID;
+  if (name == "gid") return MD_GID;
+  throw std::runtime_error("Unknown metadata field: " + name);
+}
+
+std::string_view fileTypeName(uint32_t mode) {
+  switch (mode & S_IFMT) {
+    case S_IFREG: return "file";
+    case S_IFDIR: return "dir";
+    case S_IFLNK: return "symlink";
+    default: return "other";
+  }
+}
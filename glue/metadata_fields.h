@@ -0,0 +1,24 @@
+#ifndef METADATA_FIELDS_H
+#define METADATA_FIELDS_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Metadata of the file of an event, sent along with it if a subscriber asks for it,
+// e.g. {"command": "subscribe", "mask": 8, "metadata": ["size", "mtime"]}
+constexpr unsigned MD_SIZE = 1 << 0;
+constexpr unsigned MD_MTIME = 1 << 1; // nanoseconds since the epoch
+constexpr unsigned MD_INO = 1 << 2;
+constexpr unsigned MD_TYPE = 1 << 3;  // "file", "dir", "symlink" or "other"
+constexpr unsigned MD_MODE = 1 << 4;  // permission bits
+constexpr unsigned MD_UID = 1 << 5;
+constexpr unsigned MD_GID = 1 << 6;
+
+// it throws on an unknown name
+unsigned parseMetadataField(std::string const &name);
+
+// MD_TYPE of st_mode
+std::string_view fileTypeName(uint32_t mode);
+
+#endif
@@ -12,7 +12,44 @@ std::ostream& operator <<(std::ostream& s, const Options &o) {
     s << sep; sep = ", ";
     s << p;
   }
-  s << "], logSeverity: " << o.logSeverity;
+  s << "], stateFile: " << o.stateFile
+    << ", stateInterval: " << o.stateInterval
+    << ", catchupRetention: " << o.catchupRetention
+    << ", handoffSocket: " << o.handoffSocket
+    << ", configFile: " << o.configFile
+    << ", adminToken: " << (o.adminToken.empty() ? "" : "(set)")
+    << ", schedulingClasses: [";
+  sep = "";
+  for(auto &c: o.schedulingClasses) {
+    s << sep; sep = ", ";
+    s << c;
+  }
+  s << "], lowLatency: " << o.lowLatency
+    << ", inotifyCpu: " << o.inotifyCpu
+    << ", ioCpu: " << o.ioCpu
+    << ", tailPatterns: [";
+  sep = "";
+  for(auto &t: o.tailPatterns) {
+    s << sep; sep = ", ";
+    s << t;
+  }
+  s << "], tailChunk: " << o.tailChunk
+    << ", hash: " << o.hash
+    << ", hashThreads: " << o.hashThreads
+    << ", deltaPatterns: [";
+  sep = "";
+  for(auto &d: o.deltaPatterns) {
+    s << sep; sep = ", ";
+    s << d;
+  }
+  s << "], deltaStore: " << o.deltaStore
+    << ", deltaBlock: " << o.deltaBlock
+    << ", deltaData: " << o.deltaData
+    << ", symbolicMask: " << o.symbolicMask
+    << ", queueBytes: " << o.queueBytes
+    << ", queueTotalBytes: " << o.queueTotalBytes
+    << ", threads: " << o.threads
+    << ", logSeverity: " << o.logSeverity;
   return s;
 }
 
@@ -2,16 +2,45 @@
 #define OPTIONS_H
 
 #include <boost/log/trivial.hpp>
+#include <functional>
 #include <ostream>
+#include <string>
+#include <vector>
 
+// Defaults are those of the command line, see cl_parser.cpp
 struct Options {
-  std::string address;
-  std::string port;
+  std::string address = "0.0.0.0";
+  std::string port = "8080";
   std::string pathToMonitor;
   std::vector<std::string> pathsToExclude;
-  boost::log::trivial::severity_level logSeverity;
+  std::string stateFile;
+  unsigned stateInterval = 300;
+  unsigned catchupRetention = 600;
+  std::string handoffSocket;
+  std::string configFile;
+  std::string adminToken;
+  std::vector<std::string> schedulingClasses;
+  bool lowLatency = false;
+  int inotifyCpu = -1;
+  int ioCpu = -1;
+  std::vector<std::string> tailPatterns;
+  size_t tailChunk = 64 * 1024;
+  bool hash = false;
+  unsigned hashThreads = 2;
+  std::vector<std::string> deltaPatterns;
+  std::string deltaStore = "/var/lib/notibeast/signatures";
+  unsigned deltaBlock = 64 * 1024;
+  bool deltaData = false;
+  bool symbolicMask = false;
+  size_t queueBytes = 4 << 20;
+  size_t queueTotalBytes = 64 << 20;
+  unsigned threads = 1;
+  boost::log::trivial::severity_level logSeverity = boost::log::trivial::info;
 };
 
+// Reads the options again, e.g. after the config file changed. It throws on error.
+using OptionsLoader = std::function<Options()>;
+
 namespace std {
 // looks like placing it inside std is the only way
 // to have BOOST_LOG recognize it
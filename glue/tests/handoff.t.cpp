@@ -0,0 +1,115 @@
+#include "glue/handoff.h"
+#include "i_notify.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "helper.h"
+
+using namespace std::this_thread; // sleep_for, sleep_until
+using namespace std::chrono; // nanoseconds, system_clock, seconds
+
+namespace {
+
+int listenOn(fs::path const &path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  REQUIRE(bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0);
+  REQUIRE(listen(fd, 1) == 0);
+  return fd;
+}
+
+} //namespace
+
+SCENARIO("Handing the state over to a successor") {
+  GIVEN("An instance watching a tmp dir") {
+    init_logging();
+    auto ph = createTempDir("test_handoff_");
+    auto socketPath = ph / "handoff.sock";
+    fs::create_directory(ph / "watched");
+
+    std::vector<NotifyEvent> events;
+    std::mutex mtx;
+    auto callback=[&events, &mtx](NotifyEvent event){
+      std::lock_guard<std::mutex> lg(mtx);
+      events.push_back(event);
+    };
+
+    // a pipe stands in for the listening socket
+    int pipeFds[2];
+    REQUIRE(pipe(pipeFds) == 0);
+
+    auto predecessor = std::make_unique<INotify>(callback);
+    int wd = predecessor->monitorPath(ph / "watched");
+    predecessor->stop();
+
+    HandoffState state;
+    state.acceptorFd = pipeFds[0];
+    state.inotifyFd = predecessor->descriptor();
+    state.watches.emplace_back(wd, (ph / "watched").string());
+
+    WHEN("A successor takes over") {
+      int listenFd = listenOn(socketPath);
+      bool handedOver = false;
+      std::thread server([&]() {
+        int conn = accept(listenFd, nullptr, nullptr);
+        try {
+          handOver(conn, state);
+          handedOver = true;
+        } catch (std::exception const&) {
+        }
+        close(conn);
+      });
+      auto inherited = takeOver(socketPath);
+      server.join();
+      close(listenFd);
+      // the predecessor exits
+      predecessor.reset();
+      close(pipeFds[0]);
+
+      THEN("It gets working descriptors and the watch registry") {
+        REQUIRE(handedOver);
+        REQUIRE(inherited);
+        REQUIRE(inherited->watches.size() == 1);
+        CHECK(inherited->watches[0].first == wd);
+        CHECK(inherited->watches[0].second == (ph / "watched").string());
+
+        REQUIRE(write(pipeFds[1], "x", 1) == 1);
+        char c = 0;
+        REQUIRE(read(inherited->acceptorFd, &c, 1) == 1);
+        CHECK(c == 'x');
+        close(inherited->acceptorFd);
+
+        INotify successor(callback, inherited->inotifyFd);
+        successor.start();
+        fs::create_directory(ph / "watched" / "foo");
+        sleep_for(milliseconds(10));
+
+        std::lock_guard<std::mutex> lg(mtx);
+        REQUIRE(events.size() == 1);
+        CHECK(events[0].wd == wd);
+        CHECK(events[0].mask == (IN_CREATE | IN_ISDIR));
+        CHECK(events[0].name == "foo");
+      }
+    }
+
+    WHEN("Nobody listens on the handoff socket") {
+      auto inherited = takeOver(socketPath);
+      THEN("The instance starts from scratch") {
+        CHECK_FALSE(inherited);
+      }
+      close(pipeFds[0]);
+    }
+    close(pipeFds[1]);
+    fs::remove_all(ph);
+  }
+}
@@ -0,0 +1,29 @@
+#include "wire_format.h"
+
+#include <stdexcept>
+
+WireFormat parseWireFormat(std::string const &name) {
+  if (name == "json") return WireFormat::json;
+  if (name == "cbor") return WireFormat::cbor;
+  throw std::runtime_error("Unknown format: " + name);
+}
+
+void appendGap(std::string &out, WireFormat format, uint64_t dropped) {
+  if (format == WireFormat::json) {
+    out += "{\"gap\":" + std::to_string(dropped) + "}\n";
+    return;
+  }
+  constexpr uint8_t gapKey = 23; // CK_GAP
+  out += char(0xa1); // a map of one pair
+  out += char(gapKey);
+  // an unsigned in its shortest encoding
+  if (dropped < 24) {
+    out += char(dropped);
+    return;
+  }
+  int info = dropped <= 0xff ? 24 : dropped <= 0xffff ? 25 : dropped <= 0xffffffff ? 26 : 27;
+  out += char(info);
+  for (int i = (1 << (info - 24)) - 1; i >= 0; --i) {
+    out += char((dropped >> (8 * i)) & 0xff);
+  }
+}
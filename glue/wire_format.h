@@ -0,0 +1,28 @@
+#ifndef WIRE_FORMAT_H
+#define WIRE_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// How events are encoded for a subscriber, chosen with its subscription,
+// e.g. {"command": "subscribe", "mask": 8, "format": "cbor"}
+enum class WireFormat {
+  json, // a line of text per message, sent as text frames
+  cbor  // a CBOR map with small integer keys (see notify/event_cbor.h), sent as binary frames
+};
+
+constexpr size_t wireFormatCount = 2;
+
+constexpr bool isBinary(WireFormat format) {
+  return format != WireFormat::json;
+}
+
+// it throws on an unknown name
+WireFormat parseWireFormat(std::string const &name);
+
+// Appends the record telling a client too far behind that it missed that many messages
+// right there: {"gap":17} and a new line, or {CK_GAP: 17} (see notify/event_cbor.h)
+void appendGap(std::string &out, WireFormat format, uint64_t dropped);
+
+#endif
@@ -5,6 +5,7 @@
 #include <algorithm>
 
 #include "glue/options.h"
+#include "glue/handoff.h"
 #include "beast/service.hpp"
 #include "logging.h"
 #include "cl_parser.h"
@@ -29,7 +30,23 @@ int main(int argc, char** argv) {
     }
     BOOST_LOG_TRIVIAL(info) << "Run service with parameters: '" << options << "'\n";
     setSeverityLevel(options->logSeverity);
-    runService(*options, RecursiveINotifyFactory{*options});
+    HandoffState inherited;
+    if (!options->handoffSocket.empty()) {
+      if (auto state = takeOver(options->handoffSocket)) {
+        inherited = std::move(*state);
+      }
+    }
+    OptionsLoader reloadOptions;
+    if (!options->configFile.empty()) {
+      reloadOptions = [argc, argv]() {
+        auto reloaded = parseCommandLine(argc, argv);
+        if (!reloaded) {
+          throw std::runtime_error("Failed to reload options");
+        }
+        return *reloaded;
+      };
+    }
+    runService(*options, RecursiveINotifyFactory{*options, inherited}, inherited.acceptorFd, reloadOptions);
   }
   catch(std::exception& e) {
       BOOST_LOG_TRIVIAL(error) << "error: " << e.what();
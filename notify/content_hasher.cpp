@@ -0,0 +1,259 @@
+#include "content_hasher.h"
+#include "xxhash64.h"
+
+#include <algorithm>
+#include <boost/log/trivial.hpp>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace {
+
+enum class Outcome { Hashed, Changed, Failed };
+
+struct Result {
+  Outcome outcome;
+  uint64_t digest = 0;
+  uint64_t bytes = 0;
+};
+
+bool sameFile(struct stat const &a, struct stat const &b) {
+  return a.st_ino == b.st_ino && a.st_size == b.st_size
+    && a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+}
+
+// Large sequential reads rather than mmap: a file truncated under a mapping kills us with SIGBUS
+Result hashFile(std::string const &file, std::vector<char> &buffer, std::atomic<bool> const &cancelled,
+                DeltaTracker::Pass *pass) {
+  int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    BOOST_LOG_TRIVIAL(debug) << "Can't open " << file << " for hashing, error: " << strerror(errno);
+    return {Outcome::Failed};
+  }
+  struct stat before, after;
+  if (fstat(fd, &before) == -1 || !S_ISREG(before.st_mode)) {
+    close(fd);
+    return {Outcome::Failed};
+  }
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  XXHash64 hash;
+  Result res{Outcome::Hashed};
+  for (;;) {
+    if (cancelled) {
+      close(fd);
+      return {Outcome::Changed};
+    }
+    auto n = read(fd, buffer.data(), buffer.size());
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+    if (n == -1) {
+      BOOST_LOG_TRIVIAL(debug) << "Failed to read " << file << " for hashing, error: " << strerror(errno);
+      close(fd);
+      return {Outcome::Failed};
+    }
+    if (n == 0) {
+      break;
+    }
+    hash.update(buffer.data(), n);
+    if (pass) {
+      pass->update(buffer.data(), n);
+    }
+    res.bytes += n;
+  }
+  auto changed = fstat(fd, &after) == -1 || !sameFile(before, after);
+  close(fd);
+  if (changed) {
+    return {Outcome::Changed};
+  }
+  res.digest = hash.digest();
+  return res;
+}
+
+} //namespace
+
+ContentHasher::ContentHasher(HashOptions options, std::function<void(RecursiveNotifyEvent)> fn, DeltaTracker const *delta):
+  options{std::move(options)},
+  fn{std::move(fn)},
+  delta{delta}
+{
+  for (unsigned i = 0; i < this->options.threads; ++i) {
+    workers.emplace_back([this]() { work(); });
+  }
+}
+
+ContentHasher::~ContentHasher() {
+  {
+    std::lock_guard<std::mutex> lck(mtx);
+    stopping = true;
+    for (auto &[file, job]: jobs) {
+      job.cancelled = true;
+    }
+  }
+  cv.notify_all();
+  for (auto &th: workers) {
+    th.join();
+  }
+  for (auto &file: queue) {
+    fn(std::move(jobs.at(file).rne));
+  }
+}
+
+void ContentHasher::submit(std::string const &file, RecursiveNotifyEvent rne) {
+  std::unique_lock<std::mutex> lck(mtx);
+  auto it = find(lck, file);
+  if (it != end(jobs) && it->second.dropped) {
+    // a new file by that name, being read already
+    it->second.rne = std::move(rne);
+    it->second.attempts = 0;
+    it->second.dropped = false;
+    it->second.cancelled = true;
+    return;
+  }
+  if (it != end(jobs)) {
+    // the digest of the older content is of no use anymore
+    auto superseded = std::exchange(it->second.rne, std::move(rne));
+    it->second.attempts = 0;
+    it->second.cancelled = it->second.running;
+    ++skipped;
+    lck.unlock();
+    fn(std::move(superseded));
+    return;
+  }
+  if (jobs.size() >= options.maxQueued) {
+    ++skipped;
+    lck.unlock();
+    BOOST_LOG_TRIVIAL(debug) << "Hashing queue is full, " << file << " isn't hashed";
+    fn(std::move(rne));
+    return;
+  }
+  jobs[file].rne = std::move(rne);
+  queue.push_back(file);
+  lck.unlock();
+  cv.notify_one();
+}
+
+void ContentHasher::touch(std::string const &file) {
+  std::lock_guard<std::mutex> lck(mtx);
+  auto it = jobs.find(file);
+  if (it != end(jobs) && it->second.running) {
+    it->second.cancelled = true;
+  }
+}
+
+void ContentHasher::drop(std::string const &file) {
+  std::unique_lock<std::mutex> lck(mtx);
+  auto it = find(lck, file);
+  if (it == end(jobs) || it->second.dropped) {
+    return;
+  }
+  auto rne = std::move(it->second.rne);
+  ++skipped;
+  if (it->second.running) {
+    it->second.dropped = true;
+    it->second.cancelled = true;
+  } else {
+    queue.erase(std::find(begin(queue), end(queue), file));
+    jobs.erase(it);
+  }
+  lck.unlock();
+  fn(std::move(rne));
+}
+
+std::unordered_map<std::string, ContentHasher::Job>::iterator
+ContentHasher::find(std::unique_lock<std::mutex> &lck, std::string const &file) {
+  auto it = jobs.find(file);
+  while (it != end(jobs) && it->second.publishing) {
+    published.wait(lck);
+    it = jobs.find(file);
+  }
+  return it;
+}
+
+void ContentHasher::work() {
+  std::vector<char> buffer(options.readSize);
+  std::unique_lock<std::mutex> lck(mtx);
+  for (;;) {
+    cv.wait(lck, [this]{ return stopping || !queue.empty(); });
+    if (stopping) {
+      return;
+    }
+    auto file = std::move(queue.front());
+    queue.pop_front();
+    auto &job = jobs.at(file); // references to unordered_map elements survive rehashing
+    job.running = true;
+    ++job.attempts;
+    lck.unlock();
+
+    auto start = std::chrono::steady_clock::now();
+    auto pass = delta && delta->matches(file) ? delta->begin(file) : nullptr;
+    auto res = hashFile(file, buffer, job.cancelled, pass.get());
+    std::chrono::duration<double> busy = std::chrono::steady_clock::now() - start;
+
+    lck.lock();
+    busySeconds += busy.count();
+    hashedBytes += res.bytes;
+    job.running = false;
+    if (job.dropped) {
+      jobs.erase(file);
+      continue;
+    }
+    // written to again before we're done, the digest may be of the older content
+    auto changed = res.outcome == Outcome::Changed || job.cancelled;
+    if (changed && !stopping && job.attempts < options.maxAttempts) {
+      BOOST_LOG_TRIVIAL(debug) << file << " is being written to, hashing it later";
+      job.cancelled = false;
+      queue.push_back(std::move(file));
+      ++rescheduled;
+      continue;
+    }
+    // kept till it's published, so that it comes before whatever drop publishes
+    auto rne = std::move(job.rne);
+    job.publishing = true;
+    if (res.outcome == Outcome::Hashed && !changed) {
+      rne.hash = res.digest;
+      ++hashedFiles;
+    } else {
+      ++skipped;
+      pass.reset();
+    }
+    lck.unlock();
+    if (pass) {
+      fn(RecursiveNotifyEvent{.mask = NB_DELTA, .cookie = 0, .path = rne.path, .name = rne.name,
+                              .pathId = rne.pathId, .delta = pass->finish()});
+    }
+    fn(std::move(rne));
+    lck.lock();
+    jobs.erase(file);
+    published.notify_all();
+  }
+}
+
+void ContentHasher::reportMetrics(std::ostream &out) const {
+  std::lock_guard<std::mutex> lck(mtx);
+  out << "# HELP notibeast_hash_queue_depth Files waiting to be hashed\n"
+      << "# TYPE notibeast_hash_queue_depth gauge\n"
+      << "notibeast_hash_queue_depth " << queue.size() << "\n"
+      << "# HELP notibeast_hash_running Files being hashed\n"
+      << "# TYPE notibeast_hash_running gauge\n"
+      << "notibeast_hash_running " << jobs.size() - queue.size() << "\n"
+      << "# HELP notibeast_hashed_files_total Events published with a digest\n"
+      << "# TYPE notibeast_hashed_files_total counter\n"
+      << "notibeast_hashed_files_total " << hashedFiles << "\n"
+      << "# HELP notibeast_hashed_bytes_total Bytes read for hashing\n"
+      << "# TYPE notibeast_hashed_bytes_total counter\n"
+      << "notibeast_hashed_bytes_total " << hashedBytes << "\n"
+      << "# HELP notibeast_hash_busy_seconds_total Time the workers spent hashing\n"
+      << "# TYPE notibeast_hash_busy_seconds_total counter\n"
+      << "notibeast_hash_busy_seconds_total " << busySeconds << "\n"
+      << "# HELP notibeast_hash_rescheduled_total Files read again as they changed while being hashed\n"
+      << "# TYPE notibeast_hash_rescheduled_total counter\n"
+      << "notibeast_hash_rescheduled_total " << rescheduled << "\n"
+      << "# HELP notibeast_hash_skipped_total Events published without a digest: superseded, queue full or file gone\n"
+      << "# TYPE notibeast_hash_skipped_total counter\n"
+      << "notibeast_hash_skipped_total " << skipped << "\n";
+}
@@ -0,0 +1,87 @@
+#ifndef CONTENT_HASHER_H
+#define CONTENT_HASHER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "delta_tracker.h"
+#include "recursive_notify_event.h"
+
+struct HashOptions {
+  unsigned threads = 0;          // 0: no hashing
+  size_t maxQueued = 10000;      // files waiting for a worker, events beyond are published without a digest
+  size_t readSize = 1024 * 1024; // bytes per read
+  unsigned maxAttempts = 3;      // a file still changing after that many attempts is published without a digest
+  bool everyFile = true;         // false: files tracked for deltas only
+};
+
+// Attaches the XXH64 digest of the file content to IN_CLOSE_WRITE events.
+// Files are read on a pool of worker threads, so the inotify reader isn't held up;
+// an event is published once its file is hashed.
+// A file written to again while it's being read is read again later,
+// a newer IN_CLOSE_WRITE of a queued file supersedes the older one, which is published without a digest.
+// The events of a file removed or moved away are published without a digest, see drop.
+// Files tracked by delta get an NB_DELTA event published right before their IN_CLOSE_WRITE,
+// it's worked out in the same pass.
+// NOTE: fn is invoked from the worker threads.
+class ContentHasher {
+public:
+  ContentHasher(HashOptions options, std::function<void(RecursiveNotifyEvent)> fn, DeltaTracker const *delta = nullptr);
+  // publishes whatever is still queued, without a digest
+  ~ContentHasher();
+  ContentHasher(ContentHasher const &) = delete;
+  ContentHasher& operator=(ContentHasher const&) = delete;
+
+  // rne is to be published once file is hashed
+  void submit(std::string const &file, RecursiveNotifyEvent rne);
+  // file is written to, reading it now would be a waste
+  void touch(std::string const &file);
+  // file is removed or moved away, its IN_CLOSE_WRITE is published before this returns,
+  // so that it comes before the event of that
+  void drop(std::string const &file);
+
+  // queue depth and throughput, in Prometheus text format
+  void reportMetrics(std::ostream &out) const;
+
+private:
+  struct Job {
+    RecursiveNotifyEvent rne;
+    unsigned attempts = 0;
+    bool running = false;
+    std::atomic<bool> cancelled{false};
+    bool dropped = false;    // rne is published already, the worker leaves it at that
+    bool publishing = false; // by the worker, rne is moved from
+  };
+
+  HashOptions options;
+  std::function<void(RecursiveNotifyEvent)> fn;
+  DeltaTracker const *delta;
+  std::unordered_map<std::string, Job> jobs;
+  std::deque<std::string> queue; // files of the jobs which aren't running
+  mutable std::mutex mtx;
+  std::condition_variable cv;
+  std::condition_variable published;
+  bool stopping = false;
+  std::vector<std::thread> workers;
+
+  uint64_t hashedFiles = 0;
+  uint64_t hashedBytes = 0;
+  uint64_t rescheduled = 0;
+  uint64_t skipped = 0;
+  double busySeconds = 0;
+
+  // The job of file, unless the worker is publishing it
+  std::unordered_map<std::string, Job>::iterator find(std::unique_lock<std::mutex> &lck, std::string const &file);
+  void work();
+};
+
+#endif
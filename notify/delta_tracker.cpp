@@ -0,0 +1,299 @@
+#include "delta_tracker.h"
+
+#include <boost/log/trivial.hpp>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+namespace {
+
+constexpr char storeMagic[8] = {'N', 'B', 'S', 'I', 'G', 'S', '\0', '\1'};
+
+struct Header {
+  char magic[8];
+  uint32_t blockSize;
+  uint32_t pathLength; // the path follows the signatures
+  uint64_t fileSize;
+  uint64_t blockCount;
+};
+
+uint32_t weakOf(uint32_t a, uint32_t b) {
+  return (a & 0xffff) | (b << 16);
+}
+
+// Appends data to the checksum of a block, a += x; b += a for every byte.
+// Done as two plain sums, so the compiler can vectorize them.
+void checksum(unsigned char const *data, size_t len, uint32_t &a, uint32_t &b) {
+  constexpr size_t stride = 4096; // the weights fit into 32 bits
+  while (len) {
+    auto n = std::min(len, stride);
+    uint32_t sum = 0, weighted = 0;
+    for (size_t i = 0; i < n; ++i) {
+      sum += data[i];
+      weighted += uint32_t(n - i) * data[i];
+    }
+    b += uint32_t(n) * a + weighted;
+    a += sum;
+    data += n;
+    len -= n;
+  }
+}
+
+uint64_t xxh64(char const *data, size_t len) {
+  XXHash64 h;
+  h.update(data, len);
+  return h.digest();
+}
+
+} //namespace
+
+DeltaTracker::DeltaTracker(DeltaOptions options):
+  options{std::move(options)}
+{
+  if (this->options.storeDir.empty() || this->options.blockSize == 0) {
+    throw std::runtime_error("Delta tracking needs a signature store and a block size");
+  }
+  fs::create_directories(this->options.storeDir);
+}
+
+bool DeltaTracker::matches(std::string const &file) const {
+  return std::any_of(options.patterns.begin(), options.patterns.end(), [&file](std::string const &p) {
+    return file.find(p) != std::string::npos;
+  });
+}
+
+fs::path DeltaTracker::signatureFile(std::string const &file) const {
+  char name[21];
+  snprintf(name, sizeof(name), "%016llx.sig", static_cast<unsigned long long>(xxh64(file.data(), file.size())));
+  return options.storeDir/name;
+}
+
+void DeltaTracker::forget(std::string const &file) const {
+  std::error_code ec;
+  fs::remove(signatureFile(file), ec);
+}
+
+std::unique_ptr<DeltaTracker::Pass> DeltaTracker::begin(std::string const &file) const {
+  return std::unique_ptr<Pass>(new Pass(options, file, signatureFile(file)));
+}
+
+DeltaTracker::Pass::Pass(DeltaOptions const &options, std::string file, fs::path signatureFile):
+  options{options},
+  file{std::move(file)},
+  signatureFile{std::move(signatureFile)},
+  delta{std::make_shared<DeltaData>()}
+{
+  delta->blockSize = options.blockSize;
+  delta->withData = options.withData;
+
+  int fd = ::open(this->signatureFile.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    BOOST_LOG_TRIVIAL(debug) << "No signatures of " << this->file << " yet";
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1 || size_t(st.st_size) < sizeof(Header)) {
+    close(fd);
+    return;
+  }
+  mappingSize = st.st_size;
+  mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    BOOST_LOG_TRIVIAL(warning) << "Failed to map signatures " << this->signatureFile << ", error: " << strerror(errno);
+    mapping = nullptr;
+    return;
+  }
+  auto base = static_cast<char const *>(mapping);
+  auto header = reinterpret_cast<Header const *>(base);
+  if (memcmp(header->magic, storeMagic, sizeof(storeMagic)) != 0
+      || header->blockCount > mappingSize / sizeof(Signature)
+      || sizeof(Header) + header->blockCount * sizeof(Signature) + header->pathLength != mappingSize
+      || std::string_view(base + mappingSize - header->pathLength, header->pathLength) != this->file)
+  {
+    BOOST_LOG_TRIVIAL(warning) << "Signatures " << this->signatureFile << " are malformed or of another file, ignoring them";
+    return;
+  }
+  if (header->blockSize != options.blockSize) {
+    BOOST_LOG_TRIVIAL(info) << "Signatures of " << this->file << " were taken with another block size, ignoring them";
+    return;
+  }
+  oldBlocks = reinterpret_cast<Signature const *>(base + sizeof(Header));
+  // only full blocks are looked for, a short last one is hardly ever found anywhere else
+  auto fullBlocks = std::min<uint64_t>(header->fileSize / options.blockSize, header->blockCount);
+  for (uint32_t i = 0; i < fullBlocks; ++i) {
+    oldIndex[oldBlocks[i].weak].push_back(i);
+  }
+}
+
+DeltaTracker::Pass::~Pass() {
+  if (mapping) {
+    munmap(mapping, mappingSize);
+  }
+}
+
+void DeltaTracker::Pass::update(char const *data, size_t len) {
+  delta->size += len;
+
+  // signatures of the new content, blocks at fixed offsets
+  auto p = data;
+  auto left = len;
+  while (left) {
+    auto n = std::min(left, options.blockSize - blockFill);
+    blockHash.update(p, n);
+    checksum(reinterpret_cast<unsigned char const *>(p), n, blockA, blockB);
+    blockFill += n;
+    p += n;
+    left -= n;
+    if (blockFill == options.blockSize) {
+      newBlocks.push_back({weakOf(blockA, blockB), 0, blockHash.digest()});
+      blockHash = XXHash64{};
+      blockA = blockB = 0;
+      blockFill = 0;
+    }
+  }
+
+  if (oldIndex.empty()) { // nothing to look for, it's all new
+    appendLiteral(delta->size - len, data, len);
+    return;
+  }
+  buf.append(data, len);
+  match(false);
+}
+
+void DeltaTracker::Pass::match(bool eof) {
+  size_t const blockSize = options.blockSize;
+  size_t head = 0; // bytes before head are taken care of, those between head and pos aren't found
+  while (buf.size() - pos >= blockSize) {
+    auto window = reinterpret_cast<unsigned char const *>(buf.data() + pos);
+    if (!rolling) {
+      windowA = windowB = 0;
+      checksum(window, blockSize, windowA, windowB);
+      rolling = true;
+    }
+    if (auto it = oldIndex.find(weakOf(windowA, windowB)); it != oldIndex.end()) {
+      auto strong = xxh64(buf.data() + pos, blockSize);
+      auto found = std::find_if(it->second.begin(), it->second.end(), [this, strong](uint32_t i) {
+        return oldBlocks[i].strong == strong;
+      });
+      if (found != it->second.end()) {
+        appendLiteral(base + head, buf.data() + head, pos - head);
+        closeLiteral();
+        addMove(base + pos, uint64_t{*found} * blockSize);
+        pos += blockSize;
+        head = pos;
+        rolling = false;
+        continue;
+      }
+    }
+    if (buf.size() - pos == blockSize) { // the next byte isn't there yet
+      break;
+    }
+    uint32_t out = window[0], in = window[blockSize];
+    windowA += in - out;
+    windowB += windowA - uint32_t(blockSize) * out;
+    ++pos;
+  }
+  if (eof) {
+    pos = buf.size();
+  }
+  appendLiteral(base + head, buf.data() + head, pos - head);
+  buf.erase(0, pos);
+  base += pos;
+  pos = 0;
+}
+
+void DeltaTracker::Pass::appendLiteral(uint64_t offset, char const *data, size_t len) {
+  if (!len) {
+    return;
+  }
+  if (!literal) {
+    literal = true;
+    literalHash = XXHash64{};
+    delta->changed.push_back({.offset = offset, .length = 0, .hash = 0, .data = {}});
+  }
+  literalHash.update(data, len);
+  auto &range = delta->changed.back();
+  range.length += len;
+  if (delta->withData) {
+    dataSize += len;
+    if (dataSize > options.maxData) { // the client is better off fetching the file
+      delta->withData = false;
+      for (auto &r: delta->changed) {
+        r.data = std::string{};
+      }
+    } else {
+      range.data.append(data, len);
+    }
+  }
+}
+
+void DeltaTracker::Pass::closeLiteral() {
+  if (literal) {
+    delta->changed.back().hash = literalHash.digest();
+    literal = false;
+  }
+}
+
+void DeltaTracker::Pass::addMove(uint64_t offset, uint64_t from) {
+  if (offset == from) { // where it was, nothing to tell
+    return;
+  }
+  auto &moved = delta->moved;
+  if (!moved.empty() && moved.back().offset + moved.back().length == offset
+      && moved.back().from + moved.back().length == from)
+  {
+    moved.back().length += options.blockSize;
+    return;
+  }
+  moved.push_back({.offset = offset, .from = from, .length = options.blockSize});
+}
+
+std::shared_ptr<DeltaData const> DeltaTracker::Pass::finish() {
+  if (!oldIndex.empty()) {
+    match(true);
+  }
+  closeLiteral();
+  if (blockFill) {
+    newBlocks.push_back({weakOf(blockA, blockB), 0, blockHash.digest()});
+  }
+  try {
+    store();
+  } catch (std::exception &ec) {
+    BOOST_LOG_TRIVIAL(warning) << "Failed to store signatures of " << file << ". Error is: " << ec.what();
+  }
+  BOOST_LOG_TRIVIAL(debug) << file << ": " << delta->changed.size() << " ranges changed, "
+    << delta->moved.size() << " moved";
+  return delta;
+}
+
+void DeltaTracker::Pass::store() const {
+  Header header;
+  memcpy(header.magic, storeMagic, sizeof(storeMagic));
+  header.blockSize = options.blockSize;
+  header.pathLength = uint32_t(file.size());
+  header.fileSize = delta->size;
+  header.blockCount = newBlocks.size();
+
+  auto tmpFile = signatureFile;
+  tmpFile += ".tmp";
+  {
+    std::ofstream out(tmpFile, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<char const *>(&header), sizeof(header));
+    out.write(reinterpret_cast<char const *>(newBlocks.data()), newBlocks.size() * sizeof(Signature));
+    out.write(file.data(), file.size());
+    out.flush();
+    if (!out) {
+      std::stringstream sstr;
+      sstr << "Failed to write signatures " << tmpFile;
+      throw std::runtime_error(sstr.str());
+    }
+  }
+  fs::rename(tmpFile, signatureFile);
+}
@@ -0,0 +1,103 @@
+#ifndef DELTA_TRACKER_H
+#define DELTA_TRACKER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "filesystem.h"
+#include "recursive_notify_event.h"
+#include "xxhash64.h"
+
+struct DeltaOptions {
+  std::vector<std::string> patterns; // parts of the paths of the files to track
+  fs::path storeDir;                 // signatures are persisted there, a file per tracked file
+  uint32_t blockSize = 64 * 1024;
+  bool withData = false;             // the changed bytes go along with the ranges
+  size_t maxData = 1024 * 1024;      // ranges of a delta changing more than that go without data
+};
+
+// Works out what changed in a file since it was seen last, the way rsync does:
+// each block of the file is signed with a rolling checksum and XXH64. The old blocks are
+// looked for at every offset of the new content, so inserted bytes don't turn the rest
+// of the file into a change.
+// Signatures are kept in memory-mapped files under storeDir, so they survive restarts.
+// Different files can be handled on different threads at once.
+class DeltaTracker {
+public:
+  class Pass;
+
+  // It throws if storeDir can't be created
+  explicit DeltaTracker(DeltaOptions options);
+
+  bool matches(std::string const &file) const;
+  // the file is gone, so are its signatures
+  void forget(std::string const &file) const;
+  // a single pass over the new content of file
+  std::unique_ptr<Pass> begin(std::string const &file) const;
+
+private:
+  DeltaOptions options;
+  fs::path signatureFile(std::string const &file) const;
+};
+
+// The new content is matched against the old signatures while its own signatures are taken
+class DeltaTracker::Pass {
+public:
+  ~Pass();
+  Pass(Pass const &) = delete;
+  Pass& operator=(Pass const&) = delete;
+
+  void update(char const *data, size_t len);
+  // persists the new signatures, returns what changed
+  std::shared_ptr<DeltaData const> finish();
+
+  struct Signature {
+    uint32_t weak;
+    uint32_t reserved;
+    uint64_t strong;
+  };
+
+private:
+  friend class DeltaTracker;
+  Pass(DeltaOptions const &options, std::string file, fs::path signatureFile);
+
+  DeltaOptions const &options;
+  std::string file;
+  fs::path signatureFile;
+
+  // signatures of the old content
+  void *mapping = nullptr;
+  size_t mappingSize = 0;
+  Signature const *oldBlocks = nullptr;
+  std::unordered_map<uint32_t, std::vector<uint32_t>> oldIndex; // weak -> full blocks
+
+  // signatures of the new content
+  std::vector<Signature> newBlocks;
+  XXHash64 blockHash;
+  uint32_t blockA = 0, blockB = 0;
+  size_t blockFill = 0;
+
+  // the window looked up in the old signatures, bytes of buf are at base.. of the file
+  std::string buf;
+  uint64_t base = 0;
+  size_t pos = 0;
+  bool rolling = false;
+  uint32_t windowA = 0, windowB = 0;
+
+  // the change being collected
+  bool literal = false;
+  XXHash64 literalHash;
+  size_t dataSize = 0;
+  std::shared_ptr<DeltaData> delta;
+
+  void match(bool eof);
+  void appendLiteral(uint64_t offset, char const *data, size_t len);
+  void closeLiteral();
+  void addMove(uint64_t offset, uint64_t from);
+  void store() const;
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include "event_cbor.h"
+#include "glue/metadata_fields.h"
+#include "utf8.h"
+
+namespace {
+
+enum Major : uint8_t {
+  unsignedInt = 0,
+  negativeInt = 1,
+  byteString = 2,
+  textString = 3,
+  array = 4,
+  map = 5
+};
+
+constexpr char cborTrue = char(0xf5);
+
+// The major type and a number, in as few bytes as it takes
+void appendHead(std::string &out, Major major, uint64_t n) {
+  char buf[9];
+  size_t len;
+  uint8_t type = major << 5;
+  if (n < 24) {
+    buf[0] = char(type | n);
+    len = 1;
+  } else if (n <= 0xff) {
+    buf[0] = char(type | 24);
+    len = 2;
+  } else if (n <= 0xffff) {
+    buf[0] = char(type | 25);
+    len = 3;
+  } else if (n <= 0xffffffff) {
+    buf[0] = char(type | 26);
+    len = 5;
+  } else {
+    buf[0] = char(type | 27);
+    len = 9;
+  }
+  for (size_t i = len - 1; i > 0; --i, n >>= 8) { // big endian
+    buf[i] = char(n & 0xff);
+  }
+  out.append(buf, len);
+}
+
+void appendString(std::string &out, Major major, std::string_view s) {
+  appendHead(out, major, s.size());
+  out += s;
+}
+
+void appendInt(std::string &out, int64_t n) {
+  if (n < 0) {
+    appendHead(out, negativeInt, uint64_t(-1 - n));
+  } else {
+    appendHead(out, unsignedInt, uint64_t(n));
+  }
+}
+
+// Counts the entries of the map, written into the first byte once they are all there
+class MapWriter {
+public:
+  explicit MapWriter(std::string &out): out{out}, start{out.size()} {
+    out += char(map << 5);
+  }
+  ~MapWriter() {
+    out[start] = char(map << 5 | entries); // there are less than 24 keys
+  }
+  void key(CborKey k) {
+    out += char(k);
+    ++entries;
+  }
+  void field(CborKey k, uint64_t n) {
+    key(k);
+    appendHead(out, unsignedInt, n);
+  }
+  void text(CborKey k, std::string_view s) {
+    key(k);
+    appendString(out, textString, s);
+  }
+  // text, unless it isn't UTF-8: file names are bytes
+  void fileName(CborKey k, std::string_view s) {
+    key(k);
+    appendString(out, isValidUtf8(s) ? textString : byteString, s);
+  }
+  void bytes(CborKey k, std::string_view s) {
+    key(k);
+    appendString(out, byteString, s);
+  }
+  void flag(CborKey k) {
+    key(k);
+    out += cborTrue;
+  }
+private:
+  std::string &out;
+  size_t start;
+  uint8_t entries = 0;
+};
+
+} //namespace
+
+void appendEventCbor(std::string &out, RecursiveNotifyEvent const &event, bool withPathId,
+                     Projection const &projection)
+{
+  auto fields = projection.fields;
+  out.reserve(out.size() + event.path.size() + event.name.size() + 24);
+  MapWriter w(out);
+  if (fields & EF_PATH) {
+    if (withPathId) {
+      w.field(CK_PATH_ID, event.pathId);
+    } else {
+      w.fileName(CK_PATH, event.path);
+    }
+  }
+  if (fields & EF_NAME) {
+    w.fileName(CK_NAME, event.name);
+  }
+  if (fields & EF_MASK) {
+    w.field(CK_MASK, projection.mask ? projection.mask : event.mask);
+  }
+  if (fields & EF_COOKIE) {
+    w.field(CK_COOKIE, event.cookie);
+  }
+  if (event.catchUp && (fields & EF_CATCHUP)) {
+    w.flag(CK_CATCHUP);
+  }
+  if (event.tail && (fields & EF_TAIL)) {
+    w.field(CK_OFFSET, event.tail->offset);
+    w.bytes(CK_DATA, event.tail->data);
+    if (event.tail->truncated) {
+      w.flag(CK_TRUNCATED);
+    }
+    if (event.tail->rotated) {
+      w.flag(CK_ROTATED);
+    }
+  }
+  if (event.hash && (fields & EF_XXH64)) {
+    w.field(CK_XXH64, *event.hash);
+  }
+  bool withDelta = event.delta && (fields & EF_DELTA);
+  if (withDelta) {
+    auto &delta = *event.delta;
+    w.field(CK_SIZE, delta.size);
+    w.field(CK_BLOCK_SIZE, delta.blockSize);
+    w.key(CK_CHANGED);
+    appendHead(out, array, delta.changed.size());
+    for (auto &r: delta.changed) {
+      appendHead(out, array, delta.withData ? 4 : 3);
+      appendHead(out, unsignedInt, r.offset);
+      appendHead(out, unsignedInt, r.length);
+      appendHead(out, unsignedInt, r.hash);
+      if (delta.withData) {
+        appendString(out, byteString, r.data);
+      }
+    }
+    w.key(CK_MOVED);
+    appendHead(out, array, delta.moved.size());
+    for (auto &m: delta.moved) {
+      appendHead(out, array, 3);
+      appendHead(out, unsignedInt, m.offset);
+      appendHead(out, unsignedInt, m.from);
+      appendHead(out, unsignedInt, m.length);
+    }
+  }
+  if (event.metadata) {
+    auto &md = *event.metadata;
+    auto known = md.fields & projection.metadata;
+    if ((known & MD_SIZE) && !withDelta) { // it's there already
+      w.field(CK_SIZE, md.size);
+    }
+    if (known & MD_MTIME) {
+      w.key(CK_MTIME);
+      appendInt(out, md.mtimeNs);
+    }
+    if (known & MD_INO) {
+      w.field(CK_INO, md.ino);
+    }
+    if (known & MD_TYPE) {
+      w.text(CK_TYPE, fileTypeName(md.mode));
+    }
+    if (known & MD_MODE) {
+      w.field(CK_MODE, md.mode & 07777);
+    }
+    if (known & MD_UID) {
+      w.field(CK_UID, md.uid);
+    }
+    if (known & MD_GID) {
+      w.field(CK_GID, md.gid);
+    }
+  }
+}
+
+void appendPathDefinitionCbor(std::string &out, uint32_t pathId, std::string_view path) {
+  MapWriter w(out);
+  w.field(CK_DEFINE, pathId);
+  w.fileName(CK_PATH, path);
+}
+
+void appendPathResetCbor(std::string &out) {
+  MapWriter w(out);
+  w.flag(CK_RESET);
+}
@@ -0,0 +1,52 @@
+#ifndef EVENT_CBOR_H
+#define EVENT_CBOR_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "recursive_notify_event.h"
+#include "glue/event_fields.h"
+
+// Keys of the CBOR (RFC 8949) map an event is encoded as. The map holds what the JSON
+// object holds, under these keys instead of the names, so each takes a single byte.
+enum CborKey : uint8_t {
+  CK_PATH = 0,       // text, bytes if it isn't UTF-8
+  CK_NAME = 1,       // text, bytes if it isn't UTF-8
+  CK_MASK = 2,       // unsigned
+  CK_COOKIE = 3,     // unsigned
+  CK_CATCHUP = 4,    // true, if so
+  CK_OFFSET = 5,     // unsigned, NB_TAIL
+  CK_DATA = 6,       // bytes, NB_TAIL
+  CK_TRUNCATED = 7,  // true, if so
+  CK_ROTATED = 8,    // true, if so
+  CK_XXH64 = 9,      // unsigned
+  CK_SIZE = 10,      // unsigned, NB_DELTA or metadata
+  CK_BLOCK_SIZE = 11,// unsigned, NB_DELTA
+  CK_CHANGED = 12,   // array of [offset, length, xxh64] or [offset, length, xxh64, bytes], NB_DELTA
+  CK_MOVED = 13,     // array of [offset, from, length], NB_DELTA
+  CK_MTIME = 14,     // integer, nanoseconds
+  CK_INO = 15,       // unsigned
+  CK_TYPE = 16,      // text, "file", "dir", "symlink" or "other"
+  CK_MODE = 17,      // unsigned
+  CK_UID = 18,       // unsigned
+  CK_GID = 19,       // unsigned
+  CK_PATH_ID = 20,   // unsigned, instead of CK_PATH, see appendPathDefinitionCbor()
+  CK_DEFINE = 21,    // unsigned, the id a path definition is of
+  CK_RESET = 22,     // true, path ids defined so far won't be used anymore
+  CK_GAP = 23        // unsigned, messages a client too far behind missed, see appendGap() in glue/wire_format.h
+};
+
+// Appends the event as a CBOR map to out. Numbers take their shortest encoding,
+// tailed and changed bytes go as they are rather than base64 encoded.
+// With withPathId, CK_PATH_ID replaces CK_PATH. Only the fields of the projection are written.
+void appendEventCbor(std::string &out, RecursiveNotifyEvent const &event, bool withPathId = false,
+                     Projection const &projection = {});
+
+// {CK_DEFINE: pathId, CK_PATH: path}
+void appendPathDefinitionCbor(std::string &out, uint32_t pathId, std::string_view path);
+
+// {CK_RESET: true}
+void appendPathResetCbor(std::string &out);
+
+#endif
@@ -0,0 +1,261 @@
+#include "event_json.h"
+#include "i_notify_helper.h"
+#include "glue/metadata_fields.h"
+#include "utf8.h"
+
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <type_traits>
+
+namespace {
+
+// ASCII only. 0: copied as it is, 'u': \u00XX, anything else: backslash and that
+constexpr std::array<char, 128> escapes = [] {
+  std::array<char, 128> res{};
+  for (int c = 0; c < 0x20; ++c) {
+    res[c] = 'u';
+  }
+  res['\b'] = 'b';
+  res['\t'] = 't';
+  res['\n'] = 'n';
+  res['\f'] = 'f';
+  res['\r'] = 'r';
+  res['"'] = '"';
+  res['\\'] = '\\';
+  return res;
+}();
+
+template <class T>
+void appendNumber(std::string &out, T n) {
+  char buf[24];
+  auto res = std::to_chars(buf, buf + sizeof(buf), n);
+  out.append(buf, res.ptr);
+}
+
+// "key":, after a comma unless it's the first one of the object
+void appendKey(std::string &out, std::string_view key) {
+  if (out.back() != '{') {
+    out += ',';
+  }
+  out += '"';
+  out += key;
+  out += "\":";
+}
+
+template <class T, class = std::enable_if_t<std::is_arithmetic_v<T>>>
+void appendField(std::string &out, std::string_view key, T n) {
+  appendKey(out, key);
+  appendNumber(out, n);
+}
+
+void appendField(std::string &out, std::string_view key, std::string_view s) {
+  appendKey(out, key);
+  appendJsonString(out, s);
+}
+
+void appendTrue(std::string &out, std::string_view key) {
+  appendKey(out, key);
+  out += "true";
+}
+
+void appendHex(std::string &out, std::string_view key, uint64_t n) {
+  static constexpr char digits[] = "0123456789abcdef";
+  appendKey(out, key);
+  out += '"';
+  for (int shift = 60; shift >= 0; shift -= 4) {
+    out += digits[(n >> shift) & 15];
+  }
+  out += '"';
+}
+
+void appendBase64(std::string &out, std::string_view key, std::string const &data) {
+  static constexpr char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  appendKey(out, key);
+  out += '"';
+  out.reserve(out.size() + (data.size() + 2) / 3 * 4 + 1);
+  size_t i = 0;
+  for (; i + 2 < data.size(); i += 3) {
+    uint32_t n = uint8_t(data[i]) << 16 | uint8_t(data[i + 1]) << 8 | uint8_t(data[i + 2]);
+    out += alphabet[n >> 18];
+    out += alphabet[(n >> 12) & 63];
+    out += alphabet[(n >> 6) & 63];
+    out += alphabet[n & 63];
+  }
+  if (i < data.size()) {
+    uint32_t n = uint8_t(data[i]) << 16;
+    if (i + 1 < data.size()) {
+      n |= uint8_t(data[i + 1]) << 8;
+    }
+    out += alphabet[n >> 18];
+    out += alphabet[(n >> 12) & 63];
+    out += i + 1 < data.size() ? alphabet[(n >> 6) & 63] : '=';
+    out += '=';
+  }
+  out += '"';
+}
+
+} //namespace
+
+void appendJsonString(std::string &out, std::string_view s) {
+  static constexpr char digits[] = "0123456789abcdef";
+  out += '"';
+  size_t clean = 0; // start of the bytes not copied yet
+  bool validated = false; // from the first non-ASCII byte on
+  bool text = false;      // the rest is valid UTF-8, copied as it is but for what's escaped
+  for (size_t i = skipJsonPlain(s, 0); i < s.size(); i = text ? skipJsonText(s, i) : skipJsonPlain(s, i)) {
+    auto c = static_cast<unsigned char>(s[i]);
+    if (c >= 0x80) {
+      if (!validated) { // in one go, the bytes before are ASCII
+        validated = true;
+        text = isValidUtf8(s.substr(i));
+        if (text) {
+          continue;
+        }
+      }
+      if (auto len = utf8SequenceLength(s, i)) { // copied as it is
+        i += len;
+        continue;
+      }
+    }
+    out.append(s.data() + clean, i - clean);
+    clean = i + 1;
+    out += '\\';
+    if (c >= 0x80) { // not UTF-8, the byte goes as a lone surrogate, as Python's surrogateescape does
+      out += "udc";
+      out += digits[c >> 4];
+      out += digits[c & 15];
+    } else {
+      char esc = escapes[c];
+      out += esc;
+      if (esc == 'u') {
+        out += "00";
+        out += digits[c >> 4];
+        out += digits[c & 15];
+      }
+    }
+    ++i;
+  }
+  out.append(s.data() + clean, s.size() - clean);
+  out += '"';
+}
+
+void appendEventJson(std::string &out, RecursiveNotifyEvent const &event, bool symbolicMask, bool withPathId,
+                     Projection const &projection)
+{
+  auto fields = projection.fields;
+  out.reserve(out.size() + event.path.size() + event.name.size() + 64);
+  out += '{';
+  if (fields & EF_PATH) {
+    if (withPathId) {
+      appendField(out, "pathId", event.pathId);
+    } else {
+      appendField(out, "path", event.path);
+    }
+  }
+  if (fields & EF_NAME) {
+    appendField(out, "name", event.name);
+  }
+  if (fields & EF_MASK) {
+    auto mask = projection.mask ? projection.mask : event.mask;
+    if (symbolicMask) {
+      appendKey(out, "mask");
+      out += '"';
+      appendMask(out, mask);
+      out += '"';
+    } else {
+      appendField(out, "mask", mask);
+    }
+  }
+  if (fields & EF_COOKIE) {
+    appendField(out, "cookie", event.cookie);
+  }
+  if (event.catchUp && (fields & EF_CATCHUP)) {
+    appendTrue(out, "catchup");
+  }
+  if (event.tail && (fields & EF_TAIL)) {
+    appendField(out, "offset", event.tail->offset);
+    appendBase64(out, "data", event.tail->data);
+    if (event.tail->truncated) {
+      appendTrue(out, "truncated");
+    }
+    if (event.tail->rotated) {
+      appendTrue(out, "rotated");
+    }
+  }
+  if (event.hash && (fields & EF_XXH64)) {
+    appendHex(out, "xxh64", *event.hash);
+  }
+  bool withDelta = event.delta && (fields & EF_DELTA);
+  if (withDelta) {
+    auto &delta = *event.delta;
+    appendField(out, "size", delta.size);
+    appendField(out, "blockSize", delta.blockSize);
+    appendKey(out, "changed");
+    out += '[';
+    for (auto &r: delta.changed) {
+      if (&r != &delta.changed.front()) {
+        out += ',';
+      }
+      out += "{\"offset\":";
+      appendNumber(out, r.offset);
+      appendField(out, "length", r.length);
+      appendHex(out, "xxh64", r.hash);
+      if (delta.withData) {
+        appendBase64(out, "data", r.data);
+      }
+      out += '}';
+    }
+    out += ']';
+    appendKey(out, "moved");
+    out += '[';
+    for (auto &m: delta.moved) {
+      if (&m != &delta.moved.front()) {
+        out += ',';
+      }
+      out += "{\"offset\":";
+      appendNumber(out, m.offset);
+      appendField(out, "from", m.from);
+      appendField(out, "length", m.length);
+      out += '}';
+    }
+    out += ']';
+  }
+  if (event.metadata) {
+    auto &md = *event.metadata;
+    auto known = md.fields & projection.metadata;
+    if ((known & MD_SIZE) && !withDelta) { // it's there already
+      appendField(out, "size", md.size);
+    }
+    if (known & MD_MTIME) {
+      appendField(out, "mtime", md.mtimeNs);
+    }
+    if (known & MD_INO) {
+      appendField(out, "ino", md.ino);
+    }
+    if (known & MD_TYPE) {
+      appendField(out, "type", fileTypeName(md.mode));
+    }
+    if (known & MD_MODE) {
+      appendField(out, "mode", md.mode & 07777);
+    }
+    if (known & MD_UID) {
+      appendField(out, "uid", md.uid);
+    }
+    if (known & MD_GID) {
+      appendField(out, "gid", md.gid);
+    }
+  }
+  out += '}';
+}
+
+void appendPathDefinitionJson(std::string &out, uint32_t pathId, std::string_view path) {
+  out += "{\"define\":";
+  appendNumber(out, pathId);
+  appendField(out, "path", path);
+  out += '}';
+}
+
+void appendPathResetJson(std::string &out) {
+  out += "{\"reset\":\"paths\"}";
+}
@@ -0,0 +1,30 @@
+#ifndef EVENT_JSON_H
+#define EVENT_JSON_H
+
+#include <string>
+#include <string_view>
+
+#include "recursive_notify_event.h"
+#include "glue/event_fields.h"
+
+// Appends the event as a one line JSON object to out, which is meant to be reused
+// from event to event, so it's allocated once. With symbolicMask, the mask is written
+// as e.g. "IN_CREATE|IN_ISDIR" rather than a number. With withPathId, the path is replaced
+// with "pathId", for clients which got its definition before. Only the fields of the
+// projection are written.
+void appendEventJson(std::string &out, RecursiveNotifyEvent const &event, bool symbolicMask = false,
+                     bool withPathId = false, Projection const &projection = {});
+
+// {"define":17,"path":"a/b"}: events with "pathId":17 happened in a/b
+void appendPathDefinitionJson(std::string &out, uint32_t pathId, std::string_view path);
+
+// {"reset":"paths"}: the ids defined so far won't be used anymore
+void appendPathResetJson(std::string &out);
+
+// A quoted JSON string, escaped in a single pass. Control characters, quotes and
+// backslashes are escaped the way Boost.JSON does it, valid UTF-8 is copied as it is.
+// Any other byte XX is written as \udcXX, a lone surrogate, as Python's surrogateescape
+// decodes it, so the original bytes can be told back and the JSON stays valid.
+void appendJsonString(std::string &out, std::string_view s);
+
+#endif
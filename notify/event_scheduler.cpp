@@ -0,0 +1,186 @@
+#include "event_scheduler.h"
+
+#include <boost/log/trivial.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <sys/inotify.h>
+
+namespace {
+// what a class of weight 1 may publish per round
+constexpr size_t quantum = 1024;
+// per class, events beyond it are dropped and IN_Q_OVERFLOW is published instead
+constexpr size_t maxQueued = 1 << 20;
+// upper bounds, in seconds, the last one is +Inf
+constexpr double latencyBounds[] = {0.0001, 0.001, 0.01, 0.1, 1, 10};
+
+// an estimate of the fanout cost: it's about the size of the message
+size_t cost(RecursiveNotifyEvent const &rne) {
+  return 64 + rne.path.size() + rne.name.size() + (rne.tail ? rne.tail->data.size() : 0);
+}
+
+// "a/b" is in "a", "ab" is not
+bool isInSubtree(std::string const &path, std::string const &subtree) {
+  return path.compare(0, subtree.size(), subtree) == 0
+      && (path.size() == subtree.size() || path[subtree.size()] == '/');
+}
+} //namespace
+
+EventScheduler::Class EventScheduler::parseClass(std::string const &spec) {
+  auto pos = spec.rfind(':');
+  Class res;
+  try {
+    if (pos == std::string::npos || pos == 0) {
+      throw std::invalid_argument("no subtree");
+    }
+    res.subtree = spec.substr(0, pos);
+    size_t parsed = 0;
+    auto weight = std::stoul(spec.substr(pos + 1), &parsed);
+    if (parsed != spec.size() - pos - 1 || weight == 0 || weight > 1000000) {
+      throw std::invalid_argument("bad weight");
+    }
+    res.weight = weight;
+  } catch (std::exception const &) {
+    std::stringstream sstr;
+    sstr << "Invalid scheduling class '" << spec << "', expected 'subtree:weight'";
+    throw std::runtime_error(sstr.str());
+  }
+  return res;
+}
+
+EventScheduler::EventScheduler(std::vector<Class> classes, std::function<void(RecursiveNotifyEvent)> fn):
+  fn{std::move(fn)}
+{
+  queues.emplace_back(Class{".", 1});
+  for (auto &cls: classes) {
+    while (cls.subtree.size() > 1 && cls.subtree.back() == '/') {
+      cls.subtree.pop_back();
+    }
+    if (cls.subtree == ".") {
+      queues[0].cls.weight = cls.weight;
+    } else {
+      queues.emplace_back(std::move(cls));
+    }
+  }
+  for (auto &q: queues) {
+    BOOST_LOG_TRIVIAL(info) << "Scheduling class '" << q.cls.subtree << "' of weight " << q.cls.weight;
+  }
+  th = std::thread([this]() { dispatch(); });
+}
+
+EventScheduler::~EventScheduler() {
+  {
+    std::lock_guard<std::mutex> lck(mtx);
+    stopping = true;
+  }
+  cv.notify_all();
+  th.join();
+}
+
+EventScheduler::Queue &EventScheduler::classify(RecursiveNotifyEvent const &rne) {
+  auto path = rne.path == "." ? rne.name : rne.path + "/" + rne.name;
+  Queue *res = &queues[0];
+  for (auto &q: queues) {
+    if (q.cls.subtree.size() > res->cls.subtree.size() && isInSubtree(path, q.cls.subtree)) {
+      res = &q;
+    }
+  }
+  return *res;
+}
+
+void EventScheduler::push(RecursiveNotifyEvent rne) {
+  bool wasEmpty;
+  {
+    std::lock_guard<std::mutex> lck(mtx);
+    auto &q = classify(rne);
+    if (q.events.size() >= maxQueued) {
+      if (!q.overflown) {
+        BOOST_LOG_TRIVIAL(warning) << "Queue of class '" << q.cls.subtree << "' overflows, dropping events";
+      }
+      q.overflown = true;
+      ++q.dropped;
+      return;
+    }
+    q.events.push_back({std::move(rne), Clock::now()});
+    wasEmpty = queued++ == 0;
+  }
+  if (wasEmpty) {
+    cv.notify_one();
+  }
+}
+
+void EventScheduler::dispatch() {
+  std::unique_lock<std::mutex> lck(mtx);
+  for (;;) {
+    cv.wait(lck, [this]{ return stopping || queued > 0; });
+    if (queued == 0) {
+      return; // stopping, everything is published
+    }
+    // a round of deficit round robin
+    for (auto &q: queues) {
+      if (q.events.empty()) {
+        q.deficit = 0;
+        continue;
+      }
+      q.deficit += quantum * q.cls.weight;
+      if (q.overflown) {
+        q.overflown = false;
+        lck.unlock();
+        fn(RecursiveNotifyEvent{IN_Q_OVERFLOW, 0, "", ""});
+        lck.lock();
+      }
+      while (!q.events.empty() && cost(q.events.front().rne) <= q.deficit) {
+        auto item = std::move(q.events.front());
+        q.events.pop_front();
+        --queued;
+        q.deficit -= cost(item.rne);
+
+        std::chrono::duration<double> latency = Clock::now() - item.enqueued;
+        ++q.published;
+        q.latencySum += latency.count();
+        size_t bucket = 0;
+        while (bucket < std::size(latencyBounds) && latency.count() > latencyBounds[bucket]) {
+          ++bucket;
+        }
+        ++q.latencyBuckets[bucket];
+
+        lck.unlock();
+        fn(std::move(item.rne));
+        lck.lock();
+      }
+      if (q.events.empty()) {
+        q.deficit = 0;
+      }
+    }
+  }
+}
+
+void EventScheduler::reportMetrics(std::ostream &out) const {
+  std::lock_guard<std::mutex> lck(mtx);
+  out << "# HELP notibeast_queue_latency_seconds Time events spend queued before fanout\n"
+      << "# TYPE notibeast_queue_latency_seconds histogram\n";
+  for (auto &q: queues) {
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < bucketCount; ++i) {
+      cumulative += q.latencyBuckets[i];
+      out << "notibeast_queue_latency_seconds_bucket{class=\"" << q.cls.subtree << "\",le=\"";
+      if (i < std::size(latencyBounds)) {
+        out << latencyBounds[i];
+      } else {
+        out << "+Inf";
+      }
+      out << "\"} " << cumulative << "\n";
+    }
+    out << "notibeast_queue_latency_seconds_sum{class=\"" << q.cls.subtree << "\"} " << q.latencySum << "\n"
+        << "notibeast_queue_latency_seconds_count{class=\"" << q.cls.subtree << "\"} " << q.published << "\n";
+  }
+  out << "# HELP notibeast_queue_depth Events waiting for fanout\n"
+      << "# TYPE notibeast_queue_depth gauge\n";
+  for (auto &q: queues) {
+    out << "notibeast_queue_depth{class=\"" << q.cls.subtree << "\"} " << q.events.size() << "\n";
+  }
+  out << "# HELP notibeast_queue_dropped_total Events dropped because the queue was full\n"
+      << "# TYPE notibeast_queue_dropped_total counter\n";
+  for (auto &q: queues) {
+    out << "notibeast_queue_dropped_total{class=\"" << q.cls.subtree << "\"} " << q.dropped << "\n";
+  }
+}
@@ -0,0 +1,76 @@
+#ifndef EVENT_SCHEDULER_H
+#define EVENT_SCHEDULER_H
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "recursive_notify_event.h"
+
+// Weighted fair queueing of events between ingestion and fanout.
+// Events are queued per subtree and published from a separate thread by deficit round robin,
+// so a subtree flooded with events delays the others by its share of the weights only.
+class EventScheduler {
+public:
+  struct Class {
+    std::string subtree; // relative to the monitored root
+    unsigned weight = 1;
+  };
+  // parses 'subtree:weight', it throws on error
+  static Class parseClass(std::string const &spec);
+
+  // Events which don't belong to any of the classes go to the default class ".",
+  // of weight 1 unless it's listed.
+  // NOTE: fn is invoked from a different thread.
+  EventScheduler(std::vector<Class> classes, std::function<void(RecursiveNotifyEvent)> fn);
+  // publishes whatever is still queued
+  ~EventScheduler();
+  EventScheduler(EventScheduler const &) = delete;
+  EventScheduler& operator=(EventScheduler const&) = delete;
+
+  void push(RecursiveNotifyEvent rne);
+
+  // queue depth and queueing latency per class, in Prometheus text format
+  void reportMetrics(std::ostream &out) const;
+
+private:
+  using Clock = std::chrono::steady_clock;
+  static constexpr size_t bucketCount = 7;
+
+  struct Queued {
+    RecursiveNotifyEvent rne;
+    Clock::time_point enqueued;
+  };
+
+  struct Queue {
+    explicit Queue(Class cls): cls{std::move(cls)} {}
+    Class cls;
+    std::deque<Queued> events;
+    size_t deficit = 0;
+    bool overflown = false;
+    uint64_t published = 0;
+    uint64_t dropped = 0;
+    double latencySum = 0;
+    std::array<uint64_t, bucketCount> latencyBuckets{};
+  };
+
+  std::function<void(RecursiveNotifyEvent)> fn;
+  std::vector<Queue> queues; // the default class comes first
+  size_t queued = 0;
+  mutable std::mutex mtx;
+  std::condition_variable cv;
+  bool stopping = false;
+  std::thread th;
+
+  Queue &classify(RecursiveNotifyEvent const &rne);
+  void dispatch();
+};
+
+#endif
@@ -0,0 +1,209 @@
+#include "file_tailer.h"
+
+#include <algorithm>
+#include <boost/log/trivial.hpp>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+FileTailer::FileTailer(TailOptions options):
+  options{std::move(options)}
+{}
+
+FileTailer::~FileTailer() {
+  for (auto &[path, file]: files) {
+    if (file.fd != -1) {
+      close(file.fd);
+    }
+  }
+}
+
+bool FileTailer::matches(std::string const &name) const {
+  return std::any_of(options.patterns.begin(), options.patterns.end(), [&name](std::string const &p) {
+    return name.find(p) != std::string::npos;
+  });
+}
+
+std::vector<std::shared_ptr<TailData const>>
+FileTailer::onEvent(fs::path const &dir, std::string const &name, uint32_t mask) {
+  std::vector<std::shared_ptr<TailData const>> chunks;
+  if ((mask & IN_ISDIR) || name.empty() || !matches(name)) {
+    return chunks;
+  }
+  auto path = (dir / name).string();
+  auto it = files.find(path);
+  bool known = it != files.end();
+  bool gone = known && it->second.fd == -1;
+
+  if (mask & (IN_MOVED_FROM | IN_DELETE)) {
+    if (known && !gone) {
+      read(it->second, chunks); // whatever was appended before it's gone
+      close(it->second.fd);
+      it->second.fd = -1;       // remembered, so the next file of the name is reported as rotated
+    }
+  } else if (mask & (IN_CREATE | IN_MOVED_TO)) {
+    if (known) {
+      if (!gone) {
+        read(it->second, chunks);
+      }
+      forget(path);
+    }
+    // a moved in file is not new, only what's appended from now on
+    if (auto file = follow(path, mask & IN_CREATE)) {
+      file->rotated = known;
+      read(*file, chunks);
+    }
+  } else if (mask & (IN_MODIFY | IN_CLOSE_WRITE | IN_OPEN)) {
+    if (known && !gone) {
+      if (mask & IN_OPEN) {
+        return chunks;
+      }
+      lru.splice(lru.begin(), lru, it->second.lru);
+      read(it->second, chunks);
+    } else {
+      // first seen, there's no telling what's new. On IN_OPEN, most probably
+      // opened for writing, its current end is where appending starts.
+      if (known) {
+        forget(path);
+      }
+      if (auto file = follow(path, false)) {
+        file->rotated = known;
+      }
+    }
+  }
+  return chunks;
+}
+
+FileTailer::File *FileTailer::follow(std::string const &path, bool fromStart) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+  if (fd == -1) {
+    BOOST_LOG_TRIVIAL(debug) << "Can't follow " << path << ", error: " << strerror(errno);
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return nullptr;
+  }
+  if (files.size() >= options.maxFiles) {
+    BOOST_LOG_TRIVIAL(debug) << "Too many files followed, dropping " << lru.back();
+    forget(lru.back());
+  }
+  BOOST_LOG_TRIVIAL(debug) << "Following " << path;
+  lru.push_front(path);
+  auto &file = files[path];
+  file.fd = fd;
+  file.ino = st.st_ino;
+  file.offset = fromStart ? 0 : st.st_size;
+  file.lru = lru.begin();
+  return &file;
+}
+
+void FileTailer::forget(std::string const &path) {
+  auto it = files.find(path);
+  if (it->second.fd != -1) {
+    close(it->second.fd);
+  }
+  lru.erase(it->second.lru);
+  files.erase(it);
+}
+
+void FileTailer::read(File &file, std::vector<std::shared_ptr<TailData const>> &chunks) {
+  struct stat st;
+  if (fstat(file.fd, &st) == -1) {
+    return;
+  }
+  uint64_t size = st.st_size;
+  bool truncated = false;
+  if (size < file.offset) {
+    truncated = true;
+    file.offset = 0;
+  }
+  if (size - file.offset > options.maxPending) {
+    // clients can tell the gap by the offset
+    file.offset = size - options.maxPending;
+  }
+  bool first = true;
+  while (file.offset < size) {
+    auto chunk = std::make_shared<TailData>();
+    chunk->offset = file.offset;
+    chunk->data.resize(std::min<uint64_t>(options.maxChunk, size - file.offset));
+    auto n = pread(file.fd, chunk->data.data(), chunk->data.size(), file.offset);
+    if (n <= 0) {
+      break;
+    }
+    chunk->data.resize(n);
+    if (first) {
+      chunk->truncated = truncated;
+      chunk->rotated = file.rotated;
+      file.rotated = false;
+      first = false;
+    }
+    file.offset += n;
+    chunks.push_back(std::move(chunk));
+  }
+}
+
+TailWorker::TailWorker(TailOptions options, std::function<void(RecursiveNotifyEvent)> fn, size_t maxQueued):
+  tailer{std::move(options)},
+  fn{std::move(fn)},
+  maxQueued{maxQueued},
+  th{[this]() { run(); }}
+{}
+
+TailWorker::~TailWorker() {
+  {
+    std::lock_guard<std::mutex> lck(mtx);
+    stopping = true;
+  }
+  cv.notify_all();
+  th.join();
+}
+
+void TailWorker::push(fs::path const &dir, std::string const &path, uint32_t pathId, std::string const &name,
+                      uint32_t mask) {
+  if ((mask & IN_ISDIR) || !tailer.matches(name)) {
+    return;
+  }
+  auto file = (dir / name).string();
+  {
+    std::lock_guard<std::mutex> lck(mtx);
+    if (mask == IN_MODIFY) {
+      if (modified.count(file)) {
+        return;
+      }
+      if (queue.size() >= maxQueued) {
+        BOOST_LOG_TRIVIAL(debug) << "Tailing queue is full, " << file << " is read on its next event";
+        return;
+      }
+      modified.insert(file);
+    } else {
+      modified.erase(file);
+    }
+    queue.push_back({dir, path, pathId, name, mask});
+  }
+  cv.notify_one();
+}
+
+void TailWorker::run() {
+  std::unique_lock<std::mutex> lck(mtx);
+  for (;;) {
+    cv.wait(lck, [this]() { return stopping || !queue.empty(); });
+    if (queue.empty()) {
+      return;
+    }
+    auto job = std::move(queue.front());
+    queue.pop_front();
+    if (job.mask == IN_MODIFY) {
+      modified.erase((job.dir / job.name).string());
+    }
+    lck.unlock();
+    for (auto &chunk: tailer.onEvent(job.dir, job.name, job.mask)) {
+      fn(RecursiveNotifyEvent{.mask = NB_TAIL, .cookie = 0, .path = job.path, .name = job.name,
+                              .pathId = job.pathId, .tail = chunk});
+    }
+    lck.lock();
+  }
+}
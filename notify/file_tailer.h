@@ -0,0 +1,99 @@
+#ifndef FILE_TAILER_H
+#define FILE_TAILER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "filesystem.h"
+#include "recursive_notify_event.h"
+
+struct TailOptions {
+  std::vector<std::string> patterns; // names of the files to tail, don't have to be full names
+  size_t maxChunk = 64 * 1024;       // bytes per NB_TAIL event
+  size_t maxPending = 1024 * 1024;   // bytes read per change at most, older ones are skipped
+  size_t maxFiles = 10000;           // files followed at once, least recently changed ones are dropped
+};
+
+// Follows what is appended to files, e.g. logs. Each appended region is read once,
+// however many clients follow the file.
+// Every followed file is kept open, a file renamed or removed is read to its end first.
+// It's not thread safe.
+class FileTailer {
+public:
+  explicit FileTailer(TailOptions options);
+  ~FileTailer();
+  FileTailer(FileTailer const &) = delete;
+  FileTailer& operator=(FileTailer const&) = delete;
+
+  bool matches(std::string const &name) const;
+  // Feeds an inotify event of file 'name' in directory 'dir',
+  // returns what's to be published as NB_TAIL events
+  std::vector<std::shared_ptr<TailData const>> onEvent(fs::path const &dir, std::string const &name, uint32_t mask);
+
+private:
+  struct File {
+    int fd = -1; // -1: the file is gone, its name is remembered
+    uint64_t ino = 0;
+    uint64_t offset = 0;
+    bool rotated = false; // to be reported with the next chunk
+    std::list<std::string>::iterator lru;
+  };
+
+  TailOptions options;
+  std::unordered_map<std::string, File> files;
+  std::list<std::string> lru; // the most recently changed first
+
+  File *follow(std::string const &path, bool fromStart);
+  void forget(std::string const &path);
+  void read(File &file, std::vector<std::shared_ptr<TailData const>> &chunks);
+};
+
+// Feeds a FileTailer on a thread of its own, so that reading a slow file doesn't hold the
+// inotify reader up. Events are handled in order. An IN_MODIFY of a file whose last event
+// queued is an IN_MODIFY as well is left out, that one reads whatever both would have.
+// NOTE: fn is invoked from that thread, with the NB_TAIL events to publish.
+class TailWorker {
+public:
+  TailWorker(TailOptions options, std::function<void(RecursiveNotifyEvent)> fn, size_t maxQueued = 10000);
+  // handles whatever is still queued
+  ~TailWorker();
+  TailWorker(TailWorker const &) = delete;
+  TailWorker& operator=(TailWorker const&) = delete;
+
+  // An inotify event of file 'name' in directory 'dir', 'path' and 'pathId' of which the events
+  // published about it come with
+  void push(fs::path const &dir, std::string const &path, uint32_t pathId, std::string const &name, uint32_t mask);
+
+private:
+  struct Job {
+    fs::path dir;
+    std::string path;
+    uint32_t pathId;
+    std::string name;
+    uint32_t mask;
+  };
+
+  FileTailer tailer; // of the thread only
+  std::function<void(RecursiveNotifyEvent)> fn;
+  size_t maxQueued;
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::deque<Job> queue;
+  std::unordered_set<std::string> modified; // files whose last event queued is an IN_MODIFY
+  bool stopping = false;
+  std::thread th;
+
+  void run();
+};
+
+#endif
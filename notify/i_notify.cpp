@@ -3,6 +3,7 @@
 // Based on https://www.man7.org/linux/man-pages/man7/inotify.7.html#EXAMPLES
 
 #include "i_notify_helper.h"
+#include "glue/cpu_affinity.h"
 
 #include <boost/log/trivial.hpp>
 #include <sys/inotify.h>
@@ -28,7 +29,7 @@ std::ostream& operator<< (std::ostream &out, const NotifyEvent &ne) {
 namespace {
 
 // it throws on error
-void handle_events(int fd, std::function<void(NotifyEvent)> fn) {
+void handle_events(int fd, std::function<void(NotifyEvent)> const &fn, std::function<void()> const &readFn) {
 
    // Some systems cannot read integer variables if they are not
    // properly aligned. On other systems, incorrect alignment may
@@ -66,18 +67,31 @@ void handle_events(int fd, std::function<void(NotifyEvent)> fn) {
        BOOST_LOG_TRIVIAL(debug) << "Passing event to the client-provided callback. " << ne;
        fn(ne);
      }// for events
+     if (readFn) {
+       readFn();
+     }
    }
 } //handle_events
 
 } //namespace
 
 
-INotify::INotify(std::function<void(NotifyEvent)> fn) {
+INotify::INotify(std::function<void(NotifyEvent)> fn, int inheritedFd, ReaderOptions readerOptions,
+                 std::function<void()> readFn):
+  fn{std::move(fn)},
+  readFn{std::move(readFn)},
+  readerOptions{readerOptions}
+{
   BOOST_LOG_TRIVIAL(info) << "Initializing inotify";
 
   efd = eventfd(0,0);
 
-  fd = inotify_init1(IN_NONBLOCK);
+  if (inheritedFd != -1) {
+    BOOST_LOG_TRIVIAL(info) << "Using inherited inotify descriptor " << inheritedFd;
+    fd = inheritedFd;
+  } else {
+    fd = inotify_init1(IN_NONBLOCK);
+  }
   if (fd == -1) {
     std::stringstream sstr;
     sstr<< "inotify_init1 failed with error: " << strerror(errno);
@@ -85,52 +99,68 @@ INotify::INotify(std::function<void(NotifyEvent)> fn) {
     throw std::runtime_error(sstr.str());
   }
 
-  int lfd = fd;
-  th = std::thread([lfd, fn, this]() {
-    // Prepare for polling
-    const int nfds = 2;
-
-    pollfd fds[2];
-
-    // Inotify input
-    fds[0].fd = lfd;
-    fds[0].events = POLLIN;
-    fds[1].fd = efd;
-    fds[1].events = POLLIN;
-
-    BOOST_LOG_TRIVIAL(info) << "Listening for events.";
-    while (true) {
-      BOOST_LOG_TRIVIAL(trace)<<"Entering poll";
-      int poll_num = poll(fds, nfds, -1);
-      BOOST_LOG_TRIVIAL(trace)<<"poll returned";
-      if (poll_num == -1) {
-        if (errno == EINTR) {
-         continue;
-        }
-
-        std::stringstream sstr;
-        sstr<< "Polling of file descriptors failed, error: " << strerror(errno);
-        BOOST_LOG_TRIVIAL(error) << sstr.str();
-        throw std::runtime_error(sstr.str());
+  if (inheritedFd == -1) {
+    start();
+  }
+}
+
+void INotify::start() {
+  th = std::thread([this]() { readEvents(); });
+}
+
+void INotify::readEvents() {
+  pinCurrentThread(readerOptions.cpu);
+  int timeout = readerOptions.busyPoll ? 0 : -1;
+
+  // Prepare for polling
+  const int nfds = 2;
+
+  pollfd fds[2];
+
+  // Inotify input
+  fds[0].fd = fd;
+  fds[0].events = POLLIN;
+  fds[1].fd = efd;
+  fds[1].events = POLLIN;
+
+  BOOST_LOG_TRIVIAL(info) << "Listening for events.";
+  while (true) {
+    BOOST_LOG_TRIVIAL(trace)<<"Entering poll";
+    int poll_num = poll(fds, nfds, timeout);
+    BOOST_LOG_TRIVIAL(trace)<<"poll returned";
+    if (poll_num == -1) {
+      if (errno == EINTR) {
+       continue;
       }
-      if (poll_num > 0) {
-        if (fds[1].revents & POLLIN) {
-          BOOST_LOG_TRIVIAL(debug) << "exiting event received";
-          break;
-        } else if (fds[0].revents & POLLIN) {
-          // Inotify events are available
-          handle_events(lfd, fn);
-        } else {
-          BOOST_LOG_TRIVIAL(info) << "Unexpected result of polling. Check what it is."
-            << " [0].events: " << fds[0].events
-            << " [1].events: " << fds[1].events;
-        }
+
+      std::stringstream sstr;
+      sstr<< "Polling of file descriptors failed, error: " << strerror(errno);
+      BOOST_LOG_TRIVIAL(error) << sstr.str();
+      throw std::runtime_error(sstr.str());
+    }
+    if (poll_num == 0) {
+      // busy-polling, let whoever shares the core run
+      std::this_thread::yield();
+    } else if (poll_num > 0) {
+      if (fds[1].revents & POLLIN) {
+        BOOST_LOG_TRIVIAL(debug) << "exiting event received";
+        break;
+      } else if (fds[0].revents & POLLIN) {
+        // Inotify events are available
+        handle_events(fd, fn, readFn);
+      } else {
+        BOOST_LOG_TRIVIAL(info) << "Unexpected result of polling. Check what it is."
+          << " [0].events: " << fds[0].events
+          << " [1].events: " << fds[1].events;
       }
-    } //while
-  });
+    }
+  } //while
 }
 
-INotify::~INotify() {
+void INotify::stop() {
+  if (!th.joinable()) {
+    return;
+  }
   BOOST_LOG_TRIVIAL(info) << "Stopping the thread";
 
   uint64_t u = 1;
@@ -140,6 +170,15 @@ INotify::~INotify() {
   }
   BOOST_LOG_TRIVIAL(debug) << "Joining the thread";
   th.join();
+  // reset the counter, so the thread can be started again
+  s = read(efd, &u, sizeof(u));
+  if (s!=sizeof(u)) {
+    BOOST_LOG_TRIVIAL(error) << "Failed to read from event fd, error: " << strerror(errno);
+  }
+}
+
+INotify::~INotify() {
+  stop();
   if (fd!=-1) {
     BOOST_LOG_TRIVIAL(debug) << "Closing file descriptor";
     close(fd);
@@ -8,22 +8,43 @@
 
 #include "filesystem.h"
 
+// Tuning of the thread reading inotify events
+struct ReaderOptions {
+  int cpu = -1;          // core the thread is pinned to
+  bool busyPoll = false; // spin instead of sleeping in poll(), for the lowest latency
+};
+
 // Wrapper for inotify(7)
 // https://www.man7.org/linux/man-pages/man7/inotify.7.html
 class INotify {
 public:
-  // NOTE: the callback will be invoked from a different thread
-  explicit INotify(std::function<void(NotifyEvent)>);
+  // NOTE: the callback will be invoked from a different thread.
+  // An inotify descriptor inherited from another process can be passed in, reading
+  // its pending events starts with start(), once the caller is ready for them.
+  // readFn, if any, is invoked on that thread once the events of a read() are passed to the callback.
+  explicit INotify(std::function<void(NotifyEvent)>, int inheritedFd = -1, ReaderOptions readerOptions = {},
+                   std::function<void()> readFn = {});
   INotify(INotify const &) = delete;
   INotify& operator=(INotify const&) = delete;
   ~INotify();
 
   int monitorPath(fs::path const &path); // return watch descriptor
   void removeWatch(int wd);
+
+  // Stop and restart reading events, the descriptor and its watches stay intact.
+  // Unread events are left in the descriptor.
+  void stop();
+  void start();
+  int descriptor() const { return fd; }
 private:
+  std::function<void(NotifyEvent)> fn;
+  std::function<void()> readFn;
+  ReaderOptions readerOptions;
   int fd = -1;  // file  descriptor for inotify
   int efd = -1; // event desriptor to exit waiting on "poll"
   std::thread th;
+
+  void readEvents();
 };
 
 namespace std {
@@ -1,7 +1,42 @@
 #ifndef I_NOTIFY_HELPER_H
 #define I_NOTIFY_HELPER_H
 
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include <sys/inotify.h>
+
+#include "recursive_notify_event.h"
+
+struct MaskName {
+  uint32_t bit;
+  std::string_view name;
+};
+
+// in the order the names are listed
+inline constexpr MaskName maskNames[] = {
+  {IN_ACCESS, "IN_ACCESS"},
+  {IN_ATTRIB, "IN_ATTRIB"},
+  {IN_CLOSE_WRITE, "IN_CLOSE_WRITE"},
+  {IN_CLOSE_NOWRITE, "IN_CLOSE_NOWRITE"},
+  {IN_DELETE, "IN_DELETE"},
+  {IN_CREATE, "IN_CREATE"},
+  {IN_DELETE_SELF, "IN_DELETE_SELF"},
+  {IN_MODIFY, "IN_MODIFY"},
+  {IN_MOVE_SELF, "IN_MOVE_SELF"},
+  {IN_MOVED_FROM, "IN_MOVED_FROM"},
+  {IN_MOVED_TO, "IN_MOVED_TO"},
+  {IN_OPEN, "IN_OPEN"},
+  {IN_IGNORED, "IN_IGNORED"},
+  {IN_UNMOUNT, "IN_UNMOUNT"},
+  {IN_Q_OVERFLOW, "IN_Q_OVERFLOW"},
+  {IN_ISDIR, "IN_ISDIR"},
+  {NB_TAIL, "NB_TAIL"},
+  {NB_DELTA, "NB_DELTA"},
+};
+
+// e.g. "IN_CREATE|IN_ISDIR", bits without a name are appended in hex
+void appendMask(std::string &out, uint32_t mask);
 
 std::string strMask(uint32_t mask);
 
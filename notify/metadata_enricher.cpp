@@ -0,0 +1,270 @@
+#include "metadata_enricher.h"
+#include "glue/metadata_fields.h"
+
+#include <boost/log/trivial.hpp>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <utility>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// the file is gone already, or it isn't about a file
+constexpr uint32_t nothingToStat = IN_DELETE | IN_DELETE_SELF | IN_MOVED_FROM | IN_MOVE_SELF
+                                 | IN_IGNORED | IN_UNMOUNT | IN_Q_OVERFLOW;
+
+unsigned statxMask(unsigned fields) {
+  unsigned res = 0;
+  if (fields & MD_SIZE) res |= STATX_SIZE;
+  if (fields & MD_MTIME) res |= STATX_MTIME;
+  if (fields & MD_INO) res |= STATX_INO;
+  if (fields & MD_TYPE) res |= STATX_TYPE;
+  if (fields & MD_MODE) res |= STATX_MODE;
+  if (fields & MD_UID) res |= STATX_UID;
+  if (fields & MD_GID) res |= STATX_GID;
+  return res;
+}
+
+} //namespace
+
+MetadataEnricher::MetadataEnricher(fs::path rootPath, std::function<void(RecursiveNotifyEvent)> fn, size_t maxDirs,
+                                   std::function<void(std::vector<RecursiveNotifyEvent> &)> batchFn):
+  fn{std::move(fn)},
+  batchFn{std::move(batchFn)},
+  maxDirs{maxDirs},
+  rootPath{std::move(rootPath)},
+  th{[this]() { run(); }}
+{}
+
+MetadataEnricher::~MetadataEnricher() {
+  flush();
+  {
+    std::lock_guard<std::mutex> lck(mtx);
+    stopping = true;
+  }
+  cv.notify_all();
+  th.join();
+  closeDirs();
+}
+
+void MetadataEnricher::setFields(unsigned fields) {
+  BOOST_LOG_TRIVIAL(info) << "Metadata asked for: " << fields;
+  this->fields = fields;
+}
+
+void MetadataEnricher::setRoot(fs::path rootPath) {
+  std::lock_guard<std::mutex> lck(mtx);
+  this->rootPath = std::move(rootPath);
+  rootChanged = true;
+}
+
+void MetadataEnricher::push(RecursiveNotifyEvent rne) {
+  if (holding) {
+    std::lock_guard<std::mutex> lck(mtx);
+    if (collecting || flushing) {
+      collected.push_back(std::move(rne));
+      return;
+    }
+  }
+  // nothing is asked for and nothing is to be overtaken
+  if (fields == 0 && pending == 0) {
+    fn(std::move(rne));
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lck(mtx);
+    ++pending;
+    queue.push_back(std::move(rne));
+  }
+  cv.notify_one();
+}
+
+void MetadataEnricher::collect() {
+  if (!batchFn) {
+    return;
+  }
+  std::lock_guard<std::mutex> lck(mtx);
+  collecting = true;
+  holding = true;
+}
+
+void MetadataEnricher::flush() {
+  std::unique_lock<std::mutex> lck(mtx);
+  if (!collecting) {
+    return;
+  }
+  collecting = false;
+  flushing = true;
+  // whatever is pushed meanwhile goes after this batch
+  while (!collected.empty()) {
+    if (fields == 0 && pending == 0) {
+      flushed.swap(collected);
+      lck.unlock();
+      batchFn(flushed);
+      flushed.clear();
+      lck.lock();
+    } else {
+      // to be enriched, behind what's queued already
+      pending += collected.size();
+      queue.insert(queue.end(), std::make_move_iterator(collected.begin()), std::make_move_iterator(collected.end()));
+      collected.clear();
+      cv.notify_one();
+    }
+  }
+  flushing = false;
+  holding = false;
+}
+
+void MetadataEnricher::run() {
+  std::vector<RecursiveNotifyEvent> batch;
+  std::unique_lock<std::mutex> lck(mtx);
+  for (;;) {
+    cv.wait(lck, [this]{ return stopping || !queue.empty(); });
+    if (queue.empty()) { // stopping
+      return;
+    }
+    batch.swap(queue);
+    auto root = rootPath;
+    auto changed = std::exchange(rootChanged, false);
+    lck.unlock();
+
+    if (changed) {
+      closeDirs();
+    }
+    unsigned batchFields = fields;
+    uint64_t batchLookups = 0;
+    batchOpened = 0;
+    for (auto &rne: batch) {
+      batchLookups += enrich(rne, batchFields, root);
+    }
+    if (batchFn) {
+      batchFn(batch);
+    } else {
+      for (auto &rne: batch) {
+        fn(std::move(rne));
+      }
+    }
+    pending -= batch.size();
+    batch.clear();
+
+    lck.lock();
+    lookups += batchLookups;
+    dirsOpened += batchOpened;
+    ++batches;
+  }
+}
+
+bool MetadataEnricher::enrich(RecursiveNotifyEvent &rne, unsigned fields, fs::path const &root) {
+  if (!fields || (rne.mask & nothingToStat)) {
+    return false;
+  }
+  int flags = AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC | (rne.name.empty() ? AT_EMPTY_PATH : 0);
+  struct statx stx;
+  int res = -1;
+  // a descriptor cached by path may be of a directory which was replaced since, one cached
+  // by id is of the directory of the event however it's named now: the file is gone then
+  for (bool reopen: {false, true}) {
+    int fd = dirFd(rne, root, reopen);
+    if (fd == -1) {
+      return true;
+    }
+    res = statx(fd, rne.name.c_str(), flags, statxMask(fields), &stx);
+    if (res == 0 || errno != ENOENT || rne.pathId) {
+      break;
+    }
+  }
+  if (res == -1) {
+    BOOST_LOG_TRIVIAL(debug) << "statx failed for " << rne.path << "/" << rne.name << ", error: " << strerror(errno);
+    return true;
+  }
+
+  Metadata md;
+  if ((fields & MD_SIZE) && (stx.stx_mask & STATX_SIZE)) {
+    md.fields |= MD_SIZE;
+    md.size = stx.stx_size;
+  }
+  if ((fields & MD_MTIME) && (stx.stx_mask & STATX_MTIME)) {
+    md.fields |= MD_MTIME;
+    md.mtimeNs = int64_t(stx.stx_mtime.tv_sec) * 1000000000 + stx.stx_mtime.tv_nsec;
+  }
+  if ((fields & MD_INO) && (stx.stx_mask & STATX_INO)) {
+    md.fields |= MD_INO;
+    md.ino = stx.stx_ino;
+  }
+  if ((fields & MD_TYPE) && (stx.stx_mask & STATX_TYPE)) {
+    md.fields |= MD_TYPE;
+    md.mode |= stx.stx_mode & S_IFMT;
+  }
+  if ((fields & MD_MODE) && (stx.stx_mask & STATX_MODE)) {
+    md.fields |= MD_MODE;
+    md.mode |= stx.stx_mode & ~S_IFMT;
+  }
+  if ((fields & MD_UID) && (stx.stx_mask & STATX_UID)) {
+    md.fields |= MD_UID;
+    md.uid = stx.stx_uid;
+  }
+  if ((fields & MD_GID) && (stx.stx_mask & STATX_GID)) {
+    md.fields |= MD_GID;
+    md.gid = stx.stx_gid;
+  }
+  rne.metadata = md;
+  return true;
+}
+
+int MetadataEnricher::dirFd(RecursiveNotifyEvent const &rne, fs::path const &root, bool reopen) {
+  DirKey key{rne.pathId, rne.pathId ? std::string() : rne.path};
+  auto it = dirs.find(key);
+  if (it != dirs.end()) {
+    if (!reopen) {
+      lru.splice(lru.begin(), lru, it->second.lru);
+      return it->second.fd;
+    }
+    close(it->second.fd);
+    lru.erase(it->second.lru);
+    dirs.erase(it);
+  }
+
+  int fd = open((root/rne.path).c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+  if (fd == -1) {
+    BOOST_LOG_TRIVIAL(debug) << "Can't open " << root/rne.path << ", error: " << strerror(errno);
+    return -1;
+  }
+  ++batchOpened;
+  if (dirs.size() >= maxDirs) {
+    auto &last = lru.back();
+    close(dirs.at(last).fd);
+    dirs.erase(last);
+    lru.pop_back();
+  }
+  lru.push_front(key);
+  dirs.emplace(std::move(key), Dir{fd, lru.begin()});
+  return fd;
+}
+
+void MetadataEnricher::closeDirs() {
+  for (auto &[key, d]: dirs) {
+    close(d.fd);
+  }
+  dirs.clear();
+  lru.clear();
+}
+
+void MetadataEnricher::reportMetrics(std::ostream &out) const {
+  std::lock_guard<std::mutex> lck(mtx);
+  out << "# HELP notibeast_metadata_lookups_total Files looked up for metadata\n"
+      << "# TYPE notibeast_metadata_lookups_total counter\n"
+      << "notibeast_metadata_lookups_total " << lookups << "\n"
+      << "# HELP notibeast_metadata_dirs_opened_total Directory handles opened, lookups minus these found one open\n"
+      << "# TYPE notibeast_metadata_dirs_opened_total counter\n"
+      << "notibeast_metadata_dirs_opened_total " << dirsOpened << "\n"
+      << "# HELP notibeast_metadata_batches_total Batches of events enriched\n"
+      << "# TYPE notibeast_metadata_batches_total counter\n"
+      << "notibeast_metadata_batches_total " << batches << "\n"
+      << "# HELP notibeast_metadata_queue_depth Events waiting for metadata\n"
+      << "# TYPE notibeast_metadata_queue_depth gauge\n"
+      << "notibeast_metadata_queue_depth " << pending << "\n";
+}
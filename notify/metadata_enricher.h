@@ -0,0 +1,103 @@
+#ifndef METADATA_ENRICHER_H
+#define METADATA_ENRICHER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "filesystem.h"
+#include "recursive_notify_event.h"
+
+// Gathers the metadata subscribers asked for, so they don't have to stat() each path themselves.
+// Events are enriched in batches on a separate thread, with statx() relative to
+// O_PATH descriptors of the watched directories, the most recently used ones are kept open,
+// by the path id of the directory: another one under the same path has an id of its own.
+// While nobody asks for anything, events go straight through.
+// NOTE: fn is invoked from a different thread, unless nothing is asked for.
+// With batchFn, enriched events are passed on with it, a batch at a time, instead of fn.
+// Events pushed between collect() and flush() go on as one batch as well, enriched or not.
+class MetadataEnricher {
+public:
+  MetadataEnricher(fs::path rootPath, std::function<void(RecursiveNotifyEvent)> fn, size_t maxDirs = 1024,
+                   std::function<void(std::vector<RecursiveNotifyEvent> &)> batchFn = {});
+  // publishes whatever is still queued
+  ~MetadataEnricher();
+  MetadataEnricher(MetadataEnricher const &) = delete;
+  MetadataEnricher& operator=(MetadataEnricher const&) = delete;
+
+  // MD_* bits, 0 - nothing
+  void setFields(unsigned fields);
+  void setRoot(fs::path rootPath);
+  void push(RecursiveNotifyEvent rne);
+  // Holds the events pushed from now on, from whichever thread, till flush() passes them on
+  // together. Without batchFn it's of no use.
+  void collect();
+  void flush();
+
+  void reportMetrics(std::ostream &out) const;
+
+private:
+  // A directory by its path id, or by its path if it has none, e.g. of catch-up events
+  struct DirKey {
+    uint32_t pathId;
+    std::string path; // with no path id only
+
+    bool operator==(DirKey const &other) const {
+      return pathId == other.pathId && path == other.path;
+    }
+  };
+
+  struct DirKeyHash {
+    size_t operator()(DirKey const &key) const {
+      return std::hash<std::string>{}(key.path) ^ key.pathId;
+    }
+  };
+
+  struct Dir {
+    int fd;
+    std::list<DirKey>::iterator lru;
+  };
+
+  std::function<void(RecursiveNotifyEvent)> fn;
+  std::function<void(std::vector<RecursiveNotifyEvent> &)> batchFn;
+  size_t maxDirs;
+  std::atomic<unsigned> fields{0};
+  std::atomic<size_t> pending{0}; // queued or being enriched
+  std::atomic<bool> holding{false}; // collecting or flushing
+
+  mutable std::mutex mtx; // guards the members below up to th
+  std::condition_variable cv;
+  std::vector<RecursiveNotifyEvent> queue;
+  fs::path rootPath;
+  bool rootChanged = false;
+  bool collecting = false;
+  bool flushing = false;
+  std::vector<RecursiveNotifyEvent> collected;
+  bool stopping = false;
+  uint64_t lookups = 0;
+  uint64_t dirsOpened = 0;
+  uint64_t batches = 0;
+  std::thread th;
+
+  std::vector<RecursiveNotifyEvent> flushed; // of flush() only
+
+  // enrichment thread only
+  std::unordered_map<DirKey, Dir, DirKeyHash> dirs; // paths relative to the root
+  std::list<DirKey> lru;                            // the most recently used first
+  uint64_t batchOpened = 0;
+
+  void run();
+  bool enrich(RecursiveNotifyEvent &rne, unsigned fields, fs::path const &root);
+  int dirFd(RecursiveNotifyEvent const &rne, fs::path const &root, bool reopen);
+  void closeDirs();
+};
+
+#endif
@@ -3,6 +3,12 @@
 #include "recursive_notify_event.h"
 #include "i_notify.h"
 #include "i_notify_helper.h"
+#include "tree_snapshot.h"
+#include "event_scheduler.h"
+#include "file_tailer.h"
+#include "content_hasher.h"
+#include "delta_tracker.h"
+#include "metadata_enricher.h"
 
 #include <iostream>
 #include <sys/inotify.h>
@@ -12,6 +18,11 @@
 #include <algorithm>
 #include <unordered_set>
 #include <unordered_map>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <utility>
 #include <boost/log/trivial.hpp>
 
 namespace std {
@@ -25,11 +36,13 @@ namespace std {
 
 namespace {
 RecursiveNotifyEvent makeRecursive(NotifyEvent const &ne,
-                                   std::string const &path) {
+                                   std::string const &path,
+                                   uint32_t pathId) {
   return {.mask = ne.mask,
           .cookie = ne.cookie,
           .path = path,
-          .name = ne.name};
+          .name = ne.name,
+          .pathId = pathId};
 }
 
 // fs::path dies if the path in question doesn't exist anymore
@@ -73,64 +86,422 @@ class RecursiveINotify::RecursiveINotifyImpl {
 public:
   explicit RecursiveINotifyImpl(std::function<void(RecursiveNotifyEvent)> rfn,
                                 fs::path const &rootPath,
-                                std::vector<std::string> pathsToSkip):
+                                std::vector<std::string> pathsToSkip,
+                                fs::path stateFile,
+                                std::chrono::seconds stateInterval,
+                                HandoffState const &inherited,
+                                std::vector<EventScheduler::Class> classes,
+                                ReaderOptions readerOptions,
+                                TailOptions tailOptions,
+                                HashOptions hashOptions,
+                                DeltaOptions deltaOptions,
+                                std::function<void(std::vector<RecursiveNotifyEvent> &)> batchFn):
     rfn{rfn},
+    batchFn{std::move(batchFn)},
+    scheduler{classes.empty() ? nullptr : std::make_unique<EventScheduler>(std::move(classes), rfn)},
+    enricher{std::make_unique<MetadataEnricher>(rootPath, [this](RecursiveNotifyEvent rne) { deliver(std::move(rne)); },
+                                                1024, [this](std::vector<RecursiveNotifyEvent> &batch) {
+                                                  deliver(batch);
+                                                })},
+    delta{deltaOptions.patterns.empty() ? nullptr : std::make_unique<DeltaTracker>(std::move(deltaOptions))},
+    hashEveryFile{hashOptions.everyFile},
+    hasher{hashOptions.threads == 0 ? nullptr : std::make_unique<ContentHasher>(
+       std::move(hashOptions),
+       [this](RecursiveNotifyEvent rne) { publish(std::move(rne)); },
+       delta.get()
+    )},
     notifier{std::make_unique<INotify>(
-       [this, rootPath](NotifyEvent const &ne) {
+       [this](NotifyEvent const &ne) {
+         if (!inRead && this->batchFn && !scheduler) {
+           // the events of a read() go out as a batch
+           enricher->collect();
+           inRead = true;
+         }
+         std::lock_guard<std::mutex> lck(registryMtx);
          try {
-           handleEvent(rootPath, ne);
+           handleEvent(this->rootPath, ne);
          } catch (std::exception &ec) {
            BOOST_LOG_TRIVIAL(warning) << "Exception occured while processing event " << ne
              << ". Error is: " << ec.what();
          }
+       },
+       inherited.inotifyFd,
+       readerOptions,
+       [this]() {
+         if (std::exchange(inRead, false)) {
+           enricher->flush();
+         }
        }
     )},
-    pathsToSkip(std::move(pathsToSkip))
+    pathsToSkip(std::move(pathsToSkip)),
+    rootPath{rootPath},
+    tailer{tailOptions.patterns.empty() ? nullptr : std::make_unique<TailWorker>(
+      std::move(tailOptions), [this](RecursiveNotifyEvent rne) { publish(std::move(rne)); })},
+    stateFile{std::move(stateFile)}
   {
-    monitorDirRecursively(rootPath);
+    std::unique_lock<std::mutex> registryLck(registryMtx);
+    if (inherited.inotifyFd != -1) {
+      for (auto &[wd, dp]: inherited.watches) {
+        pathMap[wd]=dp;
+        rPathMap[dp]=wd;
+        pathIds[wd]=nextPathId();
+      }
+      BOOST_LOG_TRIVIAL(info) << "Start monitoring, " << pathMap.size() << " inherited subdirectories";
+      notifier->start();
+    } else if (this->stateFile.empty()) {
+      monitorDirRecursively(rootPath);
+    } else {
+      monitorWithSnapshot();
+    }
+    registryLck.unlock();
+    if (!this->stateFile.empty()) {
+      if (stateInterval.count() > 0) {
+        stateThread = std::thread([this, stateInterval]() {
+          for (;;) {
+            {
+              std::unique_lock<std::mutex> lck(stateMtx);
+              if (stateCv.wait_for(lck, stateInterval, [this]{ return stopping.load(); })) {
+                return;
+              }
+            }
+            saveSnapshot();
+          }
+        });
+      }
+    }
   }
 
   ~RecursiveINotifyImpl() {
+    // no event handling from now on, the registry and the tailer go before the notifier
+    notifier->stop();
+    {
+      std::lock_guard<std::mutex> lck(stateMtx);
+      stopping = true;
+    }
+    stateCv.notify_all();
+    if (indexThread.joinable()) {
+      indexThread.join();
+    }
+    if (!stateFile.empty()) {
+      if (stateThread.joinable()) {
+        stateThread.join();
+      }
+      saveSnapshot();
+    }
   }
 
   RecursiveINotifyImpl(RecursiveINotifyImpl const &) = delete;
   RecursiveINotifyImpl& operator=(RecursiveINotifyImpl const&) = delete;
 
+  void suspend(HandoffState &state) {
+    notifier->stop(); // no event handling from now on
+    std::lock_guard<std::mutex> lck(registryMtx);
+    state.inotifyFd = notifier->descriptor();
+    state.watches.clear();
+    state.watches.reserve(pathMap.size());
+    for (auto &[wd, dp]: pathMap) {
+      state.watches.emplace_back(wd, dp.string());
+    }
+  }
+
+  void resume() {
+    notifier->start();
+  }
+
+  void reportMetrics(std::ostream &out) const {
+    if (scheduler) {
+      scheduler->reportMetrics(out);
+    }
+    if (hasher) {
+      hasher->reportMetrics(out);
+    }
+    enricher->reportMetrics(out);
+  }
+
+  void requestMetadata(unsigned fields) {
+    enricher->setFields(fields);
+  }
+
+  // Applies a new root and/or new exclusions. Watches of directories which aren't monitored
+  // anymore are removed right away, newly included ones are indexed in the background.
+  // Only the difference is walked: already watched directories aren't entered again.
+  void reconfigure(fs::path const &newRootPath, std::vector<std::string> newPathsToSkip) {
+    std::lock_guard<std::mutex> lck(registryMtx);
+    BOOST_LOG_TRIVIAL(info) << "Reconfiguring, root " << rootPath << " -> " << newRootPath;
+    pathsToSkip = std::move(newPathsToSkip);
+    if (newRootPath != rootPath) { // paths relative to the root change, so do their ids
+      for (auto &[wd, id]: pathIds) {
+        id = nextPathId();
+      }
+    }
+    rootPath = newRootPath;
+    enricher->setRoot(rootPath);
+
+    std::vector<fs::path> excluded;
+    for (auto it = begin(pathMap); it != end(pathMap); ) {
+      if (isUnderRoot(it->second) && !shallSkip(it->second)) {
+        ++it;
+        continue;
+      }
+      BOOST_LOG_TRIVIAL(debug) << "Removing watch for " << it->second;
+      try {
+        notifier->removeWatch(it->first);
+      } catch (std::exception &ec) { // the directory is gone already, IN_IGNORED is on its way
+        BOOST_LOG_TRIVIAL(debug) << "Failed to remove watch for " << it->second << ". Error is: " << ec.what();
+      }
+      if (isUnderRoot(it->second)) {
+        excluded.push_back(it->second);
+      }
+      rPathMap.erase(it->second);
+      pathIds.erase(it->first);
+      it = pathMap.erase(it);
+    }
+    for (auto &dp: excluded) {
+      if (rPathMap.count(dp.parent_path())) {
+        skippedPaths.insert(dp);
+      }
+    }
+
+    std::vector<fs::path> included;
+    for (auto it = begin(skippedPaths); it != end(skippedPaths); ) {
+      if (!isUnderRoot(*it)) {
+        it = skippedPaths.erase(it);
+      } else if (!shallSkip(*it)) {
+        included.push_back(*it);
+        it = skippedPaths.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    if (!rPathMap.count(rootPath)) {
+      included.push_back(rootPath);
+    }
+    BOOST_LOG_TRIVIAL(info) << excluded.size() << " directories excluded, "
+      << included.size() << " subtrees to index, " << pathMap.size() << " directories still monitored";
+
+    if (included.empty()) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> stateLck(stateMtx);
+      pendingIndex.insert(end(pendingIndex), begin(included), end(included));
+    }
+    if (!indexThread.joinable()) {
+      indexThread = std::thread([this]() { indexPending(); });
+    }
+    stateCv.notify_all();
+  }
+
 private:
   std::function<void(RecursiveNotifyEvent)> rfn;
+  std::function<void(std::vector<RecursiveNotifyEvent> &)> batchFn; // for the batches, if any
+  bool inRead = false; // of the reader thread, the events of a read() are being collected
+  // declared before the notifier: it's to be there as long as events come in
+  std::unique_ptr<EventScheduler> scheduler;
+  std::unique_ptr<MetadataEnricher> enricher;
+  std::unique_ptr<DeltaTracker> delta;
+  bool hashEveryFile;
+  // between the two: it publishes through the scheduler, events come to it from the notifier
+  std::unique_ptr<ContentHasher> hasher;
   std::unique_ptr<INotify> notifier;
   std::unordered_map<fs::path, int> rPathMap;
   std::unordered_map<int, fs::path> pathMap;
+  // wd -> id of the path sent to clients instead of it. A new watch gets a new id, so a moved
+  // directory does, and ids are never reused: the id of a path can't come to mean another one
+  std::unordered_map<int, uint32_t> pathIds;
+  uint32_t lastPathId = 0;
   std::unordered_set<fs::path> ignoredPaths;
   std::unordered_set<fs::path> beingUnmountedPaths;
   std::vector<std::string> pathsToSkip;
+  fs::path rootPath;
+  std::unique_ptr<TailWorker> tailer; // publishes from a thread of its own
+
+  std::unordered_set<fs::path> skippedPaths; // topmost excluded directories
+  // guards the registry above, the root and the exclusions. Events are handled under it.
+  std::mutex registryMtx;
+
+  fs::path stateFile;
+  std::thread stateThread;
+  std::mutex stateMtx; // guards stopping and pendingIndex as well
+  std::condition_variable stateCv;
+  std::atomic<bool> stopping{false};
+
+  std::thread indexThread;
+  std::deque<fs::path> pendingIndex; // subtrees included by reconfigure()
 
 private:
+  static bool shallSkip(const fs::path &path, std::vector<std::string> const &pathsToSkip) {
+    return std::any_of(pathsToSkip.begin(), pathsToSkip.end(), [&path](std::string const &pts) {
+      return path.string().find(pts) != std::string::npos;
+    });
+  }
+
+  bool shallSkip(const fs::path &path) const {
+    return shallSkip(path, pathsToSkip);
+  }
+
+  bool isUnderRoot(const fs::path &path) const {
+    auto relPath = path.lexically_relative(rootPath);
+    return !relPath.empty() && *relPath.begin() != "..";
+  }
+
   void monitorDirRecursively(const fs::path &path) {
     BOOST_LOG_TRIVIAL(info) << "Indexing monitoring directory " << path;
     vector<fs::path> children;
     children.push_back(path);
-    for(auto &item: fs::recursive_directory_iterator(path, fs::directory_options::skip_permission_denied)){
+    for(auto it = fs::recursive_directory_iterator(path, fs::directory_options::skip_permission_denied);
+        it != fs::recursive_directory_iterator(); ++it) {
+      auto &item = *it;
       BOOST_LOG_TRIVIAL(trace) << "Visiting '" << item.path() << "' directory";
       if (item.is_directory()) {
-        if (std::any_of(pathsToSkip.begin(), pathsToSkip.end(), [&item](std::string const &pts) {
-          return item.path().string().find(pts) != std::string::npos;
-        })) {
+        if (shallSkip(item.path())) {
+          skippedPaths.insert(item.path());
+          it.disable_recursion_pending();
           continue;
         }
         children.push_back(item);
       }
     }
     for(auto &dp: children) {
-      int wd = notifier->monitorPath(dp);
-      BOOST_LOG_TRIVIAL(trace) << "Monitoring path " << dp << " with wd " << wd;
-
-      pathMap[wd]=dp;
-      rPathMap[dp]=wd;
+      addWatch(dp);
     }
     BOOST_LOG_TRIVIAL(info) << "Start monitoring, " << pathMap.size() << " subdirectories indexed";
   }
 
+  void addWatch(const fs::path &dp) {
+    int wd = notifier->monitorPath(dp);
+    BOOST_LOG_TRIVIAL(trace) << "Monitoring path " << dp << " with wd " << wd;
+
+    pathMap[wd]=dp;
+    rPathMap[dp]=wd;
+    pathIds[wd]=nextPathId();
+  }
+
+  uint32_t nextPathId() {
+    if (++lastPathId == 0) { // 0 is no id
+      ++lastPathId;
+    }
+    return lastPathId;
+  }
+
+  // Background indexing of the subtrees included by reconfigure()
+  void indexPending() {
+    for (;;) {
+      fs::path top;
+      {
+        std::unique_lock<std::mutex> lck(stateMtx);
+        stateCv.wait(lck, [this]{ return stopping || !pendingIndex.empty(); });
+        if (stopping) {
+          return;
+        }
+        top = std::move(pendingIndex.front());
+        pendingIndex.pop_front();
+      }
+      try {
+        indexSubtree(top);
+      } catch (std::exception &ec) {
+        BOOST_LOG_TRIVIAL(warning) << "Failed to index " << top << ". Error is: " << ec.what();
+      }
+    }
+  }
+
+  // Watches are added as directories are found, the registry is locked per directory only
+  void indexSubtree(const fs::path &top) {
+    BOOST_LOG_TRIVIAL(info) << "Indexing newly included directory " << top;
+    // returns false if the directory is not to be entered
+    auto visit = [this](const fs::path &dp) {
+      std::lock_guard<std::mutex> lck(registryMtx);
+      if (!isUnderRoot(dp) || rPathMap.count(dp)) {
+        return false;
+      }
+      if (shallSkip(dp)) {
+        skippedPaths.insert(dp);
+        return false;
+      }
+      addWatch(dp);
+      return true;
+    };
+
+    if (!visit(top)) {
+      return;
+    }
+    size_t count = 1;
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(top, fs::directory_options::skip_permission_denied, ec);
+         !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+      if (stopping) {
+        return;
+      }
+      if (!it->is_directory(ec) || ec) {
+        ec.clear();
+        continue;
+      }
+      if (visit(it->path())) {
+        ++count;
+      } else {
+        it.disable_recursion_pending();
+      }
+    }
+    BOOST_LOG_TRIVIAL(info) << count << " subdirectories of " << top << " indexed";
+  }
+
+  // Indexes the tree with the help of the snapshot taken by the previous run
+  // and publishes whatever changed in between as catch-up events
+  void monitorWithSnapshot() {
+    BOOST_LOG_TRIVIAL(info) << "Indexing monitoring directory " << rootPath << " against snapshot " << stateFile;
+    auto previous = TreeSnapshot::open(stateFile, rootPath);
+    std::mutex skippedMtx;
+    auto scan = scanTree(rootPath, previous.get(), [this, &skippedMtx](const fs::path &p) {
+      if (!shallSkip(p)) {
+        return false;
+      }
+      std::lock_guard<std::mutex> lck(skippedMtx);
+      skippedPaths.insert(p);
+      return true;
+    });
+    previous.reset();
+
+    for(auto &dp: scan.directories) {
+      addWatch(dp);
+    }
+    BOOST_LOG_TRIVIAL(info) << "Start monitoring, " << pathMap.size() << " subdirectories indexed, "
+      << scan.changes.size() << " changes while the service was down";
+
+    writeSnapshot(rootPath, scan.root);
+    for (auto &rne: scan.changes) {
+      BOOST_LOG_TRIVIAL(debug) << "Publish catch-up event for " << rne.path
+        << ", name: '" << rne.name
+        << "', mask: " << strMask(rne.mask);
+      publish(std::move(rne));
+    }
+  }
+
+  void saveSnapshot() {
+    fs::path root;
+    std::vector<std::string> skip;
+    {
+      std::lock_guard<std::mutex> lck(registryMtx);
+      root = rootPath;
+      skip = pathsToSkip;
+    }
+    try {
+      auto previous = TreeSnapshot::open(stateFile, root);
+      auto scan = scanTree(root, previous.get(), [&skip](const fs::path &p) { return shallSkip(p, skip); });
+      previous.reset();
+      writeSnapshot(root, scan.root);
+    } catch (std::exception &ec) {
+      BOOST_LOG_TRIVIAL(warning) << "Failed to take a snapshot of " << rootPath << ". Error is: " << ec.what();
+    }
+  }
+
+  void writeSnapshot(fs::path const &rootPath, TreeNode const &root) {
+    try {
+      TreeSnapshot::write(stateFile, rootPath, root);
+    } catch (std::exception &ec) {
+      BOOST_LOG_TRIVIAL(warning) << "Failed to write snapshot " << stateFile << ". Error is: " << ec.what();
+    }
+  }
+
   void handleEvent(const fs::path &rootPath, NotifyEvent const &ne) {
     BOOST_LOG_TRIVIAL(debug) << "Event for wd " << ne.wd
       << ", name: " << ne.name
@@ -153,6 +524,7 @@ private:
     }
 
     auto relPath = safe_relative_path(pathIt->second, rootPath);
+    auto pathId = pathIds[ne.wd];
     BOOST_LOG_TRIVIAL(debug) << "relPath: " << relPath << ", name: '" << ne.name << "'";
 
     if (ne.mask == (IN_MOVED_FROM | IN_ISDIR)) {
@@ -177,7 +549,7 @@ private:
       if (bup != beingUnmountedPaths.end()) {
         beingUnmountedPaths.erase(bup);
         if (relPath == ".") {
-          publishEvent(ne, relPath);
+          publishEvent(ne, relPath, pathId);
         } else {
           BOOST_LOG_TRIVIAL(debug) << "ignore IN_IGNORED for path " << pathIt->second
             << ", name: '" << ne.name << "', mask: " << strMask(ne.mask);
@@ -191,7 +563,27 @@ private:
       return;
     }
 
-    publishEvent(ne, relPath);
+    // NOTE: pathIt is gone after IN_IGNORED, which has no name though
+    auto file = ne.name.empty() ? std::string{} : (pathIt->second/ne.name).string();
+    if (hasher && ne.mask == IN_CLOSE_WRITE && (hashEveryFile || (delta && delta->matches(file)))) {
+      hasher->submit(file, makeRecursive(ne, relPath, pathId));
+    } else {
+      if (hasher && ne.mask == IN_MODIFY) {
+        hasher->touch(file);
+      }
+      if (hasher && (ne.mask == IN_DELETE || ne.mask == IN_MOVED_FROM)) {
+        hasher->drop(file);
+      }
+      if (delta && (ne.mask == IN_DELETE || ne.mask == IN_MOVED_FROM) && delta->matches(file)) {
+        delta->forget(file);
+      }
+      publishEvent(ne, relPath, pathId);
+    }
+
+    // NOTE: pathIt is gone after IN_IGNORED, which has no name though
+    if (tailer && !ne.name.empty()) {
+      tailer->push(pathIt->second, relPath.string(), pathId, ne.name, ne.mask);
+    }
   }
 
   void enterMovedFrom(const fs::path &path) {
@@ -214,6 +606,7 @@ private:
         notifier->removeWatch(mPathIt->first);
         erased = rPathMap.erase(mPathIt->second);
         assert(erased == 1);
+        pathIds.erase(mPathIt->first);
         mPathIt = pathMap.erase(mPathIt);
       } else {
         ++mPathIt;
@@ -222,17 +615,40 @@ private:
 
     erased = rPathMap.erase(pathIt->second);
     assert(erased == 1);
+    pathIds.erase(pathIt->first);
     pathMap.erase(pathIt);
     BOOST_LOG_TRIVIAL(debug) << "Ignored event completed";
   }
 
-  void publishEvent(NotifyEvent const &ne, const fs::path &relPath) const {
-    RecursiveNotifyEvent rne = makeRecursive(ne, relPath);
+  void publishEvent(NotifyEvent const &ne, const fs::path &relPath, uint32_t pathId = 0) const {
+    RecursiveNotifyEvent rne = makeRecursive(ne, relPath, pathId);
 
     BOOST_LOG_TRIVIAL(debug) << "Publish event for " << relPath
       << ", name: '" << rne.name
       << "', mask: " << strMask(rne.mask);
-    rfn(rne);
+    publish(std::move(rne));
+  }
+
+  void publish(RecursiveNotifyEvent rne) const {
+    enricher->push(std::move(rne));
+  }
+
+  void deliver(RecursiveNotifyEvent rne) const {
+    if (scheduler) {
+      scheduler->push(std::move(rne));
+    } else {
+      rfn(rne);
+    }
+  }
+
+  void deliver(std::vector<RecursiveNotifyEvent> &batch) const {
+    if (scheduler || !batchFn) {
+      for (auto &rne: batch) {
+        deliver(std::move(rne));
+      }
+    } else {
+      batchFn(batch);
+    }
   }
 
   bool shallIgnorePath(const fs::path &path) const {
@@ -246,8 +662,20 @@ private:
 
 RecursiveINotify::RecursiveINotify(std::function<void(RecursiveNotifyEvent)> rfn,
                  fs::path const &rootPath,
-                 std::vector<std::string> pathsToSkip):
-  pImpl(make_unique<RecursiveINotifyImpl>(rfn, rootPath, std::move(pathsToSkip)))
+                 std::vector<std::string> pathsToSkip,
+                 fs::path stateFile,
+                 std::chrono::seconds stateInterval,
+                 HandoffState const &inherited,
+                 std::vector<EventScheduler::Class> classes,
+                 ReaderOptions readerOptions,
+                 TailOptions tailOptions,
+                 HashOptions hashOptions,
+                 DeltaOptions deltaOptions,
+                 std::function<void(std::vector<RecursiveNotifyEvent> &)> batchFn):
+  pImpl(make_unique<RecursiveINotifyImpl>(rfn, rootPath, std::move(pathsToSkip),
+                                          std::move(stateFile), stateInterval, inherited,
+                                          std::move(classes), readerOptions, std::move(tailOptions),
+                                          std::move(hashOptions), std::move(deltaOptions), std::move(batchFn)))
 {
   BOOST_LOG_TRIVIAL(debug) <<"RecursiveINotify::ctor()";
 }
@@ -256,14 +684,28 @@ RecursiveINotify::~RecursiveINotify() {
   BOOST_LOG_TRIVIAL(debug) <<"RecursiveINotify::dtor()";
 }
 
-void RecursiveINotify::logFiltered(std::string const &ss, int filteringMask) const {
-  std::string_view sv = ss;
-  if (!sv.empty() && *sv.rbegin() == '\n') {
-    sv.remove_suffix(1);
-  }
-  BOOST_LOG_TRIVIAL(debug) << "Message '" << sv << "' is filtered out by mask " << strMask(filteringMask) << "";
-}
-
 void RecursiveINotify::logSubscribing(int mask) const {
   BOOST_LOG_TRIVIAL(info) << "Subscribing for mask " << strMask(mask);
 }
+
+bool RecursiveINotify::suspend(HandoffState &state) {
+  pImpl->suspend(state);
+  return true;
+}
+
+void RecursiveINotify::resume() {
+  pImpl->resume();
+}
+
+void RecursiveINotify::reportMetrics(std::ostream &out) const {
+  pImpl->reportMetrics(out);
+}
+
+void RecursiveINotify::requestMetadata(unsigned fields) {
+  pImpl->requestMetadata(fields);
+}
+
+bool RecursiveINotify::reconfigure(Options const &options) {
+  pImpl->reconfigure(options.pathToMonitor, options.pathsToExclude);
+  return true;
+}
@@ -1,10 +1,16 @@
 #ifndef RECURSIVE_I_NOTIFY_H
 #define RECURSIVE_I_NOTIFY_H
 
+#include <chrono>
 #include <functional>
 #include <vector>
 #include <string>
 #include "filesystem.h"
+#include "event_scheduler.h"
+#include "file_tailer.h"
+#include "content_hasher.h"
+#include "delta_tracker.h"
+#include "i_notify.h"
 #include "glue/message_provider.h"
 
 struct RecursiveNotifyEvent;
@@ -12,16 +18,46 @@ struct RecursiveNotifyEvent;
 class RecursiveINotify: public MessageProvider {
   class RecursiveINotifyImpl;
 public:
+  // With a non-empty stateFile, the state of the tree is persisted there every stateInterval
+  // and at destruction. On the next start, changes which happened while the service was down
+  // are published as catch-up events.
+  // With an inherited inotify descriptor, its watches are taken as they are, nothing is indexed.
+  // The root and the exclusions can be changed later on with reconfigure().
+  // With scheduling classes, events are published from a separate thread by weighted fair
+  // queueing across the subtrees, see EventScheduler. Otherwise they're published right away.
+  // readerOptions tune the thread reading inotify events.
+  // Bytes appended to files matching tailOptions.patterns are published as NB_TAIL events.
+  // With hashOptions.threads, IN_CLOSE_WRITE events carry the digest of the file, see ContentHasher.
+  // Files matching deltaOptions.patterns get NB_DELTA events, see DeltaTracker. They're worked out
+  // by the hashing threads, so hashOptions.threads mustn't be 0 then.
+  // Metadata subscribers ask for is attached to the events, see MetadataEnricher. Without scheduling
+  // classes, the events of one inotify read() are published with the batch function in one call,
+  // if there's one, and so are events enriched together.
   explicit RecursiveINotify(std::function<void(RecursiveNotifyEvent)>,
                             fs::path const &path,
-                            std::vector<std::string> pathsToSkip = {});
+                            std::vector<std::string> pathsToSkip = {},
+                            fs::path stateFile = {},
+                            std::chrono::seconds stateInterval = {},
+                            HandoffState const &inherited = {},
+                            std::vector<EventScheduler::Class> classes = {},
+                            ReaderOptions readerOptions = {},
+                            TailOptions tailOptions = {},
+                            HashOptions hashOptions = {},
+                            DeltaOptions deltaOptions = {},
+                            std::function<void(std::vector<RecursiveNotifyEvent> &)> batchFn = {});
   ~RecursiveINotify();
   RecursiveINotify(RecursiveINotify const &) = delete;
   RecursiveINotify& operator=(RecursiveINotify const&) = delete;
+
+  // Applies options.pathToMonitor and options.pathsToExclude
+  bool reconfigure(Options const &options) override;
 private:
   std::unique_ptr<RecursiveINotifyImpl> pImpl;
-  void logFiltered(std::string const &ss, int filteringMask) const override;
   void logSubscribing(int mask) const override;
+  void reportMetrics(std::ostream &out) const override;
+  void requestMetadata(unsigned fields) override;
+  bool suspend(HandoffState &state) override;
+  void resume() override;
 };
 
 #endif
@@ -1,15 +1,69 @@
 #ifndef RECURSIVE_NOTIFY_EVENT_H
 #define RECURSIVE_NOTIFY_EVENT_H
 
+#include <cstdint>
+#include <memory>
+#include <optional>
 #include <string>
+#include <vector>
 
 struct NotifyEvent;
 
+// Not an inotify bit: bytes appended to a tailed file
+constexpr uint32_t NB_TAIL = 0x00100000;
+
+// Not an inotify bit: what changed in a file since its previous IN_CLOSE_WRITE
+constexpr uint32_t NB_DELTA = 0x00200000;
+
+struct TailData {
+  uint64_t offset = 0;    // of data in the file
+  std::string data;
+  bool truncated = false; // the file shrank, it's read from the start again
+  bool rotated = false;   // another file under the same name
+};
+
+// Bytes of the new file which are neither in ranges nor moved are where they were in the old one
+struct DeltaData {
+  struct Range {       // bytes not found in the old file
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    uint64_t hash = 0; // XXH64 of the bytes
+    std::string data;  // if asked for
+  };
+  struct Move {        // bytes found at another offset of the old file
+    uint64_t offset = 0;
+    uint64_t from = 0;
+    uint64_t length = 0;
+  };
+  uint64_t size = 0;   // of the new file
+  uint32_t blockSize = 0;
+  bool withData = false;
+  std::vector<Range> changed;
+  std::vector<Move> moved;
+};
+
+// see glue/metadata_fields.h
+struct Metadata {
+  unsigned fields = 0; // MD_* bits of what's known
+  uint64_t size = 0;
+  int64_t mtimeNs = 0;
+  uint64_t ino = 0;
+  uint32_t mode = 0;   // type and permission bits
+  uint32_t uid = 0;
+  uint32_t gid = 0;
+};
+
 struct RecursiveNotifyEvent {
   uint32_t mask;
   uint32_t cookie;
   std::string path;
   std::string name;
+  uint32_t pathId = 0;  // of path in the directory registry, never reused for another one. 0: none
+  bool catchUp = false; // synthesized at startup, happened while the service was down
+  std::shared_ptr<TailData const> tail = {}; // NB_TAIL events only
+  std::optional<uint64_t> hash = {};         // XXH64 of the content, IN_CLOSE_WRITE events only
+  std::shared_ptr<DeltaData const> delta = {}; // NB_DELTA events only
+  std::optional<Metadata> metadata = {};       // if asked for
 };
  
 #endif
@@ -0,0 +1,191 @@
+#include "content_hasher.h"
+#include "xxhash64.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/inotify.h>
+#include "helper.h"
+
+namespace {
+uint64_t xxh64(std::string const &s) {
+  XXHash64 h;
+  h.update(s.data(), s.size());
+  return h.digest();
+}
+
+RecursiveNotifyEvent closeWrite(std::string const &name) {
+  return {.mask = IN_CLOSE_WRITE, .cookie = 0, .path = ".", .name = name};
+}
+} //namespace
+
+SCENARIO("XXH64") {
+  GIVEN("The reference digests") {
+    CHECK(xxh64("") == 0xEF46DB3751D8E999ULL);
+    CHECK(xxh64("a") == 0xD24EC4F1A98C6E5BULL);
+    CHECK(xxh64("abc") == 0x44BC2CF5AD770999ULL);
+  }
+
+  GIVEN("Input fed in pieces") {
+    std::string data;
+    for (int i = 0; i < 1000; ++i) {
+      data += std::to_string(i);
+    }
+    for (size_t piece: {1, 7, 31, 32, 33, 100}) {
+      XXHash64 h;
+      for (size_t pos = 0; pos < data.size(); pos += piece) {
+        auto chunk = data.substr(pos, piece);
+        h.update(chunk.data(), chunk.size());
+      }
+      CHECK(h.digest() == xxh64(data));
+    }
+  }
+}
+
+SCENARIO("Hashing closed files") {
+  GIVEN("Some files") {
+    init_logging();
+    auto ph = createTempDir("test_hasher_");
+    {std::ofstream(ph/"a") << "abc";}
+    {std::ofstream(ph/"b") << std::string(3 * 1024 * 1024 + 5, 'x');}
+
+    std::mutex mtx;
+    std::vector<RecursiveNotifyEvent> events;
+    auto callback = [&](RecursiveNotifyEvent rne) {
+      std::lock_guard<std::mutex> lg(mtx);
+      events.push_back(std::move(rne));
+    };
+
+    WHEN("They're hashed") {
+      std::stringstream metrics;
+      {
+        ContentHasher hasher(HashOptions{.threads = 2}, callback);
+        hasher.submit(ph/"a", closeWrite("a"));
+        hasher.submit(ph/"b", closeWrite("b"));
+        hasher.submit(ph/"gone", closeWrite("gone"));
+        for (int i = 0; i < 500; ++i) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+          std::lock_guard<std::mutex> lg(mtx);
+          if (events.size() == 3) {
+            break;
+          }
+        }
+        hasher.reportMetrics(metrics);
+      }
+
+      THEN("Each event is published once, with the digest of its file") {
+        REQUIRE(events.size() == 3);
+        for (auto &e: events) {
+          if (e.name == "a") {
+            REQUIRE(e.hash);
+            CHECK(*e.hash == xxh64("abc"));
+          } else if (e.name == "b") {
+            REQUIRE(e.hash);
+            CHECK(*e.hash == xxh64(std::string(3 * 1024 * 1024 + 5, 'x')));
+          } else {
+            CHECK(e.name == "gone");
+            CHECK_FALSE(e.hash);
+          }
+        }
+        CHECK(metrics.str().find("notibeast_hashed_files_total 2\n") != std::string::npos);
+        CHECK(metrics.str().find("notibeast_hashed_bytes_total 3145736\n") != std::string::npos);
+        CHECK(metrics.str().find("notibeast_hash_skipped_total 1\n") != std::string::npos);
+      }
+    }
+
+    WHEN("A file is tracked for deltas") {
+      DeltaTracker delta(DeltaOptions{.patterns = {"/a"}, .storeDir = ph/"signatures", .blockSize = 2});
+      {
+        ContentHasher hasher(HashOptions{.threads = 1}, callback, &delta);
+        hasher.submit(ph/"a", closeWrite("a"));
+        for (int i = 0; i < 500; ++i) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+          std::lock_guard<std::mutex> lg(mtx);
+          if (events.size() == 2) {
+            break;
+          }
+        }
+      }
+
+      THEN("What changed is published right before IN_CLOSE_WRITE") {
+        REQUIRE(events.size() == 2);
+        CHECK(events[0].mask == NB_DELTA);
+        CHECK(events[0].name == "a");
+        REQUIRE(events[0].delta);
+        CHECK(events[0].delta->size == 3);
+        CHECK(events[1].mask == IN_CLOSE_WRITE);
+        CHECK(events[1].hash);
+      }
+    }
+
+    WHEN("A file is closed again before it's hashed") {
+      {
+        // no workers: nothing is hashed, what is left is published at destruction
+        ContentHasher hasher(HashOptions{.threads = 0, .maxQueued = 1}, callback);
+        auto first = closeWrite("a");
+        first.cookie = 1;
+        hasher.submit(ph/"a", first);
+        hasher.submit(ph/"a", closeWrite("a"));
+        hasher.submit(ph/"b", closeWrite("b"));
+        std::lock_guard<std::mutex> lg(mtx);
+        REQUIRE(events.size() == 2);
+      }
+
+      THEN("The older event is published right away, without a digest") {
+        CHECK(events[0].name == "a");
+        CHECK(events[0].cookie == 1);
+        CHECK_FALSE(events[0].hash);
+        AND_THEN("So are events beyond the queue limit") {
+          CHECK(events[1].name == "b");
+          CHECK_FALSE(events[1].hash);
+        }
+        AND_THEN("Nothing is lost at destruction") {
+          REQUIRE(events.size() == 3);
+          CHECK(events[2].name == "a");
+          CHECK(events[2].cookie == 0);
+        }
+      }
+    }
+
+    WHEN("A file is removed before it's hashed") {
+      std::size_t published;
+      {
+        ContentHasher hasher(HashOptions{.threads = 0}, callback);
+        hasher.submit(ph/"a", closeWrite("a"));
+        hasher.drop(ph/"a");
+        hasher.drop(ph/"b");
+        std::lock_guard<std::mutex> lg(mtx);
+        published = events.size();
+      }
+
+      THEN("Its event is published right away, without a digest, and only once") {
+        CHECK(published == 1);
+        REQUIRE(events.size() == 1);
+        CHECK(events[0].name == "a");
+        CHECK_FALSE(events[0].hash);
+      }
+    }
+
+    WHEN("A file is removed while it's being hashed") {
+      {
+        ContentHasher hasher(HashOptions{.threads = 1, .readSize = 16}, callback);
+        hasher.submit(ph/"b", closeWrite("b"));
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        hasher.drop(ph/"b");
+        std::lock_guard<std::mutex> lg(mtx);
+        REQUIRE(events.size() == 1);
+      }
+
+      THEN("Its event isn't published again once the worker is done") {
+        REQUIRE(events.size() == 1);
+        CHECK(events[0].name == "b");
+      }
+    }
+  }
+}
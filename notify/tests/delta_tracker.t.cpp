@@ -0,0 +1,114 @@
+#include "delta_tracker.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include "helper.h"
+
+namespace {
+std::shared_ptr<DeltaData const> pass(DeltaTracker const &tracker, std::string const &file, std::string const &content) {
+  auto p = tracker.begin(file);
+  // in pieces, as a file is read
+  for (size_t pos = 0; pos < content.size(); pos += 3) {
+    auto piece = content.substr(pos, 3);
+    p->update(piece.data(), piece.size());
+  }
+  return p->finish();
+}
+
+uint64_t xxh64(std::string const &s) {
+  XXHash64 h;
+  h.update(s.data(), s.size());
+  return h.digest();
+}
+} //namespace
+
+SCENARIO("Block deltas") {
+  GIVEN("A tracker with 4 byte blocks") {
+    init_logging();
+    auto ph = createTempDir("test_delta_");
+    DeltaOptions options{.patterns = {"docs/"}, .storeDir = ph/"signatures", .blockSize = 4, .withData = true};
+    DeltaTracker tracker(options);
+    std::string const file = "/share/docs/a.txt";
+
+    CHECK(tracker.matches(file));
+    CHECK_FALSE(tracker.matches("/share/a.txt"));
+
+    WHEN("A file is seen for the first time") {
+      auto delta = pass(tracker, file, "0123456789");
+
+      THEN("It's all new") {
+        CHECK(delta->size == 10);
+        REQUIRE(delta->changed.size() == 1);
+        CHECK(delta->changed[0].offset == 0);
+        CHECK(delta->changed[0].length == 10);
+        CHECK(delta->changed[0].hash == xxh64("0123456789"));
+        CHECK(delta->changed[0].data == "0123456789");
+        CHECK(delta->moved.empty());
+      }
+    }
+
+    WHEN("A block is rewritten") {
+      pass(tracker, file, "aaaabbbbccccdd");
+      auto delta = pass(tracker, file, "aaaaBBBBccccdd");
+
+      THEN("Only that block changed") {
+        REQUIRE(delta->changed.size() == 2);
+        CHECK(delta->changed[0].offset == 4);
+        CHECK(delta->changed[0].data == "BBBB");
+        CHECK(delta->changed[0].hash == xxh64("BBBB"));
+        // the short last block is never looked for
+        CHECK(delta->changed[1].offset == 12);
+        CHECK(delta->changed[1].data == "dd");
+        CHECK(delta->moved.empty());
+      }
+    }
+
+    WHEN("Bytes are inserted at the start") {
+      pass(tracker, file, "aaaabbbbcccc");
+      auto delta = pass(tracker, file, "xyaaaabbbbcccc");
+
+      THEN("The old blocks are found further on") {
+        REQUIRE(delta->changed.size() == 1);
+        CHECK(delta->changed[0].offset == 0);
+        CHECK(delta->changed[0].data == "xy");
+        REQUIRE(delta->moved.size() == 1);
+        CHECK(delta->moved[0].offset == 2);
+        CHECK(delta->moved[0].from == 0);
+        CHECK(delta->moved[0].length == 12);
+      }
+    }
+
+    WHEN("The tracker is restarted") {
+      pass(tracker, file, "aaaabbbbcccc");
+      DeltaTracker restarted(options);
+      auto delta = pass(restarted, file, "aaaabbbbcccc");
+
+      THEN("The signatures are still there") {
+        CHECK(delta->changed.empty());
+        CHECK(delta->moved.empty());
+      }
+      AND_WHEN("The file is gone") {
+        restarted.forget(file);
+        auto again = pass(restarted, file, "aaaabbbbcccc");
+
+        THEN("So are its signatures") {
+          REQUIRE(again->changed.size() == 1);
+          CHECK(again->changed[0].length == 12);
+        }
+      }
+    }
+
+    WHEN("Too much changed to send along") {
+      options.maxData = 8;
+      DeltaTracker small(options);
+      auto delta = pass(small, file, "0123456789");
+
+      THEN("Only the ranges are sent") {
+        CHECK_FALSE(delta->withData);
+        REQUIRE(delta->changed.size() == 1);
+        CHECK(delta->changed[0].length == 10);
+        CHECK(delta->changed[0].data.empty());
+      }
+    }
+  }
+}
@@ -0,0 +1,208 @@
+#include "event_cbor.h"
+#include "event_cbor_decoder.h"
+#include "event_json.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/inotify.h>
+
+namespace {
+std::string toCbor(RecursiveNotifyEvent const &event) {
+  std::string res;
+  appendEventCbor(res, event);
+  return res;
+}
+
+std::string hex(std::string const &s) {
+  static constexpr char digits[] = "0123456789abcdef";
+  std::string res;
+  for (unsigned char c: s) {
+    res += digits[c >> 4];
+    res += digits[c & 15];
+  }
+  return res;
+}
+
+// Encoding and decoding, in ns/event
+template <class F>
+double nsPerEvent(std::vector<RecursiveNotifyEvent> const &events, F &&serialize) {
+  size_t total = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < 10; ++round) {
+    for (auto &e: events) {
+      total += serialize(e);
+    }
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  REQUIRE(total > 0);
+  return elapsed.count() / (10 * events.size());
+}
+} //namespace
+
+SCENARIO("Events as CBOR") {
+  GIVEN("An event") {
+    RecursiveNotifyEvent event{.mask = IN_CREATE | IN_ISDIR, .cookie = 7, .path = "a/b", .name = "foo"};
+
+    THEN("It's a map of small integer keys") {
+      // {0: "a/b", 1: "foo", 2: 1073742080, 3: 7}
+      CHECK(hex(toCbor(event)) == "a4" "00" "63612f62" "01" "63666f6f" "02" "1a40000100" "0307");
+    }
+    THEN("It's much smaller than the JSON") {
+      std::string json;
+      appendEventJson(json, event);
+      CHECK(toCbor(event).size() == 19);
+      CHECK(json.size() == 56);
+    }
+    THEN("The reference decoder reads it back") {
+      auto decoded = EventCborDecoder(toCbor(event)).decode();
+      CHECK(decoded.mask == event.mask);
+      CHECK(decoded.cookie == 7);
+      CHECK(decoded.path == "a/b");
+      CHECK(decoded.name == "foo");
+      CHECK_FALSE(decoded.catchUp);
+      CHECK_FALSE(decoded.tail);
+      CHECK_FALSE(decoded.hash);
+      CHECK_FALSE(decoded.delta);
+      CHECK_FALSE(decoded.metadata);
+    }
+    THEN("Truncated messages are rejected") {
+      auto cbor = toCbor(event);
+      CHECK_THROWS(EventCborDecoder(std::string_view(cbor).substr(0, cbor.size() - 1)).decode());
+    }
+    THEN("Its directory can go as an id, defined on its own") {
+      event.pathId = 300;
+      std::string cbor;
+      appendEventCbor(cbor, event, true);
+      // {20: 300, 1: "foo", ...}
+      CHECK(hex(cbor).substr(0, 8) == "a4" "14" "19" "01");
+      auto decoded = EventCborDecoder(cbor).decode();
+      CHECK(decoded.pathId == 300);
+      CHECK(decoded.path.empty());
+      cbor.clear();
+      appendPathDefinitionCbor(cbor, event.pathId, event.path);
+      // {21: 300, 0: "a/b"}
+      CHECK(hex(cbor) == "a2" "15" "19012c" "00" "63612f62");
+      cbor.clear();
+      appendPathResetCbor(cbor);
+      CHECK(hex(cbor) == "a1" "16" "f5");
+    }
+  }
+
+  GIVEN("A name which isn't UTF-8") {
+    RecursiveNotifyEvent event{.mask = 2, .cookie = 0, .path = ".", .name = "Caf\xe9"};
+
+    THEN("It's sent as bytes") {
+      CHECK(hex(toCbor(event)).substr(0, 20) == "a4" "00" "612e" "01" "44436166e9");
+      CHECK(EventCborDecoder(toCbor(event)).decode().name == event.name);
+    }
+  }
+
+  GIVEN("Numbers of every size") {
+    for (uint64_t n: {0ULL, 23ULL, 24ULL, 255ULL, 256ULL, 65535ULL, 65536ULL, 0xffffffffULL, 0x100000000ULL, ~0ULL}) {
+      RecursiveNotifyEvent event{.mask = 1, .cookie = 0, .path = ".", .name = "", .hash = n};
+      CHECK(*EventCborDecoder(toCbor(event)).decode().hash == n);
+    }
+  }
+
+  GIVEN("Extras") {
+    auto tail = std::make_shared<TailData>(TailData{.offset = 3, .data = std::string("ab\0\xff", 4), .truncated = true, .rotated = false});
+    RecursiveNotifyEvent tailed{.mask = NB_TAIL, .cookie = 0, .path = ".", .name = "log", .catchUp = true, .tail = tail, .hash = 0xabcULL};
+    Metadata md{.fields = MD_MTIME | MD_INO | MD_TYPE | MD_MODE | MD_UID | MD_GID, .size = 0,
+                .mtimeNs = -5, .ino = 1ULL << 40, .mode = S_IFDIR | 0755, .uid = 1000, .gid = 100};
+    tailed.metadata = md;
+
+    THEN("They're read back") {
+      auto decoded = EventCborDecoder(toCbor(tailed)).decode();
+      CHECK(decoded.catchUp);
+      REQUIRE(decoded.tail);
+      CHECK(decoded.tail->offset == 3);
+      CHECK(decoded.tail->data == tail->data); // as bytes, not base64
+      CHECK(decoded.tail->truncated);
+      CHECK_FALSE(decoded.tail->rotated);
+      CHECK(*decoded.hash == 0xabc);
+      REQUIRE(decoded.metadata);
+      CHECK(decoded.metadata->fields == md.fields);
+      CHECK(decoded.metadata->mtimeNs == -5);
+      CHECK(decoded.metadata->ino == md.ino);
+      CHECK(decoded.metadata->mode == md.mode);
+      CHECK(decoded.metadata->uid == 1000);
+      CHECK(decoded.metadata->gid == 100);
+    }
+    THEN("A projection leaves out the rest") {
+      std::string cbor;
+      appendEventCbor(cbor, tailed, false, Projection{.fields = EF_NAME | EF_XXH64, .metadata = MD_INO});
+      auto decoded = EventCborDecoder(cbor).decode();
+      CHECK(decoded.name == "log");
+      CHECK(decoded.path.empty());
+      CHECK(decoded.mask == 0);
+      CHECK_FALSE(decoded.catchUp);
+      CHECK_FALSE(decoded.tail);
+      CHECK(*decoded.hash == 0xabc);
+      REQUIRE(decoded.metadata);
+      CHECK(decoded.metadata->fields == MD_INO);
+    }
+
+    auto delta = std::make_shared<DeltaData>();
+    delta->size = 131074;
+    delta->blockSize = 65536;
+    delta->withData = true;
+    delta->changed.push_back({.offset = 0, .length = 2, .hash = 42, .data = "xy"});
+    delta->moved.push_back({.offset = 2, .from = 0, .length = 131072});
+    RecursiveNotifyEvent changed{.mask = NB_DELTA, .cookie = 0, .path = "docs", .name = "a.txt", .delta = delta};
+
+    THEN("So are deltas") {
+      auto decoded = EventCborDecoder(toCbor(changed)).decode();
+      REQUIRE(decoded.delta);
+      CHECK(decoded.delta->size == 131074);
+      CHECK(decoded.delta->blockSize == 65536);
+      CHECK(decoded.delta->withData);
+      REQUIRE(decoded.delta->changed.size() == 1);
+      CHECK(decoded.delta->changed[0].length == 2);
+      CHECK(decoded.delta->changed[0].hash == 42);
+      CHECK(decoded.delta->changed[0].data == "xy");
+      REQUIRE(decoded.delta->moved.size() == 1);
+      CHECK(decoded.delta->moved[0].offset == 2);
+      CHECK(decoded.delta->moved[0].length == 131072);
+      CHECK_FALSE(decoded.metadata);
+    }
+  }
+}
+
+TEST_CASE("Wire formats", "[.][benchmark]") {
+  std::vector<RecursiveNotifyEvent> events;
+  for (uint32_t i = 0; i < 100000; ++i) {
+    events.push_back({.mask = IN_CLOSE_WRITE, .cookie = i, .path = "photos/2023/summer",
+                      .name = "IMG_" + std::to_string(i) + ".jpg", .hash = 0x9e3779b97f4a7c15ULL * i});
+  }
+
+  size_t jsonBytes = 0, cborBytes = 0;
+  std::string buf;
+  auto json = [&buf, &jsonBytes](RecursiveNotifyEvent const &e) {
+    buf.clear();
+    appendEventJson(buf, e);
+    buf += '\n';
+    jsonBytes += buf.size();
+    return buf.size();
+  };
+  auto cbor = [&buf, &cborBytes](RecursiveNotifyEvent const &e) {
+    buf.clear();
+    appendEventCbor(buf, e);
+    cborBytes += buf.size();
+    return buf.size();
+  };
+  auto cborDecoded = [&buf](RecursiveNotifyEvent const &e) {
+    buf.clear();
+    appendEventCbor(buf, e);
+    return EventCborDecoder(buf).decode().name.size();
+  };
+
+  auto jsonNs = nsPerEvent(events, json);
+  auto cborNs = nsPerEvent(events, cbor);
+  std::cout << "JSON: " << jsonBytes / (10. * events.size()) << " bytes/event, " << jsonNs << " ns/event\n"
+            << "CBOR: " << cborBytes / (10. * events.size()) << " bytes/event, " << cborNs << " ns/event, "
+            << nsPerEvent(events, cborDecoded) - cborNs << " ns/event to decode with the reference decoder\n";
+  CHECK(cborBytes < jsonBytes);
+}
@@ -0,0 +1,169 @@
+#ifndef EVENT_CBOR_DECODER_H
+#define EVENT_CBOR_DECODER_H
+
+// A reference decoder of events in the CBOR format (see event_cbor.h), written
+// for clarity rather than speed. Clients may take it as a starting point, any
+// CBOR library reads the messages as well.
+
+#include "event_cbor.h"
+#include "glue/metadata_fields.h"
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+
+class EventCborDecoder {
+public:
+  explicit EventCborDecoder(std::string_view message): in{message} {}
+
+  RecursiveNotifyEvent decode() {
+    RecursiveNotifyEvent event{.mask = 0, .cookie = 0, .path = {}, .name = {}};
+    std::shared_ptr<TailData> tail;
+    std::shared_ptr<DeltaData> delta;
+    Metadata md;
+    auto needTail = [&tail] () -> TailData & {
+      if (!tail) tail = std::make_shared<TailData>();
+      return *tail;
+    };
+    auto needDelta = [&delta] () -> DeltaData & {
+      if (!delta) delta = std::make_shared<DeltaData>();
+      return *delta;
+    };
+
+    for (auto entries = head(5); entries; --entries) {
+      switch (head(0)) {
+        case CK_PATH: event.path = fileName(); break;
+        case CK_NAME: event.name = fileName(); break;
+        case CK_MASK: event.mask = uint32_t(head(0)); break;
+        case CK_COOKIE: event.cookie = uint32_t(head(0)); break;
+        case CK_CATCHUP: event.catchUp = boolean(); break;
+        case CK_OFFSET: needTail().offset = head(0); break;
+        case CK_DATA: needTail().data = string(2); break;
+        case CK_TRUNCATED: needTail().truncated = boolean(); break;
+        case CK_ROTATED: needTail().rotated = boolean(); break;
+        case CK_XXH64: event.hash = head(0); break;
+        case CK_SIZE: md.size = head(0); md.fields |= MD_SIZE; break;
+        case CK_BLOCK_SIZE: needDelta().blockSize = uint32_t(head(0)); break;
+        case CK_CHANGED:
+          for (auto n = head(4); n; --n) {
+            auto items = head(4);
+            DeltaData::Range r;
+            r.offset = head(0);
+            r.length = head(0);
+            r.hash = head(0);
+            if (items == 4) {
+              r.data = string(2);
+              needDelta().withData = true;
+            }
+            needDelta().changed.push_back(std::move(r));
+          }
+          break;
+        case CK_MOVED:
+          for (auto n = head(4); n; --n) {
+            if (head(4) != 3) {
+              throw std::runtime_error("A move is [offset, from, length]");
+            }
+            DeltaData::Move m;
+            m.offset = head(0);
+            m.from = head(0);
+            m.length = head(0);
+            needDelta().moved.push_back(m);
+          }
+          break;
+        case CK_MTIME: md.mtimeNs = integer(); md.fields |= MD_MTIME; break;
+        case CK_INO: md.ino = head(0); md.fields |= MD_INO; break;
+        case CK_TYPE: md.mode |= modeOfType(string(3)); md.fields |= MD_TYPE; break;
+        case CK_MODE: md.mode |= uint32_t(head(0)); md.fields |= MD_MODE; break;
+        case CK_UID: md.uid = uint32_t(head(0)); md.fields |= MD_UID; break;
+        case CK_GID: md.gid = uint32_t(head(0)); md.fields |= MD_GID; break;
+        case CK_PATH_ID: event.pathId = uint32_t(head(0)); break;
+        default: throw std::runtime_error("Unknown key");
+      }
+    }
+    if (pos != in.size()) {
+      throw std::runtime_error("Trailing bytes");
+    }
+
+    event.tail = tail;
+    if (delta) { // the size is the one of the new content then
+      delta->size = md.size;
+      md.fields &= ~MD_SIZE;
+      event.delta = delta;
+    }
+    if (md.fields) {
+      event.metadata = md;
+    }
+    return event;
+  }
+
+private:
+  uint8_t byte() {
+    if (pos == in.size()) {
+      throw std::runtime_error("Truncated message");
+    }
+    return uint8_t(in[pos++]);
+  }
+
+  // Reads the head of an item of the major type, returns its number
+  uint64_t head(int major) {
+    auto initial = byte();
+    if (initial >> 5 != major) {
+      throw std::runtime_error("Unexpected major type " + std::to_string(initial >> 5));
+    }
+    uint64_t n = initial & 31;
+    int follow = n < 24 ? 0 : n == 24 ? 1 : n == 25 ? 2 : n == 26 ? 4 : n == 27 ? 8 : -1;
+    if (follow < 0) {
+      throw std::runtime_error("Indefinite lengths are never sent");
+    }
+    if (follow) {
+      n = 0;
+      while (follow--) {
+        n = n << 8 | byte();
+      }
+    }
+    return n;
+  }
+
+  std::string string(int major) {
+    auto len = head(major);
+    if (len > in.size() - pos) {
+      throw std::runtime_error("Truncated string");
+    }
+    std::string res(in.substr(pos, len));
+    pos += len;
+    return res;
+  }
+
+  // text, or bytes if it isn't UTF-8
+  std::string fileName() {
+    return string(pos < in.size() && uint8_t(in[pos]) >> 5 == 2 ? 2 : 3);
+  }
+
+  int64_t integer() {
+    if (pos < in.size() && uint8_t(in[pos]) >> 5 == 1) {
+      return -1 - int64_t(head(1));
+    }
+    return int64_t(head(0));
+  }
+
+  bool boolean() {
+    if (byte() != 0xf5) {
+      throw std::runtime_error("Flags are always true");
+    }
+    return true;
+  }
+
+  static uint32_t modeOfType(std::string const &type) {
+    if (type == "file") return S_IFREG;
+    if (type == "dir") return S_IFDIR;
+    if (type == "symlink") return S_IFLNK;
+    return 0;
+  }
+
+  std::string_view in;
+  size_t pos = 0;
+};
+
+#endif
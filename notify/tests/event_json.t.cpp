@@ -0,0 +1,145 @@
+#include "event_json.h"
+#include "i_notify_helper.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <boost/json.hpp>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace js = boost::json;
+
+namespace {
+std::string toJson(RecursiveNotifyEvent const &event, bool symbolicMask = false) {
+  std::string res;
+  appendEventJson(res, event, symbolicMask);
+  return res;
+}
+
+// how events were serialized before, through a Boost.JSON value and a stringstream
+std::string viaBoostJson(RecursiveNotifyEvent const &event) {
+  js::object obj;
+  obj["path"] = event.path;
+  obj["name"] = event.name;
+  obj["mask"] = event.mask;
+  obj["cookie"] = event.cookie;
+  std::stringstream message;
+  message << js::serialize(js::value(std::move(obj)));
+  return message.str() + "\n";
+}
+
+template <class F>
+double nsPerEvent(std::vector<RecursiveNotifyEvent> const &events, F &&serialize) {
+  size_t total = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < 10; ++round) {
+    for (auto &e: events) {
+      total += serialize(e);
+    }
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  REQUIRE(total > 0);
+  return elapsed.count() / (10 * events.size());
+}
+} //namespace
+
+SCENARIO("Events as JSON") {
+  GIVEN("An event") {
+    RecursiveNotifyEvent event{.mask = IN_CREATE | IN_ISDIR, .cookie = 7, .path = "a/b", .name = "foo"};
+
+    THEN("It's written as one line") {
+      CHECK(toJson(event) == R"({"path":"a/b","name":"foo","mask":1073742080,"cookie":7})");
+    }
+    THEN("The mask can be written with names") {
+      CHECK(toJson(event, true) == R"({"path":"a/b","name":"foo","mask":"IN_CREATE|IN_ISDIR","cookie":7})");
+      CHECK(strMask(IN_MODIFY | 0x40000000) == "IN_MODIFY|IN_ISDIR");
+      CHECK(strMask(IN_OPEN | 0x04000000) == "IN_OPEN|Undetected mask: 0x4000000");
+    }
+    THEN("It's appended to what's in the buffer") {
+      std::string buf = "x";
+      appendEventJson(buf, event);
+      CHECK(buf.size() == 1 + toJson(event).size());
+    }
+    THEN("Its directory can go as an id, defined on its own") {
+      event.pathId = 5;
+      std::string json;
+      appendEventJson(json, event, false, true);
+      CHECK(json == R"({"pathId":5,"name":"foo","mask":1073742080,"cookie":7})");
+      json.clear();
+      appendPathDefinitionJson(json, event.pathId, event.path);
+      CHECK(json == R"({"define":5,"path":"a/b"})");
+      json.clear();
+      appendPathResetJson(json);
+      CHECK(json == R"({"reset":"paths"})");
+    }
+    THEN("Only the fields of a projection are written") {
+      std::string json;
+      appendEventJson(json, event, false, false, Projection{.fields = EF_NAME | EF_COOKIE});
+      CHECK(json == R"({"name":"foo","cookie":7})");
+      json.clear();
+      appendEventJson(json, event, false, true, Projection{.fields = EF_PATH | EF_MASK});
+      CHECK(json == R"({"pathId":0,"mask":1073742080})");
+      json.clear();
+      appendEventJson(json, event, false, false, Projection{.fields = 0});
+      CHECK(json == "{}");
+    }
+  }
+
+  GIVEN("Names which need escaping") {
+    RecursiveNotifyEvent event{.mask = 2, .cookie = 0, .path = ".", .name = "q\"b\\s\n\t\x01/\xc3\xa9\xe2\x82\xac"};
+
+    THEN("Control characters, quotes and backslashes are escaped, the rest is copied") {
+      CHECK(toJson(event) == "{\"path\":\".\",\"name\":\"q\\\"b\\\\s\\n\\t\\u0001/\xc3\xa9\xe2\x82\xac\",\"mask\":2,\"cookie\":0}");
+      auto json = toJson(event);
+      auto parsed = js::parse(js::string_view(json));
+      CHECK(std::string_view(parsed.as_object().at("name").as_string()) == event.name);
+    }
+  }
+
+  GIVEN("Names which aren't UTF-8") {
+    RecursiveNotifyEvent event{.mask = 2, .cookie = 0, .path = "Caf\xe9", .name = "\xc3\xa9\xc3\x28\xed\xa0\x80\xf0\x9f\x98"};
+
+    THEN("Each byte which isn't part of a valid sequence goes as a lone surrogate") {
+      CHECK(toJson(event) == "{\"path\":\"Caf\\udce9\",\"name\":\"\xc3\xa9\\udcc3(\\udced\\udca0\\udc80\\udcf0\\udc9f\\udc98\",\"mask\":2,\"cookie\":0}");
+    }
+  }
+
+  GIVEN("Extras") {
+    auto tail = std::make_shared<TailData>(TailData{.offset = 3, .data = "abcd", .truncated = false, .rotated = true});
+    RecursiveNotifyEvent event{.mask = NB_TAIL, .cookie = 0, .path = ".", .name = "log", .catchUp = true, .tail = tail, .hash = 0xabcULL};
+
+    THEN("They follow the common fields") {
+      CHECK(toJson(event) == R"({"path":".","name":"log","mask":1048576,"cookie":0,"catchup":true,)"
+                             R"("offset":3,"data":"YWJjZA==","rotated":true,"xxh64":"0000000000000abc"})");
+    }
+  }
+}
+
+TEST_CASE("Event serialization", "[.][benchmark]") {
+  std::vector<RecursiveNotifyEvent> ascii, nonAscii;
+  for (uint32_t i = 0; i < 100000; ++i) {
+    ascii.push_back({.mask = IN_CLOSE_WRITE, .cookie = i, .path = "photos/2023/summer",
+                     .name = "IMG_" + std::to_string(i) + ".jpg"});
+    nonAscii.push_back({.mask = IN_CLOSE_WRITE, .cookie = i, .path = "\xd0\xa4\xd0\xbe\xd1\x82\xd0\xbe/2023",
+                        .name = "\xe5\x86\x99\xe7\x9c\x9f_" + std::to_string(i) + "_\xc3\xbc\x62\x65rsicht.jpg"});
+  }
+
+  std::string buf;
+  auto writer = [&buf](RecursiveNotifyEvent const &e) {
+    buf.clear();
+    appendEventJson(buf, e);
+    buf += '\n';
+    return buf.size();
+  };
+  auto boostJson = [](RecursiveNotifyEvent const &e) {
+    return viaBoostJson(e).size();
+  };
+
+  for (auto &[label, events]: {std::pair{"ASCII", &ascii}, std::pair{"non-ASCII", &nonAscii}}) {
+    CHECK(toJson(events->front()) + "\n" == viaBoostJson(events->front()));
+    std::cout << label << " names: writer " << nsPerEvent(*events, writer) << " ns/event, "
+              << "Boost.JSON " << nsPerEvent(*events, boostJson) << " ns/event\n";
+  }
+}
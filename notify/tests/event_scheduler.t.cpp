@@ -0,0 +1,115 @@
+#include "event_scheduler.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "helper.h"
+
+namespace {
+RecursiveNotifyEvent makeEvent(std::string const &path, int i) {
+  return {.mask = 8, .cookie = 0, .path = path, .name = "f" + std::to_string(i)};
+}
+} //namespace
+
+SCENARIO("Weighted fair scheduling of events") {
+  GIVEN("A scheduler whose fanout is blocked until the queues are filled") {
+    init_logging();
+    std::vector<RecursiveNotifyEvent> events;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool released = false;
+    auto callback=[&](RecursiveNotifyEvent event){
+      std::unique_lock<std::mutex> lck(mtx);
+      cv.wait(lck, [&released]{ return released; });
+      events.push_back(event);
+    };
+    auto release = [&]() {
+      {
+        std::lock_guard<std::mutex> lg(mtx);
+        released = true;
+      }
+      cv.notify_all();
+    };
+
+    WHEN("A noisy subtree is flooded before a quiet one publishes an event") {
+      {
+        EventScheduler scheduler({{"noisy", 1}, {"quiet", 1}}, callback);
+        for (int i = 0; i < 1000; ++i) {
+          scheduler.push(makeEvent("noisy/deep", i));
+        }
+        scheduler.push(makeEvent("quiet", 0));
+        release();
+      }
+
+      THEN("The quiet event doesn't wait for the whole flood") {
+        REQUIRE(events.size() == 1001);
+        auto quiet = std::find_if(events.begin(), events.end(), [](auto const &e) { return e.path == "quiet"; });
+        REQUIRE(quiet != events.end());
+        CHECK(quiet - events.begin() < 30);
+        // each class keeps its order
+        CHECK(events.back().name == "f999");
+      }
+    }
+
+    WHEN("Two subtrees of different weights are flooded") {
+      {
+        EventScheduler scheduler({{"light", 1}, {"heavy", 3}}, callback);
+        for (int i = 0; i < 500; ++i) {
+          scheduler.push(makeEvent("light", i));
+          scheduler.push(makeEvent("heavy", i));
+        }
+        release();
+      }
+
+      THEN("They're served in proportion to the weights") {
+        REQUIRE(events.size() == 1000);
+        auto heavy = std::count_if(events.begin(), events.begin() + 400, [](auto const &e) { return e.path == "heavy"; });
+        CHECK(heavy > 270);
+        CHECK(heavy < 330);
+      }
+    }
+
+    WHEN("Metrics are reported") {
+      std::ostringstream metrics;
+      {
+        EventScheduler scheduler({{"a/b/", 2}}, callback);
+        scheduler.push(makeEvent("a/b", 0));
+        scheduler.push(makeEvent("a/bc", 0));
+        release();
+        while (true) {
+          std::lock_guard<std::mutex> lg(mtx);
+          if (events.size() == 2) {
+            break;
+          }
+        }
+        scheduler.reportMetrics(metrics);
+      }
+
+      THEN("Latency is exported per class") {
+        auto text = metrics.str();
+        CHECK(text.find("notibeast_queue_latency_seconds_count{class=\"a/b\"} 1\n") != std::string::npos);
+        CHECK(text.find("notibeast_queue_latency_seconds_count{class=\".\"} 1\n") != std::string::npos);
+        CHECK(text.find("notibeast_queue_latency_seconds_bucket{class=\"a/b\",le=\"+Inf\"} 1\n") != std::string::npos);
+        CHECK(text.find("notibeast_queue_depth{class=\"a/b\"} 0\n") != std::string::npos);
+      }
+    }
+  }
+
+  GIVEN("Class specifications") {
+    THEN("Valid ones are parsed") {
+      auto cls = EventScheduler::parseClass("photos/2021:8");
+      CHECK(cls.subtree == "photos/2021");
+      CHECK(cls.weight == 8);
+    }
+    THEN("Invalid ones are rejected") {
+      CHECK_THROWS(EventScheduler::parseClass("photos"));
+      CHECK_THROWS(EventScheduler::parseClass("photos:0"));
+      CHECK_THROWS(EventScheduler::parseClass("photos:x"));
+      CHECK_THROWS(EventScheduler::parseClass(":3"));
+    }
+  }
+}
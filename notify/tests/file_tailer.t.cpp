@@ -0,0 +1,155 @@
+#include "file_tailer.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/inotify.h>
+#include "helper.h"
+
+namespace {
+std::string joined(std::vector<std::shared_ptr<TailData const>> const &chunks) {
+  std::string res;
+  for (auto &c: chunks) {
+    res += c->data;
+  }
+  return res;
+}
+} //namespace
+
+SCENARIO("Following appended bytes") {
+  GIVEN("A tailer of *.log files") {
+    init_logging();
+    auto ph = createTempDir("test_tailer_");
+    FileTailer tailer(TailOptions{.patterns = {".log"}, .maxChunk = 4, .maxPending = 16, .maxFiles = 2});
+
+    WHEN("A log is created and appended to") {
+      {std::ofstream(ph/"app.log") << "hello";}
+      auto created = tailer.onEvent(ph, "app.log", IN_CREATE);
+      {std::ofstream(ph/"app.log", std::ios::app) << " world";}
+      auto appended = tailer.onEvent(ph, "app.log", IN_MODIFY);
+
+      THEN("Each appended region is published once, in bounded chunks") {
+        REQUIRE(created.size() == 2);
+        CHECK(created[0]->offset == 0);
+        CHECK(created[0]->data == "hell");
+        CHECK(created[1]->offset == 4);
+        CHECK(created[1]->data == "o");
+        CHECK(joined(appended) == " world");
+        CHECK(appended[0]->offset == 5);
+        CHECK(tailer.onEvent(ph, "app.log", IN_CLOSE_WRITE).empty());
+      }
+    }
+
+    WHEN("A log is truncated") {
+      {std::ofstream(ph/"app.log") << "hello";}
+      tailer.onEvent(ph, "app.log", IN_CREATE);
+      {std::ofstream(ph/"app.log") << "hi";}
+      auto chunks = tailer.onEvent(ph, "app.log", IN_MODIFY);
+
+      THEN("It's read from the start again") {
+        REQUIRE(chunks.size() == 1);
+        CHECK(chunks[0]->offset == 0);
+        CHECK(chunks[0]->data == "hi");
+        CHECK(chunks[0]->truncated);
+      }
+    }
+
+    WHEN("A log is rotated") {
+      {std::ofstream(ph/"app.log") << "old";}
+      tailer.onEvent(ph, "app.log", IN_CREATE);
+      {std::ofstream(ph/"app.log", std::ios::app) << " end";}
+      fs::rename(ph/"app.log", ph/"app.1");
+      auto rest = tailer.onEvent(ph, "app.log", IN_MOVED_FROM);
+      {std::ofstream(ph/"app.log") << "new";}
+      auto chunks = tailer.onEvent(ph, "app.log", IN_CREATE);
+
+      THEN("The end of the old file is not lost, the new one is marked") {
+        CHECK(joined(rest) == " end");
+        REQUIRE(chunks.size() == 1);
+        CHECK(chunks[0]->offset == 0);
+        CHECK(chunks[0]->data == "new");
+        CHECK(chunks[0]->rotated);
+      }
+    }
+
+    WHEN("Much more is appended than allowed at once") {
+      {std::ofstream(ph/"app.log");}
+      tailer.onEvent(ph, "app.log", IN_CREATE);
+      {std::ofstream(ph/"app.log") << std::string(100, 'x');}
+      auto chunks = tailer.onEvent(ph, "app.log", IN_MODIFY);
+
+      THEN("Only the latest bytes are read, the gap shows in the offset") {
+        CHECK(chunks.size() == 4);
+        CHECK(chunks[0]->offset == 84);
+        CHECK(joined(chunks).size() == 16);
+      }
+    }
+
+    WHEN("An existing log is modified for the first time") {
+      {std::ofstream(ph/"app.log") << "before";}
+      auto first = tailer.onEvent(ph, "app.log", IN_MODIFY);
+      {std::ofstream(ph/"app.log", std::ios::app) << "after";}
+      auto second = tailer.onEvent(ph, "app.log", IN_MODIFY);
+
+      THEN("Following starts at its end") {
+        CHECK(first.empty());
+        CHECK(joined(second) == "after");
+      }
+    }
+
+    WHEN("Other files change") {
+      {std::ofstream(ph/"data.bin") << "hello";}
+      THEN("They're not followed") {
+        CHECK(tailer.onEvent(ph, "data.bin", IN_CREATE).empty());
+      }
+    }
+    fs::remove_all(ph);
+  }
+}
+
+SCENARIO("Following appended bytes on a worker") {
+  GIVEN("A tail worker of *.log files") {
+    init_logging();
+    auto ph = createTempDir("test_tailer_");
+    std::mutex mtx;
+    std::vector<RecursiveNotifyEvent> events;
+    auto worker = std::make_unique<TailWorker>(TailOptions{.patterns = {".log"}, .maxChunk = 4, .maxPending = 64},
+                                               [&](RecursiveNotifyEvent rne) {
+      std::lock_guard<std::mutex> lg(mtx);
+      events.push_back(std::move(rne));
+    });
+
+    WHEN("A log is created and appended to, many times over") {
+      {std::ofstream(ph/"app.log") << "hello";}
+      worker->push(ph, "logs", 7, "app.log", IN_CREATE);
+      std::string expected = "hello";
+      for (int i = 0; i < 10; ++i) {
+        {std::ofstream(ph/"app.log", std::ios::app) << i;}
+        expected += std::to_string(i);
+        worker->push(ph, "logs", 7, "app.log", IN_MODIFY);
+      }
+      worker->push(ph, "logs", 7, "data.bin", IN_MODIFY);
+      worker.reset(); // whatever is queued is handled
+
+      THEN("Each appended region is published once, in order, with the path of the events") {
+        std::string data;
+        uint64_t offset = 0;
+        for (auto &rne: events) {
+          CHECK(rne.mask == NB_TAIL);
+          CHECK(rne.path == "logs");
+          CHECK(rne.pathId == 7);
+          CHECK(rne.name == "app.log");
+          REQUIRE(rne.tail);
+          CHECK(rne.tail->offset == offset);
+          offset += rne.tail->data.size();
+          data += rne.tail->data;
+        }
+        CHECK(data == expected);
+      }
+    }
+    fs::remove_all(ph);
+  }
+}
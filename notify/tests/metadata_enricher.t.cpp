@@ -0,0 +1,223 @@
+#include "metadata_enricher.h"
+#include "glue/metadata_fields.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include "helper.h"
+
+SCENARIO("Metadata enrichment") {
+  GIVEN("A tree and an enricher") {
+    init_logging();
+    auto ph = createTempDir("test_enricher_");
+    fs::create_directory(ph/"sub");
+    {std::ofstream(ph/"sub"/"foo") << "hello";}
+
+    std::mutex mtx;
+    std::vector<RecursiveNotifyEvent> events;
+    auto waitFor = [&](size_t n) {
+      for (int i = 0; i < 500; ++i) {
+        {
+          std::lock_guard<std::mutex> lg(mtx);
+          if (events.size() >= n) {
+            return;
+          }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+    };
+    MetadataEnricher enricher(ph, [&](RecursiveNotifyEvent rne) {
+      std::lock_guard<std::mutex> lg(mtx);
+      events.push_back(std::move(rne));
+    });
+
+    WHEN("Nobody asks for metadata") {
+      enricher.push({.mask = IN_CLOSE_WRITE, .cookie = 0, .path = "sub", .name = "foo"});
+
+      THEN("Events go straight through, untouched") {
+        REQUIRE(events.size() == 1);
+        CHECK_FALSE(events[0].metadata);
+      }
+    }
+
+    WHEN("Size and type are asked for") {
+      enricher.setFields(MD_SIZE | MD_TYPE);
+      enricher.push({.mask = IN_CLOSE_WRITE, .cookie = 0, .path = "sub", .name = "foo"});
+      enricher.push({.mask = IN_CREATE | IN_ISDIR, .cookie = 0, .path = ".", .name = "sub"});
+      enricher.push({.mask = IN_DELETE, .cookie = 0, .path = "sub", .name = "gone"});
+      enricher.push({.mask = IN_MODIFY, .cookie = 0, .path = "sub", .name = "foo"});
+      waitFor(4);
+      std::stringstream metrics;
+      enricher.reportMetrics(metrics);
+
+      THEN("Those are gathered, in order") {
+        std::lock_guard<std::mutex> lg(mtx);
+        REQUIRE(events.size() == 4);
+        CHECK(events[0].name == "foo");
+        REQUIRE(events[0].metadata);
+        CHECK(events[0].metadata->fields == (MD_SIZE | MD_TYPE));
+        CHECK(events[0].metadata->size == 5);
+        CHECK(S_ISREG(events[0].metadata->mode));
+        REQUIRE(events[1].metadata);
+        CHECK(S_ISDIR(events[1].metadata->mode));
+        CHECK_FALSE(events[2].metadata);
+        REQUIRE(events[3].metadata);
+        AND_THEN("Directory handles are reused") {
+          CHECK(metrics.str().find("notibeast_metadata_lookups_total 3\n") != std::string::npos);
+          CHECK(metrics.str().find("notibeast_metadata_dirs_opened_total 2\n") != std::string::npos);
+        }
+      }
+    }
+
+    WHEN("A watched directory is replaced") {
+      enricher.setFields(MD_INO);
+      enricher.push({.mask = IN_CLOSE_WRITE, .cookie = 0, .path = "sub", .name = "foo"});
+      waitFor(1);
+      fs::remove_all(ph/"sub");
+      fs::create_directory(ph/"sub");
+      {std::ofstream(ph/"sub"/"foo") << "again";}
+      enricher.push({.mask = IN_CLOSE_WRITE, .cookie = 0, .path = "sub", .name = "foo"});
+      waitFor(2);
+
+      THEN("The new one is looked into") {
+        std::lock_guard<std::mutex> lg(mtx);
+        REQUIRE(events.size() == 2);
+        REQUIRE(events[1].metadata);
+        struct stat st;
+        REQUIRE(stat((ph/"sub"/"foo").c_str(), &st) == 0);
+        CHECK(events[1].metadata->ino == st.st_ino);
+      }
+    }
+
+    WHEN("A watched directory is renamed and another one takes its name") {
+      enricher.setFields(MD_INO);
+      enricher.push({.mask = IN_CLOSE_WRITE, .cookie = 0, .path = "sub", .name = "foo", .pathId = 1});
+      waitFor(1);
+      fs::rename(ph/"sub", ph/"old");
+      fs::create_directory(ph/"sub");
+      {std::ofstream(ph/"sub"/"foo") << "again";}
+      enricher.push({.mask = IN_CLOSE_WRITE, .cookie = 0, .path = "sub", .name = "foo", .pathId = 2});
+      enricher.push({.mask = IN_ATTRIB, .cookie = 0, .path = "sub", .name = "foo", .pathId = 1});
+      waitFor(3);
+
+      THEN("Each event is about the file of its own directory") {
+        std::lock_guard<std::mutex> lg(mtx);
+        REQUIRE(events.size() == 3);
+        struct stat st;
+        REQUIRE(events[1].metadata);
+        REQUIRE(stat((ph/"sub"/"foo").c_str(), &st) == 0);
+        CHECK(events[1].metadata->ino == st.st_ino);
+        REQUIRE(events[2].metadata);
+        REQUIRE(stat((ph/"old"/"foo").c_str(), &st) == 0);
+        CHECK(events[2].metadata->ino == st.st_ino);
+      }
+    }
+  }
+
+  GIVEN("An enricher passing events on a batch at a time") {
+    init_logging();
+    auto ph = createTempDir("test_enricher_");
+    {std::ofstream(ph/"foo") << "hello";}
+
+    std::mutex mtx;
+    std::vector<std::vector<RecursiveNotifyEvent>> batches;
+    size_t count = 0;
+    MetadataEnricher enricher(ph, [](RecursiveNotifyEvent) { FAIL("Not a batch"); }, 1024,
+                              [&](std::vector<RecursiveNotifyEvent> &batch) {
+      std::lock_guard<std::mutex> lg(mtx);
+      count += batch.size();
+      batches.push_back(std::move(batch));
+    });
+
+    WHEN("Events come in") {
+      enricher.setFields(MD_SIZE);
+      for (int i = 0; i < 100; ++i) {
+        enricher.push({.mask = IN_MODIFY, .cookie = static_cast<uint32_t>(i), .path = ".", .name = "foo"});
+      }
+      for (int i = 0; i < 500; ++i) {
+        {
+          std::lock_guard<std::mutex> lg(mtx);
+          if (count >= 100) {
+            break;
+          }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+
+      THEN("Each batch comes enriched, all of them in order") {
+        std::lock_guard<std::mutex> lg(mtx);
+        REQUIRE(count == 100);
+        uint32_t next = 0;
+        for (auto const &batch: batches) {
+          CHECK_FALSE(batch.empty());
+          for (auto const &rne: batch) {
+            CHECK(rne.cookie == next++);
+            REQUIRE(rne.metadata);
+            CHECK(rne.metadata->size == 5);
+          }
+        }
+      }
+    }
+
+    WHEN("Events are collected, with no metadata asked for") {
+      enricher.collect();
+      for (int i = 0; i < 10; ++i) {
+        enricher.push({.mask = IN_MODIFY, .cookie = static_cast<uint32_t>(i), .path = ".", .name = "foo"});
+      }
+      std::thread([&enricher]() {
+        enricher.push({.mask = IN_CLOSE_WRITE, .cookie = 10, .path = ".", .name = "foo"});
+      }).join();
+      {
+        std::lock_guard<std::mutex> lg(mtx);
+        REQUIRE(batches.empty());
+      }
+      enricher.flush();
+
+      THEN("They go on as one batch, pushed from whichever thread, in order") {
+        std::lock_guard<std::mutex> lg(mtx);
+        REQUIRE(batches.size() == 1);
+        REQUIRE(batches[0].size() == 11);
+        for (uint32_t i = 0; i < 11; ++i) {
+          CHECK(batches[0][i].cookie == i);
+          CHECK_FALSE(batches[0][i].metadata);
+        }
+      }
+    }
+
+    WHEN("Metadata is asked for while events are collected") {
+      enricher.collect();
+      for (int i = 0; i < 10; ++i) {
+        enricher.push({.mask = IN_MODIFY, .cookie = static_cast<uint32_t>(i), .path = ".", .name = "foo"});
+      }
+      enricher.setFields(MD_SIZE);
+      enricher.flush();
+      for (int i = 0; i < 500; ++i) {
+        {
+          std::lock_guard<std::mutex> lg(mtx);
+          if (count >= 10) {
+            break;
+          }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+
+      THEN("They're enriched first") {
+        std::lock_guard<std::mutex> lg(mtx);
+        REQUIRE(count == 10);
+        uint32_t next = 0;
+        for (auto const &batch: batches) {
+          for (auto const &rne: batch) {
+            CHECK(rne.cookie == next++);
+            CHECK(rne.metadata);
+          }
+        }
+      }
+    }
+  }
+}
@@ -229,6 +229,174 @@ SCENARIO("Testing NofityingFS, nested structures") {
       }
     }
 
+    WHEN("Exclusions are changed at runtime") {
+      fs::create_directory(ph/"ignore.d");
+      fs::create_directory(ph/"ignore.d"/"nested.d");
+      fs::create_directory(ph/"keep.d");
+
+      RecursiveINotify nfs(callback, ph, {"ignore.d"});
+      Options options{};
+      options.pathToMonitor = ph.string();
+      options.pathsToExclude = {"keep.d"};
+      nfs.reconfigure(options);
+      sleep_for(milliseconds(10));
+      {
+        // indexing itself is noisy
+        std::lock_guard<std::mutex> lg(mtx);
+        events.clear();
+      }
+
+      {std::ofstream(ph/"keep.d"/"foo");}
+      {std::ofstream(ph/"ignore.d"/"nested.d"/"foo");}
+      sleep_for(milliseconds(10));
+
+      THEN("Newly excluded dirs are not monitored anymore, newly included ones are") {
+        std::lock_guard<std::mutex> lg(mtx);
+
+        REQUIRE(events.size()==3);
+
+        CHECK(events[0] == RecursiveNotifyEvent{IN_CREATE, 0, "ignore.d/nested.d", "foo"});
+        CHECK(events[1] == RecursiveNotifyEvent{IN_OPEN, 0, "ignore.d/nested.d", "foo"});
+        CHECK(events[2] == RecursiveNotifyEvent{IN_CLOSE_WRITE, 0, "ignore.d/nested.d", "foo"});
+      }
+    }
+
+    WHEN("Tailed file is appended to") {
+      fs::create_directory(ph/"logs");
+      {std::ofstream(ph/"logs"/"app.log") << "old";}
+
+      RecursiveINotify nfs(callback, ph, {}, {}, {}, {}, {}, {}, TailOptions{.patterns = {".log"}});
+      {std::ofstream(ph/"logs"/"app.log", std::ios::app) << "first";}
+      sleep_for(milliseconds(10));
+      {std::ofstream(ph/"logs"/"app.log", std::ios::app) << "second";}
+      sleep_for(milliseconds(10));
+
+      THEN("Appended bytes are published as NB_TAIL events") {
+        std::lock_guard<std::mutex> lg(mtx);
+
+        std::vector<RecursiveNotifyEvent> tails;
+        std::copy_if(events.begin(), events.end(), std::back_inserter(tails), [](auto const &e) { return e.mask == NB_TAIL; });
+        // whether "first" is there depends on how fast IN_OPEN is handled
+        REQUIRE_FALSE(tails.empty());
+        CHECK(tails.back().path == "logs");
+        CHECK(tails.back().name == "app.log");
+        REQUIRE(tails.back().tail);
+        CHECK(tails.back().tail->offset == 8);
+        CHECK(tails.back().tail->data == "second");
+      }
+    }
+
+    WHEN("Files are written with hashing on") {
+      RecursiveINotify nfs(callback, ph, {}, {}, {}, {}, {}, {}, {}, HashOptions{.threads = 1});
+      {std::ofstream(ph/"foo") << "abc";}
+      sleep_for(milliseconds(50));
+
+      THEN("IN_CLOSE_WRITE carries the digest of the content") {
+        std::lock_guard<std::mutex> lg(mtx);
+
+        auto closed = std::find_if(events.begin(), events.end(), [](auto const &e) { return e.mask == IN_CLOSE_WRITE; });
+        REQUIRE(closed != events.end());
+        CHECK(closed->name == "foo");
+        REQUIRE(closed->hash);
+        CHECK(*closed->hash == 0x44BC2CF5AD770999ULL);
+        auto created = std::find_if(events.begin(), events.end(), [](auto const &e) { return e.mask == IN_CREATE; });
+        REQUIRE(created != events.end());
+        CHECK_FALSE(created->hash);
+      }
+    }
+
+    WHEN("A file is written and removed right away with hashing on") {
+      RecursiveINotify nfs(callback, ph, {}, {}, {}, {}, {}, {}, {}, HashOptions{.threads = 1});
+      {std::ofstream(ph/"foo") << std::string(16 * 1024 * 1024, 'x');}
+      fs::remove(ph/"foo");
+      sleep_for(milliseconds(300));
+
+      THEN("IN_CLOSE_WRITE comes before IN_DELETE") {
+        std::lock_guard<std::mutex> lg(mtx);
+
+        auto closed = std::find_if(events.begin(), events.end(), [](auto const &e) { return e.mask == IN_CLOSE_WRITE; });
+        auto deleted = std::find_if(events.begin(), events.end(), [](auto const &e) { return e.mask == IN_DELETE; });
+        REQUIRE(closed != events.end());
+        REQUIRE(deleted != events.end());
+        CHECK(closed < deleted);
+        CHECK(std::count_if(events.begin(), events.end(), [](auto const &e) { return e.mask == IN_CLOSE_WRITE; }) == 1);
+      }
+    }
+
+    WHEN("Events are published a batch at a time") {
+      std::vector<size_t> batches;
+      RecursiveINotify nfs([](RecursiveNotifyEvent) { FAIL("Not a batch"); }, ph,
+                           {}, {}, {}, {}, {}, {}, {}, {}, {},
+                           [&events, &mtx, &batches](std::vector<RecursiveNotifyEvent> &batch) {
+                             std::lock_guard<std::mutex> lg(mtx);
+                             batches.push_back(batch.size());
+                             events.insert(events.end(), batch.begin(), batch.end());
+                           });
+      for (int i = 0; i < 20; ++i) {
+        std::ofstream(ph/("foo" + std::to_string(i)));
+      }
+      sleep_for(milliseconds(100));
+
+      THEN("Events come in batches even with no metadata asked for, all of them in order") {
+        std::lock_guard<std::mutex> lg(mtx);
+
+        REQUIRE_FALSE(batches.empty());
+        std::vector<RecursiveNotifyEvent> created;
+        std::copy_if(events.begin(), events.end(), std::back_inserter(created), [](auto const &e) { return e.mask == IN_CREATE; });
+        REQUIRE(created.size() == 20);
+        for (int i = 0; i < 20; ++i) {
+          CHECK(created[i].name == "foo" + std::to_string(i));
+        }
+      }
+    }
+
+    WHEN("Tree is changed while not monitored") {
+      auto stateFile = createTempDir("test_notify_state_")/"tree.state";
+      auto nestedPath=ph/"nested.d";
+      fs::create_directory(nestedPath);
+      {std::ofstream(nestedPath/"bar");}
+      {std::ofstream(ph/"keep");}
+      {std::ofstream(ph/"gone");}
+      {
+        RecursiveINotify nfs(callback, ph, {}, stateFile);
+      }
+      REQUIRE(fs::exists(stateFile));
+      {
+        std::lock_guard<std::mutex> lg(mtx);
+        events.clear();
+      }
+
+      {std::ofstream(nestedPath/"bar") << "changed";}
+      {std::ofstream(ph/"keep") << "changed";}
+      fs::remove(ph/"gone");
+      {std::ofstream(ph/"new");}
+      fs::create_directory(ph/"new.d");
+      {std::ofstream(ph/"new.d"/"foo");}
+
+      {
+        RecursiveINotify nfs(callback, ph, {}, stateFile);
+      }
+
+      THEN("Catch-up events are published") {
+        std::lock_guard<std::mutex> lg(mtx);
+
+        REQUIRE(events.size()==8);
+
+        CHECK(events[0] == RecursiveNotifyEvent{IN_DELETE, 0, ".", "gone"});
+        CHECK(events[1] == RecursiveNotifyEvent{IN_CLOSE_WRITE, 0, ".", "keep"});
+        CHECK(events[2] == RecursiveNotifyEvent{IN_CREATE, 0, ".", "new"});
+        CHECK(events[3] == RecursiveNotifyEvent{IN_CLOSE_WRITE, 0, ".", "new"});
+        CHECK(events[4] == RecursiveNotifyEvent{IN_CREATE | IN_ISDIR, 0, ".", "new.d"});
+        CHECK(events[5] == RecursiveNotifyEvent{IN_CLOSE_WRITE, 0, "nested.d", "bar"});
+        CHECK(events[6] == RecursiveNotifyEvent{IN_CREATE, 0, "new.d", "foo"});
+        CHECK(events[7] == RecursiveNotifyEvent{IN_CLOSE_WRITE, 0, "new.d", "foo"});
+        for (auto &e: events) {
+          CHECK(e.catchUp);
+        }
+      }
+      fs::remove_all(stateFile.parent_path());
+    }
+
     // cleaning up
     //std::cout<<"removing the directory\n";
     fs::remove_all(ph);
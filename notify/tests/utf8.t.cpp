@@ -0,0 +1,163 @@
+#include "utf8.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+// Media library names: long titles, in a few scripts, some of them in a legacy encoding
+std::vector<std::string> mediaNames(size_t count) {
+  std::vector<std::string> titles = {
+    "Ludwig van Beethoven - Symphonie Nr. 9 in d-Moll, Op. 125 \xe2\x80\x9e" "An die Freude\xe2\x80\x9c (Live 1963)",
+    "\xe5\x8d\x83\xe3\x81\xa8\xe5\x8d\x83\xe5\xb0\x8b\xe3\x81\xae\xe7\xa5\x9e\xe9\x9a\xa0\xe3\x81\x97 (2001) [1080p] [BluRay]",
+    "\xd0\x92\xd0\xbe\xd0\xb9\xd0\xbd\xd0\xb0 \xd0\xb8 \xd0\xbc\xd0\xb8\xd1\x80 - \xd0\xa1\xd0\xb5\xd1\x80\xd0\xb8\xd1\x8f 01",
+    "The Lord of the Rings - The Fellowship of the Ring (Extended Edition) 2001 2160p HDR",
+    "Caf\xe9 del Mar - Volumen Dos (1995)", // Latin-1
+    "Sigur R\xc3\xb3s - \xc3\x81g\xc3\xa6tis byrjun - 04 Sv\xc3\xa1" "fn-g\xc3\xa9ngar",
+  };
+  std::vector<std::string> extensions = {".flac", ".mkv", ".mp4", ".jpg"};
+  std::vector<std::string> res;
+  for (size_t i = 0; i < count; ++i) {
+    res.push_back(titles[i % titles.size()] + " " + std::to_string(i) + extensions[i % extensions.size()]);
+  }
+  return res;
+}
+
+template <class F>
+double bytesPerNs(std::vector<std::string> const &names, F &&scan) {
+  size_t bytes = 0, found = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < 20; ++round) {
+    for (auto &n: names) {
+      found += scan(n);
+      bytes += n.size();
+    }
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  REQUIRE(found > 0);
+  return bytes / elapsed.count();
+}
+} //namespace
+
+SCENARIO("Scanning file names") {
+  GIVEN("Random bytes") {
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> byte(0, 255), plain(0x20, 0x7e), length(0, 100);
+    for (int i = 0; i < 1000; ++i) {
+      std::string s(length(rng), '\0');
+      for (auto &c: s) { // mostly plain, so the scans go some way
+        c = char(byte(rng) < 16 ? byte(rng) : plain(rng));
+      }
+      for (size_t pos = 0; pos <= s.size(); ++pos) {
+        REQUIRE(skipJsonPlain(s, pos) == skipJsonPlainScalar(s, pos));
+        REQUIRE(skipJsonText(s, pos) == skipJsonTextScalar(s, pos));
+      }
+    }
+  }
+
+  GIVEN("Random UTF-8, some of it broken") {
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> byte(0, 255), length(0, 40), count(0, 3);
+    std::uniform_int_distribution<uint32_t> codePoint(0, 0x10ffff);
+    std::uniform_int_distribution<size_t> anywhere;
+    for (int i = 0; i < 20000; ++i) {
+      std::string s;
+      for (int n = length(rng); n > 0; --n) {
+        uint32_t cp = byte(rng) < 128 ? byte(rng) & 0x7f : codePoint(rng);
+        if (cp >= 0xd800 && cp < 0xe000) {
+          cp = 'x';
+        }
+        if (cp < 0x80) {
+          s += char(cp);
+        } else if (cp < 0x800) {
+          s += {char(0xc0 | cp >> 6), char(0x80 | (cp & 0x3f))};
+        } else if (cp < 0x10000) {
+          s += {char(0xe0 | cp >> 12), char(0x80 | ((cp >> 6) & 0x3f)), char(0x80 | (cp & 0x3f))};
+        } else {
+          s += {char(0xf0 | cp >> 18), char(0x80 | ((cp >> 12) & 0x3f)), char(0x80 | ((cp >> 6) & 0x3f)),
+                char(0x80 | (cp & 0x3f))};
+        }
+      }
+      // a byte or a few replaced, or the end cut off, by half of them
+      if (i % 2 && !s.empty()) {
+        if (i % 6 == 1) {
+          s.resize(anywhere(rng) % s.size());
+        }
+        for (int n = count(rng); n > 0 && !s.empty(); --n) {
+          s[anywhere(rng) % s.size()] = char(byte(rng));
+        }
+      }
+      INFO(s);
+      REQUIRE(isValidUtf8(s) == isValidUtf8Scalar(s));
+    }
+  }
+
+  GIVEN("UTF-8 sequences") {
+    CHECK(utf8SequenceLength("a", 0) == 1);
+    CHECK(utf8SequenceLength("\xc3\xa9", 0) == 2);
+    CHECK(utf8SequenceLength("\xe2\x82\xac", 0) == 3);
+    CHECK(utf8SequenceLength("\xf0\x9f\x98\x80", 0) == 4);
+    CHECK(utf8SequenceLength("\xf4\x8f\xbf\xbf", 0) == 4);  // U+10FFFF
+    CHECK(utf8SequenceLength("\xc0\xaf", 0) == 0);          // overlong
+    CHECK(utf8SequenceLength("\xe0\x80\xaf", 0) == 0);      // overlong
+    CHECK(utf8SequenceLength("\xed\xa0\x80", 0) == 0);      // a surrogate
+    CHECK(utf8SequenceLength("\xf4\x90\x80\x80", 0) == 0);  // beyond U+10FFFF
+    CHECK(utf8SequenceLength("\xe2\x82", 0) == 0);          // cut short
+    CHECK(utf8SequenceLength("\xe2\x28\xac", 0) == 0);
+    CHECK(utf8SequenceLength("\xa9", 0) == 0);              // a continuation
+    CHECK(isValidUtf8("plain ASCII, and more than sixteen bytes of it"));
+    CHECK(isValidUtf8("\xd0\x92\xd0\xbe\xd0\xb9\xd0\xbd\xd0\xb0 \xd0\xb8 \xd0\xbc\xd0\xb8\xd1\x80 \xe5\x8d\x83\xf0\x9f\x98\x80"));
+    CHECK_FALSE(isValidUtf8("more than sixteen bytes, then Caf\xe9"));
+    CHECK_FALSE(isValidUtf8("\xf0\x9f\x98"));
+    // wherever they are, across the blocks the validation goes in
+    for (size_t at = 0; at < 70; ++at) {
+      auto around = [at](std::string const &s) { return std::string(at, 'a') + s + std::string(70 - at, 'b'); };
+      for (std::string good: {"\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80", "\xf4\x8f\xbf\xbf"}) {
+        REQUIRE(isValidUtf8(around(good)));
+        REQUIRE(isValidUtf8(std::string(at, 'a') + good));
+      }
+      for (std::string bad: {"\xc0\xaf", "\xe0\x80\xaf", "\xed\xa0\x80", "\xf4\x90\x80\x80", "\xf5\x80\x80\x80",
+                             "\xe2\x82", "\xe2\x28\xac", "\xa9", "\xc3\xa9\xa9", "\xf0\x9f\x98\x80\x80"}) {
+        INFO(at << " " << bad);
+        REQUIRE_FALSE(isValidUtf8(around(bad)));
+        REQUIRE_FALSE(isValidUtf8(around("\xc3\xa9" + bad)));
+        REQUIRE_FALSE(isValidUtf8(std::string(at, 'a') + "\xc3\xa9" + bad));
+      }
+    }
+  }
+}
+
+TEST_CASE("Scanning names", "[.][benchmark]") {
+  auto media = mediaNames(100000);
+  std::vector<std::string> ascii;
+  for (size_t i = 0; i < 100000; ++i) {
+    ascii.push_back("IMG_" + std::to_string(20230000 + i) + "_holiday_in_the_mountains.jpg");
+  }
+  // what escaping a name takes apart from copying it: finding what isn't plain, validating what isn't ASCII
+  auto scan = [](auto skip) {
+    return [skip](std::string const &s) {
+      size_t invalid = 0;
+      for (size_t i = skip(s, 0); i < s.size(); i = skip(s, i)) {
+        auto len = utf8SequenceLength(s, i);
+        invalid += !len;
+        i += len ? len : 1;
+      }
+      return invalid + 1;
+    };
+  };
+  auto simd = scan(skipJsonPlain);
+  auto scalar = scan(skipJsonPlainScalar);
+  for (auto &[label, names]: {std::pair{"ASCII", &ascii}, std::pair{"media library", &media}}) {
+    std::cout << label << " names: " << bytesPerNs(*names, simd) << " bytes/ns vectorized, "
+              << bytesPerNs(*names, scalar) << " bytes/ns a byte at a time\n";
+  }
+  // the names in a legacy encoding fail anywhere, the rest is valid
+  auto valid = [](auto validate) {
+    return [validate](std::string const &s) { return size_t(validate(s)); };
+  };
+  std::cout << "Validating media library names: " << bytesPerNs(media, valid(isValidUtf8)) << " bytes/ns vectorized, "
+            << bytesPerNs(media, valid(isValidUtf8Scalar)) << " bytes/ns a sequence at a time\n";
+}
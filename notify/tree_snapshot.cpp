@@ -0,0 +1,435 @@
+#include "tree_snapshot.h"
+
+#include <boost/log/trivial.hpp>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <tuple>
+#include <unistd.h>
+
+namespace {
+
+constexpr char snapshotMagic[8] = {'N', 'B', 'T', 'R', 'E', 'E', '\0', '\1'};
+constexpr uint32_t snapshotVersion = 1;
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t rootPathLength; // the root path follows the header, padded to 8 bytes
+  uint64_t entryCount;
+  uint64_t namesSize;
+};
+
+constexpr size_t padded(size_t n) {
+  return (n + 7) & ~size_t{7};
+}
+
+bool statAt(int dirFd, char const *name, TreeNode &node) {
+  struct stat st;
+  if (fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW) == -1) {
+    return false;
+  }
+  node.ino = st.st_ino;
+  node.mtimeNs = int64_t{st.st_mtim.tv_sec} * 1000000000 + st.st_mtim.tv_nsec;
+  node.size = st.st_size;
+  node.isDir = S_ISDIR(st.st_mode);
+  return true;
+}
+
+// FNV-1a over the direct entries of a directory
+uint64_t hashEntries(std::vector<TreeNode> const &children) {
+  uint64_t h = 14695981039346656037ull;
+  auto mix = [&h](void const *p, size_t n) {
+    auto bytes = static_cast<unsigned char const *>(p);
+    for (size_t i = 0; i < n; ++i) {
+      h = (h ^ bytes[i]) * 1099511628211ull;
+    }
+  };
+  for (auto &c: children) {
+    mix(c.name.data(), c.name.size() + 1);
+    mix(&c.ino, sizeof(c.ino));
+    mix(&c.mtimeNs, sizeof(c.mtimeNs));
+    mix(&c.size, sizeof(c.size));
+    mix(&c.isDir, sizeof(c.isDir));
+  }
+  return h;
+}
+
+class Scanner {
+public:
+  Scanner(fs::path const &rootPath,
+          TreeSnapshot const *previous,
+          std::function<bool(fs::path const &)> const &skip):
+    rootPath{rootPath},
+    previous{previous},
+    skip{skip}
+  {}
+
+  TreeScan run() {
+    TreeScan res;
+    if (!statAt(AT_FDCWD, rootPath.c_str(), res.root) || !res.root.isDir) {
+      std::stringstream sstr;
+      sstr << "Can't scan " << rootPath << ", it's not a directory";
+      throw std::runtime_error(sstr.str());
+    }
+
+    jobs.push_back({&res.root, rootPath, ".", previous ? &previous->root() : nullptr, false});
+    pending = 1;
+
+    auto threadCount = std::clamp(std::thread::hardware_concurrency(), 1u, 8u);
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < threadCount; ++i) {
+      threads.emplace_back([this]{ work(); });
+    }
+    work();
+    for (auto &th: threads) {
+      th.join();
+    }
+
+    std::stable_sort(begin(changes), end(changes), [](auto const &lhs, auto const &rhs) {
+      return std::tie(lhs.path, lhs.name) < std::tie(rhs.path, rhs.name);
+    });
+    res.directories = std::move(directories);
+    res.changes = std::move(changes);
+    return res;
+  }
+
+private:
+  struct Job {
+    TreeNode *node;
+    fs::path path;
+    std::string relPath;
+    TreeSnapshot::Entry const *old; // the same directory in the previous snapshot
+    bool isNew;                     // the directory didn't exist when the snapshot was taken
+  };
+
+  fs::path const &rootPath;
+  TreeSnapshot const *previous;
+  std::function<bool(fs::path const &)> const &skip;
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::deque<Job> jobs;
+  size_t pending = 0;
+  std::vector<fs::path> directories;
+  std::vector<RecursiveNotifyEvent> changes;
+
+  void work() {
+    for (;;) {
+      std::unique_lock<std::mutex> lck(mtx);
+      cv.wait(lck, [this]{ return !jobs.empty() || pending == 0; });
+      if (jobs.empty()) {
+        return;
+      }
+      auto job = std::move(jobs.front());
+      jobs.pop_front();
+      lck.unlock();
+
+      std::vector<Job> next;
+      std::vector<RecursiveNotifyEvent> found;
+      bool scanned = false;
+      try {
+        scanned = scanDirectory(job, next, found);
+      } catch (std::exception &ec) {
+        BOOST_LOG_TRIVIAL(warning) << "Failed to scan " << job.path << ". Error is: " << ec.what();
+      }
+
+      lck.lock();
+      if (scanned) {
+        directories.push_back(std::move(job.path));
+      }
+      changes.insert(end(changes), begin(found), end(found));
+      pending += next.size();
+      std::move(begin(next), end(next), std::back_inserter(jobs));
+      if (--pending == 0 || !next.empty()) {
+        cv.notify_all();
+      }
+    }
+  }
+
+  // returns false if the directory can't be opened (removed meanwhile, permission denied)
+  bool scanDirectory(Job const &job, std::vector<Job> &next, std::vector<RecursiveNotifyEvent> &found) {
+    // O_PATH doesn't generate inotify events for the (possibly watched) directory
+    int dfd = ::open(job.path.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (dfd == -1) {
+      BOOST_LOG_TRIVIAL(debug) << "Can't open " << job.path << ", error: " << strerror(errno);
+      return false;
+    }
+
+    auto &node = *job.node;
+    auto old = job.old;
+    bool unchanged = old && old->ino == node.ino && old->mtimeNs == node.mtimeNs;
+    if (unchanged) {
+      // same directory mtime: no entry was added, removed or renamed since the snapshot
+      BOOST_LOG_TRIVIAL(trace) << "Taking the entries of " << job.path << " from the snapshot";
+      node.children.reserve(old->childCount);
+      for (auto it = previous->childrenBegin(*old); it != previous->childrenEnd(*old); ++it) {
+        TreeNode child;
+        child.name = previous->name(*it);
+        if (statAt(dfd, child.name.c_str(), child)) {
+          node.children.push_back(std::move(child));
+        }
+      }
+    } else {
+      BOOST_LOG_TRIVIAL(trace) << "Reading " << job.path;
+      int rfd = openat(dfd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      DIR *dir = rfd == -1 ? nullptr : fdopendir(rfd);
+      if (!dir && rfd != -1) {
+        close(rfd);
+      }
+      if (dir) {
+        while (auto de = readdir(dir)) {
+          if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, "..")) {
+            continue;
+          }
+          TreeNode child;
+          child.name = de->d_name;
+          if (statAt(dfd, de->d_name, child)) {
+            node.children.push_back(std::move(child));
+          }
+        }
+        closedir(dir);
+      }
+      std::sort(begin(node.children), end(node.children), [](auto const &lhs, auto const &rhs) {
+        return lhs.name < rhs.name;
+      });
+    }
+    close(dfd);
+    node.hash = hashEntries(node.children);
+
+    if (job.isNew) {
+      for (auto &child: node.children) {
+        reportCreated(job.relPath, child, found);
+      }
+    } else if (old && old->hash != node.hash) {
+      diff(job.relPath, *old, node, found);
+    }
+
+    for (auto &child: node.children) {
+      if (!child.isDir) {
+        continue;
+      }
+      auto childPath = job.path / child.name;
+      if (skip(childPath)) {
+        continue;
+      }
+      TreeSnapshot::Entry const *oldChild = nullptr;
+      if (old) {
+        oldChild = previous->findChild(*old, child.name);
+        if (oldChild && (!oldChild->isDir || oldChild->ino != child.ino)) {
+          oldChild = nullptr;
+        }
+      }
+      next.push_back({&child,
+                      std::move(childPath),
+                      job.relPath == "." ? child.name : job.relPath + "/" + child.name,
+                      oldChild,
+                      previous && !oldChild});
+    }
+    return true;
+  }
+
+  static void reportCreated(std::string const &relPath, TreeNode const &child,
+                            std::vector<RecursiveNotifyEvent> &found) {
+    if (child.isDir) {
+      found.push_back(catchUp(IN_CREATE | IN_ISDIR, relPath, child.name));
+    } else {
+      found.push_back(catchUp(IN_CREATE, relPath, child.name));
+      found.push_back(catchUp(IN_CLOSE_WRITE, relPath, child.name));
+    }
+  }
+
+  // both entry lists are sorted by name
+  void diff(std::string const &relPath, TreeSnapshot::Entry const &old, TreeNode const &node,
+            std::vector<RecursiveNotifyEvent> &found) const {
+    auto oldIt = previous->childrenBegin(old);
+    auto oldEnd = previous->childrenEnd(old);
+    auto newIt = begin(node.children);
+    auto newEnd = end(node.children);
+    while (oldIt != oldEnd || newIt != newEnd) {
+      int cmp = oldIt == oldEnd ? 1
+              : newIt == newEnd ? -1
+              : previous->name(*oldIt).compare(newIt->name);
+      if (cmp < 0) {
+        found.push_back(catchUp(IN_DELETE | (oldIt->isDir ? IN_ISDIR : 0), relPath,
+                                std::string(previous->name(*oldIt))));
+        ++oldIt;
+      } else if (cmp > 0) {
+        reportCreated(relPath, *newIt, found);
+        ++newIt;
+      } else {
+        if (bool(oldIt->isDir) != newIt->isDir || (newIt->isDir && oldIt->ino != newIt->ino)) {
+          found.push_back(catchUp(IN_DELETE | (oldIt->isDir ? IN_ISDIR : 0), relPath, newIt->name));
+          reportCreated(relPath, *newIt, found);
+        } else if (!newIt->isDir && (oldIt->ino != newIt->ino
+                                     || oldIt->mtimeNs != newIt->mtimeNs
+                                     || oldIt->size != newIt->size)) {
+          found.push_back(catchUp(IN_CLOSE_WRITE, relPath, newIt->name));
+        }
+        ++oldIt;
+        ++newIt;
+      }
+    }
+  }
+
+  static RecursiveNotifyEvent catchUp(uint32_t mask, std::string const &relPath, std::string const &name) {
+    return {.mask = mask,
+            .cookie = 0,
+            .path = relPath,
+            .name = name,
+            .catchUp = true};
+  }
+}; // Scanner
+
+} //namespace
+
+TreeSnapshot::TreeSnapshot(void *mapping, size_t mappingSize):
+  mapping{mapping},
+  mappingSize{mappingSize}
+{}
+
+TreeSnapshot::~TreeSnapshot() {
+  munmap(mapping, mappingSize);
+}
+
+std::unique_ptr<TreeSnapshot> TreeSnapshot::open(fs::path const &file, fs::path const &rootPath) {
+  int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    BOOST_LOG_TRIVIAL(info) << "No tree snapshot at " << file << ": " << strerror(errno);
+    return {};
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1 || size_t(st.st_size) < sizeof(Header)) {
+    BOOST_LOG_TRIVIAL(warning) << "Tree snapshot " << file << " is too short, ignoring it";
+    close(fd);
+    return {};
+  }
+  size_t size = st.st_size;
+  void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    BOOST_LOG_TRIVIAL(warning) << "Failed to map tree snapshot " << file << ", error: " << strerror(errno);
+    return {};
+  }
+  std::unique_ptr<TreeSnapshot> res(new TreeSnapshot(mapping, size));
+
+  auto base = static_cast<char const *>(mapping);
+  auto header = reinterpret_cast<Header const *>(base);
+  auto entriesOffset = sizeof(Header) + padded(header->rootPathLength);
+  if (memcmp(header->magic, snapshotMagic, sizeof(snapshotMagic)) != 0
+      || header->version != snapshotVersion
+      || header->entryCount == 0
+      || header->entryCount > size / sizeof(Entry)
+      || entriesOffset + header->entryCount * sizeof(Entry) + header->namesSize != size)
+  {
+    BOOST_LOG_TRIVIAL(warning) << "Tree snapshot " << file << " is malformed, ignoring it";
+    return {};
+  }
+  if (std::string_view(base + sizeof(Header), header->rootPathLength) != rootPath.native()) {
+    BOOST_LOG_TRIVIAL(warning) << "Tree snapshot " << file << " was taken for another path, ignoring it";
+    return {};
+  }
+
+  res->entries = reinterpret_cast<Entry const *>(base + entriesOffset);
+  res->names = base + entriesOffset + header->entryCount * sizeof(Entry);
+  for (size_t i = 0; i < header->entryCount; ++i) {
+    auto &e = res->entries[i];
+    if (uint64_t{e.nameOffset} + e.nameLength > header->namesSize
+        || uint64_t{e.firstChild} + e.childCount > header->entryCount)
+    {
+      BOOST_LOG_TRIVIAL(warning) << "Tree snapshot " << file << " has a broken entry, ignoring it";
+      return {};
+    }
+  }
+  BOOST_LOG_TRIVIAL(info) << "Loaded tree snapshot " << file << " with " << header->entryCount << " entries";
+  return res;
+}
+
+TreeSnapshot::Entry const *TreeSnapshot::findChild(Entry const &dir, std::string_view name) const {
+  auto first = childrenBegin(dir);
+  auto last = childrenEnd(dir);
+  auto it = std::lower_bound(first, last, name, [this](Entry const &e, std::string_view n) {
+    return this->name(e) < n;
+  });
+  return it != last && this->name(*it) == name ? it : nullptr;
+}
+
+void TreeSnapshot::write(fs::path const &file, fs::path const &rootPath, TreeNode const &root) {
+  std::vector<Entry> entries;
+  std::string names;
+  auto append = [&entries, &names](TreeNode const &node) {
+    entries.push_back({.ino = node.ino,
+                       .mtimeNs = node.mtimeNs,
+                       .size = node.size,
+                       .hash = node.hash,
+                       .nameOffset = uint32_t(names.size()),
+                       .nameLength = uint32_t(node.name.size()),
+                       .firstChild = 0,
+                       .childCount = 0,
+                       .isDir = node.isDir,
+                       .reserved = 0});
+    names += node.name;
+  };
+
+  // breadth first, so the children of each directory are contiguous
+  std::deque<std::pair<TreeNode const *, size_t>> queue{{&root, 0}};
+  append(root);
+  while (!queue.empty()) {
+    auto [node, idx] = queue.front();
+    queue.pop_front();
+    entries[idx].firstChild = uint32_t(entries.size());
+    entries[idx].childCount = uint32_t(node->children.size());
+    for (auto &child: node->children) {
+      if (child.isDir) {
+        queue.emplace_back(&child, entries.size());
+      }
+      append(child);
+    }
+  }
+  if (entries.size() > UINT32_MAX || names.size() > UINT32_MAX) {
+    throw std::runtime_error("The tree is too big to be persisted");
+  }
+
+  Header header;
+  memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+  header.version = snapshotVersion;
+  header.rootPathLength = uint32_t(rootPath.native().size());
+  header.entryCount = entries.size();
+  header.namesSize = names.size();
+
+  auto tmpFile = file;
+  tmpFile += ".tmp";
+  {
+    std::ofstream out(tmpFile, std::ios::binary | std::ios::trunc);
+    std::string rootPathPadded = rootPath.native();
+    rootPathPadded.resize(padded(rootPathPadded.size()), '\0');
+    out.write(reinterpret_cast<char const *>(&header), sizeof(header));
+    out.write(rootPathPadded.data(), rootPathPadded.size());
+    out.write(reinterpret_cast<char const *>(entries.data()), entries.size() * sizeof(Entry));
+    out.write(names.data(), names.size());
+    out.flush();
+    if (!out) {
+      std::stringstream sstr;
+      sstr << "Failed to write tree snapshot " << tmpFile;
+      throw std::runtime_error(sstr.str());
+    }
+  }
+  fs::rename(tmpFile, file);
+  BOOST_LOG_TRIVIAL(debug) << "Tree snapshot with " << entries.size() << " entries written to " << file;
+}
+
+TreeScan scanTree(fs::path const &rootPath,
+                  TreeSnapshot const *previous,
+                  std::function<bool(fs::path const &)> const &skip) {
+  return Scanner(rootPath, previous, skip).run();
+}
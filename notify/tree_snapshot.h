@@ -0,0 +1,80 @@
+#ifndef TREE_SNAPSHOT_H
+#define TREE_SNAPSHOT_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "filesystem.h"
+#include "recursive_notify_event.h"
+
+// In-memory image of a directory tree, as produced by scanTree()
+struct TreeNode {
+  std::string name;
+  uint64_t ino = 0;
+  int64_t mtimeNs = 0;
+  uint64_t size = 0;
+  uint64_t hash = 0;  // directories only: hash over the direct entries
+  bool isDir = false;
+  std::vector<TreeNode> children; // sorted by name
+};
+
+// Read-only, memory-mapped view of a tree state persisted with TreeSnapshot::write().
+// The file is a header, followed by an array of fixed size entries and a string table
+// with the names. Directories are stored breadth first, so the children
+// of a directory are contiguous and sorted by name.
+class TreeSnapshot {
+public:
+  struct Entry {
+    uint64_t ino;
+    int64_t mtimeNs;
+    uint64_t size;
+    uint64_t hash;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t firstChild;
+    uint32_t childCount;
+    uint32_t isDir;
+    uint32_t reserved;
+  };
+
+  // returns nullptr if the file is missing, was written for another root or is malformed
+  static std::unique_ptr<TreeSnapshot> open(fs::path const &file, fs::path const &rootPath);
+  // it throws on error. The file is replaced atomically
+  static void write(fs::path const &file, fs::path const &rootPath, TreeNode const &root);
+
+  ~TreeSnapshot();
+  TreeSnapshot(TreeSnapshot const &) = delete;
+  TreeSnapshot& operator=(TreeSnapshot const&) = delete;
+
+  Entry const &root() const { return entries[0]; }
+  Entry const *findChild(Entry const &dir, std::string_view name) const;
+  std::string_view name(Entry const &e) const { return {names + e.nameOffset, e.nameLength}; }
+  Entry const *childrenBegin(Entry const &dir) const { return entries + dir.firstChild; }
+  Entry const *childrenEnd(Entry const &dir) const { return entries + dir.firstChild + dir.childCount; }
+
+private:
+  TreeSnapshot(void *mapping, size_t mappingSize);
+  void *mapping;
+  size_t mappingSize;
+  Entry const *entries = nullptr;
+  char const *names = nullptr;
+};
+
+struct TreeScan {
+  TreeNode root;
+  std::vector<fs::path> directories;         // every directory of the tree, to be watched
+  std::vector<RecursiveNotifyEvent> changes; // differences to the previous snapshot, if any
+};
+
+// Walks the tree on several threads. Directories whose mtime hasn't changed since
+// the previous snapshot aren't read again, their entries are taken from the snapshot.
+// 'skip' is called for directories only.
+TreeScan scanTree(fs::path const &rootPath,
+                  TreeSnapshot const *previous,
+                  std::function<bool(fs::path const &)> const &skip);
+
+#endif
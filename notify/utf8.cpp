@@ -0,0 +1,324 @@
+#include "utf8.h"
+
+#include <cstdint>
+#include <cstring>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+inline bool isJsonPlain(unsigned char c) {
+  return c >= 0x20 && c < 0x80 && c != '"' && c != '\\';
+}
+
+inline bool isContinuation(unsigned char c) {
+  return (c & 0xc0) == 0x80;
+}
+
+// The first non-ASCII byte at or after pos
+size_t skipAscii(std::string_view s, size_t pos) {
+  auto p = reinterpret_cast<unsigned char const *>(s.data());
+  auto n = s.size();
+#if defined(__SSE2__)
+  for (; pos + 16 <= n; pos += 16) {
+    auto mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const *>(p + pos)));
+    if (mask) {
+      return pos + __builtin_ctz(mask);
+    }
+  }
+#endif
+  while (pos < n && p[pos] < 0x80) {
+    ++pos;
+  }
+  return pos;
+}
+
+#if defined(__SSSE3__)
+// Keiser and Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte": each byte and
+// the one before it, by their nibbles, are looked up in three tables of the errors they may
+// be part of. What's left in all three is an error, but for continuations after continuations,
+// which are only fine as the 3rd or 4th byte of a sequence.
+namespace lookup {
+constexpr uint8_t tooShort = 1 << 0;     // a lead, then no continuation
+constexpr uint8_t tooLong = 1 << 1;      // ASCII, then a continuation
+constexpr uint8_t overlong3 = 1 << 2;    // 11100000 100_____
+constexpr uint8_t tooLarge = 1 << 3;     // 11110100 1001____ and above
+constexpr uint8_t surrogate = 1 << 4;    // 11101101 101_____
+constexpr uint8_t overlong2 = 1 << 5;    // 1100000_ 10______
+constexpr uint8_t tooLarge1000 = 1 << 6; // 11110101 1000____ and above
+constexpr uint8_t overlong4 = 1 << 6;    // 11110000 1000____
+constexpr uint8_t twoConts = 1 << 7;     // 10______ 10______
+constexpr uint8_t carry = tooShort | tooLong | twoConts;
+
+// by the high nibble of the first byte
+alignas(16) constexpr uint8_t byte1High[16] = {
+  tooLong, tooLong, tooLong, tooLong, tooLong, tooLong, tooLong, tooLong,
+  twoConts, twoConts, twoConts, twoConts,
+  tooShort | overlong2,
+  tooShort,
+  tooShort | overlong3 | surrogate,
+  tooShort | tooLarge | tooLarge1000 | overlong4,
+};
+// by its low nibble
+alignas(16) constexpr uint8_t byte1Low[16] = {
+  carry | overlong3 | overlong2 | overlong4,
+  carry | overlong2,
+  carry,
+  carry,
+  carry | tooLarge,
+  carry | tooLarge | tooLarge1000,
+  carry | tooLarge | tooLarge1000,
+  carry | tooLarge | tooLarge1000,
+  carry | tooLarge | tooLarge1000,
+  carry | tooLarge | tooLarge1000,
+  carry | tooLarge | tooLarge1000,
+  carry | tooLarge | tooLarge1000,
+  carry | tooLarge | tooLarge1000,
+  carry | tooLarge | tooLarge1000 | surrogate,
+  carry | tooLarge | tooLarge1000,
+  carry | tooLarge | tooLarge1000,
+};
+// by the high nibble of the second byte
+alignas(16) constexpr uint8_t byte2High[16] = {
+  tooShort, tooShort, tooShort, tooShort, tooShort, tooShort, tooShort, tooShort,
+  tooLong | overlong2 | twoConts | overlong3 | tooLarge1000 | overlong4,
+  tooLong | overlong2 | twoConts | overlong3 | tooLarge,
+  tooLong | overlong2 | twoConts | surrogate | tooLarge,
+  tooLong | overlong2 | twoConts | surrogate | tooLarge,
+  tooShort, tooShort, tooShort, tooShort,
+};
+// the last bytes of a block, above these they're leads of sequences going on in the next one
+alignas(32) constexpr uint8_t lastComplete[32] = {
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0xef, 0xdf, 0xbf,
+};
+} //namespace lookup
+
+struct Ssse3 {
+  using V = __m128i;
+  static constexpr size_t size = 16;
+  static V load(uint8_t const *p) { return _mm_loadu_si128(reinterpret_cast<V const *>(p)); }
+  static V table(uint8_t const *t) { return load(t); }
+  static V splat(uint8_t c) { return _mm_set1_epi8(char(c)); }
+  static V lookup(V table, V nibbles) { return _mm_shuffle_epi8(table, nibbles); }
+  static V high(V v) { return _mm_and_si128(_mm_srli_epi16(v, 4), splat(0x0f)); }
+  static V low(V v) { return _mm_and_si128(v, splat(0x0f)); }
+  static V both(V a, V b) { return _mm_and_si128(a, b); }
+  static V either(V a, V b) { return _mm_or_si128(a, b); }
+  static V differ(V a, V b) { return _mm_xor_si128(a, b); }
+  static V above(V v, V limit) { return _mm_subs_epu8(v, limit); }
+  // the bytes of v, the last n of before in front
+  template <int n> static V shifted(V v, V before) { return _mm_alignr_epi8(v, before, 16 - n); }
+  static bool ascii(V v) { return !_mm_movemask_epi8(v); }
+  static bool zero(V v) { return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) == 0xffff; }
+};
+
+#if defined(__AVX2__)
+struct Avx2 {
+  using V = __m256i;
+  static constexpr size_t size = 32;
+  static V load(uint8_t const *p) { return _mm256_loadu_si256(reinterpret_cast<V const *>(p)); }
+  // the shuffle looks up each 128 bit lane on its own
+  static V table(uint8_t const *t) { return _mm256_broadcastsi128_si256(Ssse3::load(t)); }
+  static V splat(uint8_t c) { return _mm256_set1_epi8(char(c)); }
+  static V lookup(V table, V nibbles) { return _mm256_shuffle_epi8(table, nibbles); }
+  static V high(V v) { return _mm256_and_si256(_mm256_srli_epi16(v, 4), splat(0x0f)); }
+  static V low(V v) { return _mm256_and_si256(v, splat(0x0f)); }
+  static V both(V a, V b) { return _mm256_and_si256(a, b); }
+  static V either(V a, V b) { return _mm256_or_si256(a, b); }
+  static V differ(V a, V b) { return _mm256_xor_si256(a, b); }
+  static V above(V v, V limit) { return _mm256_subs_epu8(v, limit); }
+  template <int n> static V shifted(V v, V before) {
+    return _mm256_alignr_epi8(v, _mm256_permute2x128_si256(before, v, 0x21), 16 - n);
+  }
+  static bool ascii(V v) { return !_mm256_movemask_epi8(v); }
+  static bool zero(V v) { return _mm256_testz_si256(v, v); }
+};
+#endif
+
+// The errors of the bytes of in, what's before it being before
+template <class T>
+typename T::V utf8Errors(typename T::V in, typename T::V before) {
+  using namespace lookup;
+  auto prev1 = T::template shifted<1>(in, before);
+  auto special = T::both(T::both(T::lookup(T::table(byte1High), T::high(prev1)),
+                                 T::lookup(T::table(byte1Low), T::low(prev1))),
+                         T::lookup(T::table(byte2High), T::high(in)));
+  // the 3rd byte of a sequence led by 111_____, the 4th one of one led by 1111____
+  auto third = T::above(T::template shifted<2>(in, before), T::splat(0xe0 - 0x80));
+  auto fourth = T::above(T::template shifted<3>(in, before), T::splat(0xf0 - 0x80));
+  auto continued = T::both(T::either(third, fourth), T::splat(0x80));
+  return T::differ(continued, special);
+}
+
+template <class T>
+bool validUtf8(std::string_view s) {
+  using V = typename T::V;
+  auto p = reinterpret_cast<uint8_t const *>(s.data());
+  auto n = s.size();
+  V before = T::splat(0), incomplete = T::splat(0), errors = T::splat(0);
+  auto check = [&](V in) {
+    if (T::ascii(in)) {
+      errors = T::either(errors, incomplete);
+    } else {
+      errors = T::either(errors, utf8Errors<T>(in, before));
+      incomplete = T::above(in, T::load(lookup::lastComplete + 32 - T::size));
+    }
+    before = in;
+  };
+  size_t pos = 0;
+  for (; pos + T::size <= n; pos += T::size) {
+    check(T::load(p + pos));
+  }
+  // padded with ASCII, a sequence cut short at the end is one before ASCII
+  alignas(32) uint8_t last[32] = {};
+  std::memcpy(last, p + pos, n - pos);
+  check(T::load(last));
+  return T::zero(errors);
+}
+#endif
+
+} //namespace
+
+size_t skipJsonPlainScalar(std::string_view s, size_t pos) {
+  auto p = reinterpret_cast<unsigned char const *>(s.data());
+  while (pos < s.size() && isJsonPlain(p[pos])) {
+    ++pos;
+  }
+  return pos;
+}
+
+size_t skipJsonPlain(std::string_view s, size_t pos) {
+  auto p = reinterpret_cast<unsigned char const *>(s.data());
+  auto n = s.size();
+#if defined(__AVX2__)
+  auto const space32 = _mm256_set1_epi8(0x20);
+  auto const quote32 = _mm256_set1_epi8('"');
+  auto const backslash32 = _mm256_set1_epi8('\\');
+  for (; pos + 32 <= n; pos += 32) {
+    auto v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p + pos));
+    // signed: bytes from 0x80 on are negative, so below 0x20 as well
+    auto special = _mm256_or_si256(_mm256_cmpgt_epi8(space32, v),
+                                   _mm256_or_si256(_mm256_cmpeq_epi8(v, quote32), _mm256_cmpeq_epi8(v, backslash32)));
+    if (auto mask = unsigned(_mm256_movemask_epi8(special))) {
+      return pos + __builtin_ctz(mask);
+    }
+  }
+#endif
+#if defined(__SSE2__)
+  auto const space = _mm_set1_epi8(0x20);
+  auto const quote = _mm_set1_epi8('"');
+  auto const backslash = _mm_set1_epi8('\\');
+  for (; pos + 16 <= n; pos += 16) {
+    auto v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p + pos));
+    auto special = _mm_or_si128(_mm_cmplt_epi8(v, space),
+                                _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)));
+    if (auto mask = _mm_movemask_epi8(special)) {
+      return pos + __builtin_ctz(mask);
+    }
+  }
+#endif
+  return skipJsonPlainScalar(s, pos);
+}
+
+size_t skipJsonTextScalar(std::string_view s, size_t pos) {
+  auto p = reinterpret_cast<unsigned char const *>(s.data());
+  while (pos < s.size() && p[pos] >= 0x20 && p[pos] != '"' && p[pos] != '\\') {
+    ++pos;
+  }
+  return pos;
+}
+
+size_t skipJsonText(std::string_view s, size_t pos) {
+  auto p = reinterpret_cast<unsigned char const *>(s.data());
+  auto n = s.size();
+#if defined(__AVX2__)
+  auto const control32 = _mm256_set1_epi8(0x1f);
+  auto const quote32 = _mm256_set1_epi8('"');
+  auto const backslash32 = _mm256_set1_epi8('\\');
+  for (; pos + 32 <= n; pos += 32) {
+    auto v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p + pos));
+    // unsigned: bytes from 0x80 on go as they are
+    auto special = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(v, control32), v),
+                                   _mm256_or_si256(_mm256_cmpeq_epi8(v, quote32), _mm256_cmpeq_epi8(v, backslash32)));
+    if (auto mask = unsigned(_mm256_movemask_epi8(special))) {
+      return pos + __builtin_ctz(mask);
+    }
+  }
+#endif
+#if defined(__SSE2__)
+  auto const control = _mm_set1_epi8(0x1f);
+  auto const quote = _mm_set1_epi8('"');
+  auto const backslash = _mm_set1_epi8('\\');
+  for (; pos + 16 <= n; pos += 16) {
+    auto v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p + pos));
+    auto special = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(v, control), v),
+                                _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)));
+    if (auto mask = _mm_movemask_epi8(special)) {
+      return pos + __builtin_ctz(mask);
+    }
+  }
+#endif
+  return skipJsonTextScalar(s, pos);
+}
+
+size_t utf8SequenceLength(std::string_view s, size_t pos) {
+  auto p = reinterpret_cast<unsigned char const *>(s.data()) + pos;
+  auto left = s.size() - pos;
+  unsigned char c = p[0];
+  if (c < 0x80) {
+    return 1;
+  }
+  // the allowed range of the second byte depends on the first one
+  unsigned char lo = 0x80, hi = 0xbf;
+  size_t len;
+  if (c >= 0xc2 && c <= 0xdf) {
+    len = 2;
+  } else if (c >= 0xe0 && c <= 0xef) {
+    len = 3;
+    if (c == 0xe0) lo = 0xa0;      // overlong
+    else if (c == 0xed) hi = 0x9f; // surrogates
+  } else if (c >= 0xf0 && c <= 0xf4) {
+    len = 4;
+    if (c == 0xf0) lo = 0x90;      // overlong
+    else if (c == 0xf4) hi = 0x8f; // beyond U+10FFFF
+  } else {
+    return 0;
+  }
+  if (left < len || p[1] < lo || p[1] > hi) {
+    return 0;
+  }
+  for (size_t i = 2; i < len; ++i) {
+    if (!isContinuation(p[i])) {
+      return 0;
+    }
+  }
+  return len;
+}
+
+bool isValidUtf8(std::string_view s) {
+  // the bytes before the first non-ASCII one end no sequence the rest goes on with
+  auto pos = skipAscii(s, 0);
+  if (pos == s.size()) {
+    return true;
+  }
+#if defined(__AVX2__)
+  return validUtf8<Avx2>(s.substr(pos));
+#elif defined(__SSSE3__)
+  return validUtf8<Ssse3>(s.substr(pos));
+#else
+  return isValidUtf8Scalar(s.substr(pos));
+#endif
+}
+
+bool isValidUtf8Scalar(std::string_view s) {
+  for (size_t pos = skipAscii(s, 0); pos < s.size(); pos = skipAscii(s, pos)) {
+    auto len = utf8SequenceLength(s, pos);
+    if (!len) {
+      return false;
+    }
+    pos += len;
+  }
+  return true;
+}
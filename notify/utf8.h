@@ -0,0 +1,29 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <cstddef>
+#include <string_view>
+
+// Scanning file names, which are arbitrary bytes, for what JSON can't take as it is.
+// The scans go 16 (SSE2) or 32 (AVX2, if compiled for it) bytes at a time, elsewhere a byte at a time.
+// Validating UTF-8 goes 16 (SSSE3) or 32 (AVX2) bytes at a time if compiled for it, elsewhere a sequence at a time.
+
+// The first byte at or after pos which is a control character, '"', '\\' or not ASCII, s.size() if none
+size_t skipJsonPlain(std::string_view s, size_t pos);
+// The same, a byte at a time, for comparison
+size_t skipJsonPlainScalar(std::string_view s, size_t pos);
+
+// The first byte at or after pos which is a control character, '"' or '\\', s.size() if none:
+// of what's valid UTF-8 that's all JSON can't take as it is
+size_t skipJsonText(std::string_view s, size_t pos);
+size_t skipJsonTextScalar(std::string_view s, size_t pos);
+
+// The length of the UTF-8 sequence starting at pos, 0 if it isn't a valid one
+// (overlong, a surrogate, beyond U+10FFFF, or cut short)
+size_t utf8SequenceLength(std::string_view s, size_t pos);
+
+bool isValidUtf8(std::string_view s);
+// The same, a sequence at a time, for comparison
+bool isValidUtf8Scalar(std::string_view s);
+
+#endif
@@ -0,0 +1,115 @@
+#include "xxhash64.h"
+
+#include <cstring>
+
+namespace {
+constexpr uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t prime3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t rotl(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t read64(unsigned char const *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v)); // little endian hosts only
+  return v;
+}
+
+inline uint32_t read32(unsigned char const *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint64_t round(uint64_t acc, uint64_t input) {
+  acc += input * prime2;
+  acc = rotl(acc, 31);
+  return acc * prime1;
+}
+
+inline uint64_t mergeRound(uint64_t acc, uint64_t lane) {
+  acc ^= round(0, lane);
+  return acc * prime1 + prime4;
+}
+} //namespace
+
+XXHash64::XXHash64(uint64_t seed):
+  lanes{seed + prime1 + prime2, seed + prime2, seed, seed - prime1},
+  seed{seed}
+{}
+
+void XXHash64::update(void const *data, size_t len) {
+  auto p = static_cast<unsigned char const *>(data);
+  totalLen += len;
+
+  if (buffered + len < sizeof(buffer)) {
+    memcpy(buffer + buffered, p, len);
+    buffered += len;
+    return;
+  }
+  if (buffered) {
+    auto fill = sizeof(buffer) - buffered;
+    memcpy(buffer + buffered, p, fill);
+    for (int i = 0; i < 4; ++i) {
+      lanes[i] = round(lanes[i], read64(buffer + 8 * i));
+    }
+    p += fill;
+    len -= fill;
+    buffered = 0;
+  }
+  uint64_t v0 = lanes[0], v1 = lanes[1], v2 = lanes[2], v3 = lanes[3];
+  while (len >= 32) {
+    v0 = round(v0, read64(p));
+    v1 = round(v1, read64(p + 8));
+    v2 = round(v2, read64(p + 16));
+    v3 = round(v3, read64(p + 24));
+    p += 32;
+    len -= 32;
+  }
+  lanes[0] = v0; lanes[1] = v1; lanes[2] = v2; lanes[3] = v3;
+  memcpy(buffer, p, len);
+  buffered = len;
+}
+
+uint64_t XXHash64::digest() const {
+  uint64_t h;
+  if (totalLen >= 32) {
+    h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+    for (int i = 0; i < 4; ++i) {
+      h = mergeRound(h, lanes[i]);
+    }
+  } else {
+    h = seed + prime5;
+  }
+  h += totalLen;
+
+  auto p = buffer;
+  auto len = buffered;
+  while (len >= 8) {
+    h ^= round(0, read64(p));
+    h = rotl(h, 27) * prime1 + prime4;
+    p += 8;
+    len -= 8;
+  }
+  if (len >= 4) {
+    h ^= uint64_t(read32(p)) * prime1;
+    h = rotl(h, 23) * prime2 + prime3;
+    p += 4;
+    len -= 4;
+  }
+  while (len--) {
+    h ^= *p++ * prime5;
+    h = rotl(h, 11) * prime1;
+  }
+
+  h ^= h >> 33;
+  h *= prime2;
+  h ^= h >> 29;
+  h *= prime3;
+  h ^= h >> 32;
+  return h;
+}
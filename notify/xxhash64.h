@@ -0,0 +1,23 @@
+#ifndef XXHASH64_H
+#define XXHASH64_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Streaming XXH64, see https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+// Four independent lanes, it runs at about memory speed without SIMD.
+class XXHash64 {
+public:
+  explicit XXHash64(uint64_t seed = 0);
+  void update(void const *data, size_t len);
+  uint64_t digest() const;
+
+private:
+  uint64_t lanes[4];
+  uint64_t seed;
+  uint64_t totalLen = 0;
+  unsigned char buffer[32];
+  size_t buffered = 0;
+};
+
+#endif
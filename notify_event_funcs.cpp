@@ -1,21 +1,56 @@
 #include "notify_event_funcs.h"
-#include "notify/i_notify_helper.h"
+#include "notify/event_cbor.h"
+#include "notify/event_json.h"
+// the implementation of Boost.JSON for the whole binary, client commands are parsed with it
 #include <boost/json/src.hpp>
-#include <sstream>
 
-namespace js=boost::json;
+namespace {
+void appendJson(std::string &message, const RecursiveNotifyEvent &event, Rendering rendering,
+                Projection const &projection, bool symbolicMask)
+{
+  switch (rendering) {
+    case Rendering::full:
+    case Rendering::pathId:
+      appendEventJson(message, event, symbolicMask, rendering == Rendering::pathId, projection);
+      break;
+    case Rendering::pathDefinition:
+      appendPathDefinitionJson(message, event.pathId, event.path);
+      break;
+    case Rendering::pathReset:
+      appendPathResetJson(message);
+      break;
+  }
+}
 
-void tag_invoke(js::value_from_tag, js::value &jv, const RecursiveNotifyEvent &event) {
-  jv = {
-    {"path", event.path},
-    {"name", event.name},
-    {"mask", event.mask},
-    {"cookie", event.cookie}
-  };
+void appendCbor(std::string &message, const RecursiveNotifyEvent &event, Rendering rendering,
+                Projection const &projection)
+{
+  switch (rendering) {
+    case Rendering::full:
+    case Rendering::pathId:
+      appendEventCbor(message, event, rendering == Rendering::pathId, projection);
+      break;
+    case Rendering::pathDefinition:
+      appendPathDefinitionCbor(message, event.pathId, event.path);
+      break;
+    case Rendering::pathReset:
+      appendPathResetCbor(message);
+      break;
+  }
 }
+} //namespace
 
-std::string eventToString(const RecursiveNotifyEvent &event) {
-  std::stringstream message;
-  message << js::serialize(js::value_from(event));
-  return message.str();
+void eventToMessage(std::string &message, const RecursiveNotifyEvent &event, WireFormat format,
+                    Rendering rendering, Projection const &projection, bool symbolicMask)
+{
+  message.clear();
+  switch (format) {
+    case WireFormat::json:
+      appendJson(message, event, rendering, projection, symbolicMask);
+      message += '\n';
+      break;
+    case WireFormat::cbor: // frames are binary, they need no separator
+      appendCbor(message, event, rendering, projection);
+      break;
+  }
 }
@@ -2,8 +2,11 @@
 #define NOTIFY_EVENT_FUNCS_H
 
 #include "notify/recursive_notify_event.h"
+#include "glue/message_sender.h"
 #include <string>
 
-std::string eventToString(const RecursiveNotifyEvent &event);
+// Replaces message with what is sent to the clients of the format for event
+void eventToMessage(std::string &message, const RecursiveNotifyEvent &event, WireFormat format,
+                    Rendering rendering, Projection const &projection, bool symbolicMask);
 
 #endif
@@ -3,18 +3,76 @@
 #include "notify_event_funcs.h"
 #include "notify/recursive_i_notify.h"
 
-RecursiveINotifyFactory::RecursiveINotifyFactory(Options options)
+#include <algorithm>
+
+RecursiveINotifyFactory::RecursiveINotifyFactory(Options options, HandoffState inherited)
   : options{std::move(options)}
+  , inherited{std::move(inherited)}
 {}
 
 std::unique_ptr<MessageProvider> 
 RecursiveINotifyFactory::makeMessageProvider(const MessageSender &messageSender) const {
+  std::vector<EventScheduler::Class> classes;
+  for (auto &spec: options.schedulingClasses) {
+    classes.push_back(EventScheduler::parseClass(spec));
+  }
+  auto symbolicMask = options.symbolicMask;
+  // mask is sent around so we don't have to parse the message again. Tailed and
+  // changed bytes are never conflated, they'd be lost
+  auto outgoing = [symbolicMask](const RecursiveNotifyEvent &rne) {
+    bool carriesData = rne.mask & (NB_TAIL | NB_DELTA);
+    return OutgoingMessage{[&rne, symbolicMask](std::string &message, WireFormat format,
+                                                Rendering rendering, Projection const &projection) {
+      eventToMessage(message, rne, format, rendering, projection, symbolicMask);
+    }, static_cast<int>(rne.mask), rne.pathId, carriesData ? std::string_view{} : std::string_view{rne.name}};
+  };
+  auto publish = [&messageSender, symbolicMask, outgoing](const RecursiveNotifyEvent &rne) {
+    if (rne.catchUp) { // clients are most probably not connected yet, keep it for them
+      messageSender.sendRetained([rne, symbolicMask](std::string &message, WireFormat format,
+                                                     Rendering rendering, Projection const &projection) {
+        eventToMessage(message, rne, format, rendering, projection, symbolicMask);
+      }, rne.mask);
+    } else {
+      auto m = outgoing(rne);
+      messageSender.send(m.render, m.mask, m.pathId, m.name);
+    }
+  };
   return std::make_unique<RecursiveINotify>(
-    [&messageSender](const RecursiveNotifyEvent &rne) {
-      auto message = eventToString(rne) + "\n";
-      messageSender.send(message, rne.mask); // mask is sent around so we don't have to parse the message again
-    },
+    publish,
     options.pathToMonitor,
-    options.pathsToExclude
+    options.pathsToExclude,
+    options.stateFile,
+    std::chrono::seconds(options.stateInterval),
+    inherited,
+    std::move(classes),
+    ReaderOptions{.cpu = options.inotifyCpu, .busyPoll = options.lowLatency},
+    TailOptions{.patterns = options.tailPatterns,
+                .maxChunk = options.tailChunk,
+                .maxPending = 16 * options.tailChunk},
+    HashOptions{.threads = options.hash || !options.deltaPatterns.empty() ? std::max(options.hashThreads, 1u) : 0,
+                .everyFile = options.hash},
+    DeltaOptions{.patterns = options.deltaPatterns,
+                 .storeDir = options.deltaStore,
+                 .blockSize = options.deltaBlock,
+                 .withData = options.deltaData},
+    // a batch goes to the sessions in one go, catch-up events aside
+    [&messageSender, publish, outgoing](std::vector<RecursiveNotifyEvent> &batch) {
+      std::vector<OutgoingMessage> messages;
+      auto flush = [&messageSender, &messages]() {
+        if (!messages.empty()) {
+          messageSender.send(messages);
+          messages.clear();
+        }
+      };
+      for (auto &rne: batch) {
+        if (rne.catchUp) {
+          flush();
+          publish(rne);
+        } else {
+          messages.push_back(outgoing(rne));
+        }
+      }
+      flush();
+    }
   );
 }
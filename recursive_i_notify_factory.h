@@ -6,10 +6,11 @@
 
 class RecursiveINotifyFactory : public MessageProviderFactory {
 public:
-  explicit RecursiveINotifyFactory(Options options);
+  explicit RecursiveINotifyFactory(Options options, HandoffState inherited = {});
   ~RecursiveINotifyFactory() = default;
 private:
-  Options options;  
+  Options options;
+  HandoffState inherited;
   std::unique_ptr<MessageProvider> makeMessageProvider(const MessageSender &messageSender) const override;
 };
 